@@ -27,6 +27,10 @@ static size_t size = 0; // will be set by caller
 #ifdef HAVE_PROFILER
 static char* profile_filename = NULL; // filename for profiling
 #endif
+#if LACE_TRACE
+static char* trace_filename = NULL; // filename for the trace of Lace tasks (Chrome trace format)
+static char* folded_filename = NULL; // filename for the trace of Lace tasks (folded stacks)
+#endif
 
 /* argp configuration */
 static struct argp_option options[] =
@@ -34,6 +38,10 @@ static struct argp_option options[] =
     {"workers", 'w', "<workers>", 0, "Number of workers (default=0: autodetect)", 0},
 #ifdef HAVE_PROFILER
     {"profiler", 'p', "<filename>", 0, "Filename for profiling", 0},
+#endif
+#if LACE_TRACE
+    {"trace", 't', "<filename>", 0, "Filename for the trace of Lace tasks (Chrome trace format)", 0},
+    {"trace-folded", 4, "<filename>", 0, "Filename for the trace of Lace tasks (folded stacks for flame graphs)", 0},
 #endif
     {"report-minterms", 1, 0, 0, "Report #minterms at every major step", 1},
     {"report-minor", 2, 0, 0, "Report minor steps", 1},
@@ -60,6 +68,14 @@ parse_opt(int key, char *arg, struct argp_state *state)
     case 'p':
         profile_filename = arg;
         break;
+#endif
+#if LACE_TRACE
+    case 't':
+        trace_filename = arg;
+        break;
+    case 4:
+        folded_filename = arg;
+        break;
 #endif
     case ARGP_KEY_ARG:
         if (state->arg_num >= 1) argp_usage(state);
@@ -132,6 +148,9 @@ main(int argc, char** argv)
 
 #ifdef HAVE_PROFILER
     if (profile_filename != NULL) ProfilerStart(profile_filename);
+#endif
+#if LACE_TRACE
+    if (trace_filename != NULL || folded_filename != NULL) lace_trace_start();
 #endif
     double t1 = wctime();
 
@@ -313,6 +332,20 @@ main(int argc, char** argv)
 #ifdef HAVE_PROFILER
     if (profile_filename != NULL) ProfilerStop();
 #endif
+#if LACE_TRACE
+    if (trace_filename != NULL || folded_filename != NULL) {
+        lace_trace_stop();
+        FILE *f;
+        if (trace_filename != NULL && (f = fopen(trace_filename, "w")) != NULL) {
+            lace_trace_write_chrome(f);
+            fclose(f);
+        }
+        if (folded_filename != NULL && (f = fopen(folded_filename, "w")) != NULL) {
+            lace_trace_write_folded(f);
+            fclose(f);
+        }
+    }
+#endif
 
     INFO("Result: NQueens(%zu) has %.0f solutions.\n", size, sylvan_satcount(res, vars));
     INFO("Result BDD has %zu nodes.\n", sylvan_nodecount(res));
@@ -0,0 +1,200 @@
+/**
+ * Benchmark of the nodes table with different memory policies.
+ * Fills the nodes table with random nodes, then looks them all up again,
+ * and reports the throughput of both phases.
+ * With --maxload, the table is filled until it is full, which reports the maximum load
+ * of the probe scheme (rehashing only, or with --overflow also overflow probing).
+ */
+
+#include <argp.h>
+#include <inttypes.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <sylvan.h>
+#include <sylvan_int.h>
+
+/* Configuration */
+static int workers = 0; // autodetect number of workers by default
+static int log_size = 24; // 2^24 nodes
+static int fill = 50; // fill the table to 50%
+static int rounds = 4; // look up all nodes 4 times
+static int pages = SYLVAN_PAGES_DEFAULT;
+static int numa = SYLVAN_NUMA_DEFAULT;
+static int overflow = 0; // overflow probing
+static int maxload = 0; // fill the table until it is full
+static int batch = 0; // look up the nodes with llmsset_lookup_batch
+
+/* argp configuration */
+static struct argp_option options[] =
+{
+    {"workers", 'w', "<workers>", 0, "Number of workers (default=0: autodetect)", 0},
+    {"size", 's', "<log2>", 0, "Size of the nodes table as power of 2 (default=24)", 0},
+    {"fill", 'f', "<percent>", 0, "Fill the nodes table to this percentage (default=50)", 0},
+    {"rounds", 'r', "<rounds>", 0, "Number of lookup rounds (default=4)", 0},
+    {"pages", 'p', "<default|thp|hugetlb>", 0, "Page size of the tables (default=default)", 1},
+    {"numa", 'n', "<default|interleave|firsttouch>", 0, "NUMA placement of the tables (default=default)", 1},
+    {"overflow", 'o', 0, 0, "Enable overflow probing in the nodes table", 2},
+    {"maxload", 'm', 0, 0, "Fill the nodes table until it is full (ignores --fill)", 2},
+    {"batch", 'b', 0, 0, "Look up the nodes in batches with prefetching", 2},
+    {0, 0, 0, 0, 0, 0}
+};
+static error_t
+parse_opt(int key, char *arg, struct argp_state *state)
+{
+    switch (key) {
+    case 'w':
+        workers = atoi(arg);
+        break;
+    case 's':
+        log_size = atoi(arg);
+        break;
+    case 'f':
+        fill = atoi(arg);
+        break;
+    case 'r':
+        rounds = atoi(arg);
+        break;
+    case 'p':
+        if (strcmp(arg, "default") == 0) pages = SYLVAN_PAGES_DEFAULT;
+        else if (strcmp(arg, "thp") == 0) pages = SYLVAN_PAGES_TRANSPARENT;
+        else if (strcmp(arg, "hugetlb") == 0) pages = SYLVAN_PAGES_HUGETLB;
+        else argp_usage(state);
+        break;
+    case 'n':
+        if (strcmp(arg, "default") == 0) numa = SYLVAN_NUMA_DEFAULT;
+        else if (strcmp(arg, "interleave") == 0) numa = SYLVAN_NUMA_INTERLEAVE;
+        else if (strcmp(arg, "firsttouch") == 0) numa = SYLVAN_NUMA_FIRSTTOUCH;
+        else argp_usage(state);
+        break;
+    case 'o':
+        overflow = 1;
+        break;
+    case 'm':
+        maxload = 1;
+        break;
+    case 'b':
+        batch = 1;
+        break;
+    case ARGP_KEY_ARG:
+        argp_usage(state);
+        break;
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+static struct argp argp = { options, parse_opt, 0, 0, 0, 0, 0 };
+
+/* Obtain current wallclock time */
+static double
+wctime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec + 1E-6 * tv.tv_usec);
+}
+
+/**
+ * The key of node <i>: a random (but reproducible) pair of 64-bit values
+ */
+static inline uint64_t
+mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+TASK_2(uint64_t, lookup_par, uint64_t, first, uint64_t, count)
+{
+    if (count > 4096) {
+        SPAWN(lookup_par, first, count/2);
+        uint64_t res = CALL(lookup_par, first+count/2, count-count/2);
+        return res + SYNC(lookup_par);
+    }
+
+    uint64_t created = 0;
+    if (batch) {
+        uint64_t a[256], b[256], res[256];
+        int c[256];
+        for (uint64_t i=first; i<first+count; i+=256) {
+            uint64_t n = first+count-i < 256 ? first+count-i : 256;
+            for (uint64_t k=0; k<n; k++) {
+                a[k] = mix(2*(i+k));
+                b[k] = mix(2*(i+k)+1);
+            }
+            if (llmsset_lookup_batch(nodes, n, a, b, res, c) != n) {
+                fprintf(stderr, "Nodes table full!\n");
+                exit(1);
+            }
+            for (uint64_t k=0; k<n; k++) created += c[k];
+        }
+        return created;
+    }
+
+    for (uint64_t i=first; i<first+count; i++) {
+        int c;
+        if (llmsset_lookup(nodes, mix(2*i), mix(2*i+1), &c) == 0) {
+            fprintf(stderr, "Nodes table full!\n");
+            exit(1);
+        }
+        created += c;
+    }
+    return created;
+}
+
+int
+main(int argc, char** argv)
+{
+    argp_parse(&argp, argc, argv, 0, 0, 0);
+    setlocale(LC_NUMERIC, "en_US.utf-8");
+
+    lace_init(workers, 1000000);
+    lace_startup(0, NULL, NULL);
+
+    LACE_ME;
+
+    // use the same initial and maximum size, so the table is not resized during the benchmark
+    sylvan_set_memory_policy(pages, numa);
+    sylvan_init_package(1LL<<log_size, 1LL<<log_size, 1LL<<16, 1LL<<16);
+    sylvan_set_overflow_probe(overflow);
+
+    uint64_t count = (1LL<<log_size) / 100 * fill;
+    uint64_t created;
+    double t1, t2;
+
+    if (maxload) {
+        // insert sequentially, so the maximum load does not depend on the scheduling of workers
+        int c;
+        t1 = wctime();
+        for (count=0; llmsset_lookup(nodes, mix(2*count), mix(2*count+1), &c) != 0; count++) continue;
+        t2 = wctime();
+        created = count;
+        printf("Workers: %zu, nodes table: 2^%d, overflow probing: %s\n", lace_workers(), log_size, overflow ? "yes" : "no");
+        printf("Maximum load: %.2f%% (%'" PRIu64 " nodes)\n", 100.0*count/(1LL<<log_size), count);
+    } else {
+        printf("Workers: %zu, nodes table: 2^%d, nodes: %'" PRIu64 "\n", lace_workers(), log_size, count);
+        t1 = wctime();
+        created = CALL(lookup_par, 0, count);
+        t2 = wctime();
+    }
+    printf("Insert: %.3f sec, %'.0f lookups/sec (%'" PRIu64 " created)\n", t2-t1, count/(t2-t1), created);
+
+    for (int r=0; r<rounds; r++) {
+        t1 = wctime();
+        created = CALL(lookup_par, 0, count);
+        t2 = wctime();
+        printf("Lookup %d: %.3f sec, %'.0f lookups/sec, %.1f ns/lookup/worker (%'" PRIu64 " created)\n", r+1, t2-t1, count/(t2-t1), 1E9*(t2-t1)*lace_workers()/count, created);
+    }
+
+    sylvan_quit();
+    lace_exit();
+    return 0;
+}
@@ -14,17 +14,29 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for CPU_SET and sched_setaffinity
+#endif
+
+#include <dirent.h> // for opendir
 #include <errno.h> // for errno
+#include <limits.h> // for INT_MAX
 #include <sched.h> // for sched_getaffinity
 #include <stdio.h>  // for fprintf
 #include <stdlib.h> // for memalign, malloc
 #include <string.h> // for memset
 #include <sys/mman.h> // for mprotect
 #include <sys/time.h> // for gettimeofday
+#include <time.h> // for nanosleep
 #include <pthread.h>
 #include <unistd.h>
 #include <assert.h>
 
+#ifdef __linux__
+#include <linux/futex.h> // for FUTEX_WAIT_PRIVATE
+#include <sys/syscall.h> // for SYS_futex
+#endif
+
 #include <lace.h>
 
 #ifndef USE_HWLOC
@@ -45,6 +57,11 @@ static hwloc_topology_t topo;
 static unsigned int n_nodes, n_cores, n_pus;
 #endif
 
+// topology of the workers (for hierarchical victim selection)
+static int *worker_node;    // NUMA node of each worker
+static int *worker_cluster; // core complex (shared last level cache) of each worker
+static int *worker_cpu;     // cpu to pin each worker to without hwloc (-1 for no pinning)
+
 static int verbosity = 0;
 
 static int n_workers = 0;
@@ -56,6 +73,22 @@ static WorkerP **workers_p;
 // set to 0 when quitting
 static int lace_quits = 0;
 
+// idle workers back off and then sleep (see lace_set_idle_spins)
+static unsigned int idle_spins = LACE_IDLE_SPINS;
+volatile int __attribute__((aligned(LINE_SIZE))) lace_sleeping = 0; // number of sleeping workers
+static volatile int __attribute__((aligned(LINE_SIZE))) sleep_seq = 0; // incremented to wake sleeping workers
+
+// tasks submitted with lace_submit, executed by idle workers in their outermost steal loop
+static pthread_mutex_t external_lock = PTHREAD_MUTEX_INITIALIZER;
+static lace_future_t * volatile external_head = NULL;
+static lace_future_t *external_tail = NULL;
+
+// number of workers that left Lace (for lace_exit after lace_startup_background)
+static volatile int workers_exited = 0;
+
+#define IDLE_BACKOFF_MAX 14     // back off with at most 2^14 pauses between steal attempts, then sleep
+#define IDLE_SLEEP_NS 10000000  // sleeping workers try to steal every 10 ms (a SPAWN can miss a worker that falls asleep)
+
 // for storing private Worker data
 #ifdef __linux__ // use gcc thread-local storage (i.e. __thread variables)
 static __thread WorkerP *current_worker;
@@ -256,6 +289,16 @@ lace_init_worker(int worker, size_t dq_size)
     }
     lock_release();
 #else
+#ifdef __linux__
+    // Pin our thread, so the topology of the worker is known (and its memory is first-touched locally)
+    if (worker_cpu[worker] >= 0) {
+        cpu_set_t cs;
+        CPU_ZERO(&cs);
+        CPU_SET(worker_cpu[worker], &cs);
+        sched_setaffinity(0, sizeof(cs), &cs);
+    }
+#endif
+
     // Allocate memory...
     if (posix_memalign((void**)&wt, LINE_SIZE, sizeof(Worker)) ||
         posix_memalign((void**)&w, LINE_SIZE, sizeof(WorkerP)) || 
@@ -280,9 +323,35 @@ lace_init_worker(int worker, size_t dq_size)
 #if USE_HWLOC
     w->pu = worker % n_pus;
 #else
-    w->pu = -1;
+    w->pu = worker_cpu[worker];
 #endif
     w->enabled = 1;
+    w->seed = worker;
+    w->steal_fails = 0;
+
+    // Order the other workers by distance: same core complex, same NUMA node, other NUMA nodes
+    w->victims = (int16_t*)malloc(sizeof(int16_t) * (n_workers > 1 ? n_workers-1 : 1));
+    if (w->victims == NULL) {
+        fprintf(stderr, "Lace error: Unable to allocate memory for the Lace worker!\n");
+        exit(1);
+    }
+    {
+        int k, n = 0;
+        for (k=1; k<n_workers; k++) {
+            int v = (worker + k) % n_workers;
+            if (worker_node[v] == worker_node[worker] && worker_cluster[v] == worker_cluster[worker]) w->victims[n++] = v;
+        }
+        w->victims_cluster = n;
+        for (k=1; k<n_workers; k++) {
+            int v = (worker + k) % n_workers;
+            if (worker_node[v] == worker_node[worker] && worker_cluster[v] != worker_cluster[worker]) w->victims[n++] = v;
+        }
+        w->victims_node = n;
+        for (k=1; k<n_workers; k++) {
+            int v = (worker + k) % n_workers;
+            if (worker_node[v] != worker_node[worker]) w->victims[n++] = v;
+        }
+    }
     if (workers_init[worker].stack != 0) {
         w->stack_trigger = ((size_t)workers_init[worker].stack) + workers_init[worker].stacksize/20;
     } else {
@@ -295,6 +364,16 @@ lace_init_worker(int worker, size_t dq_size)
     { int k; for (k=0; k<CTR_MAX; k++) w->ctr[k] = 0; }
 #endif
 
+#if LACE_TRACE
+    // Allocate the trace ring buffer
+    w->trace = (lace_trace_event_t*)malloc(LACE_TRACE_SIZE * sizeof(lace_trace_event_t));
+    if (w->trace == NULL) {
+        fprintf(stderr, "Lace error: Unable to allocate memory for the Lace worker!\n");
+        exit(1);
+    }
+    w->trace_next = 0;
+#endif
+
     // Set pointers
 #ifdef __linux__
     current_worker = w;
@@ -381,12 +460,40 @@ pthread_barrier_wait(pthread_barrier_t *barrier)
 static pthread_barrier_t suspend_barrier;
 static volatile int must_suspend = 0, suspended = 0;
 
+void
+lace_set_idle_spins(unsigned int spins)
+{
+    idle_spins = spins;
+}
+
+void
+lace_wake_sleeping()
+{
+    // claim all sleeping workers, so only one SPAWN wakes them
+    if (__sync_lock_test_and_set(&lace_sleeping, 0) == 0) return;
+    __sync_fetch_and_add(&sleep_seq, 1);
+#ifdef __linux__
+    syscall(SYS_futex, &sleep_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/**
+ * Wake sleeping workers after changing one of the conditions checked by idle_has_work.
+ */
+static inline void
+wake_sleeping_fenced()
+{
+    mfence();
+    if (lace_sleeping != 0) lace_wake_sleeping();
+}
+
 void
 lace_suspend()
 {
     if (suspended == 0) {
         suspended = 1;
         must_suspend = 1;
+        wake_sleeping_fenced();
         lace_barrier();
         must_suspend = 0;
     }
@@ -460,18 +567,176 @@ rng(uint32_t *seed, int max)
     return next % max;
 }
 
-VOID_TASK_IMPL_0(lace_steal_random)
+/**
+ * Select a victim for stealing, nearest workers first: a random worker in the same core complex,
+ * after LACE_STEAL_LOCAL_TRIES failed attempts a random worker in the same NUMA node,
+ * and after twice as many failed attempts a random worker on any NUMA node.
+ */
+static inline int
+select_victim(WorkerP *w, uint32_t *seed)
 {
-    Worker *victim = workers[(__lace_worker->worker + 1 + rng(&__lace_worker->seed, n_workers-1)) % n_workers];
+    int n = n_workers - 1;
+    if (w->steal_fails < LACE_STEAL_LOCAL_TRIES && w->victims_cluster != 0) n = w->victims_cluster;
+    else if (w->steal_fails < 2*LACE_STEAL_LOCAL_TRIES && w->victims_node != 0) n = w->victims_node;
+    return w->victims[rng(seed, n)];
+}
 
-    YIELD_NEWFRAME();
+/**
+ * Steal from a victim selected with select_victim and update the counters.
+ */
+static inline int
+steal_nearest(WorkerP *__lace_worker, Task *__lace_dq_head, uint32_t *seed)
+{
+    int victim = select_victim(__lace_worker, seed);
 
     PR_COUNTSTEALS(__lace_worker, CTR_steal_tries);
-    Worker *res = lace_steal(__lace_worker, __lace_dq_head, victim);
+    Worker *res = lace_steal(__lace_worker, __lace_dq_head, workers[victim]);
     if (res == LACE_STOLEN) {
+        __lace_worker->steal_fails = 0;
         PR_COUNTSTEALS(__lace_worker, CTR_steals);
-    } else if (res == LACE_BUSY) {
-        PR_COUNTSTEALS(__lace_worker, CTR_steal_busy);
+        PR_COUNTSTEALS(__lace_worker, worker_node[victim] == worker_node[__lace_worker->worker] ? CTR_steal_local : CTR_steal_remote);
+    } else {
+        if (__lace_worker->steal_fails < 2*LACE_STEAL_LOCAL_TRIES) __lace_worker->steal_fails++;
+        if (res == LACE_BUSY) {
+            PR_COUNTSTEALS(__lace_worker, CTR_steal_busy);
+        }
+    }
+    return res == LACE_STOLEN;
+}
+
+/**
+ * Check if an idle worker has something to do: quit, suspend, join a new frame or steal a task.
+ */
+static int
+idle_has_work(int *quit)
+{
+    if (*(volatile int*)quit || must_suspend || *(Task* volatile *)&lace_newframe.t != NULL) return 1;
+    if (quit == &lace_quits && external_head != NULL) return 1;
+    int i;
+    for (i=0; i<n_workers; i++) {
+        Worker *victim = workers[i];
+        if (victim->allstolen) continue;
+        TailSplit ts;
+        ts.v = *(volatile uint64_t *)&victim->ts.v;
+        if (ts.ts.tail < ts.ts.split) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Called by an idle worker that failed <extra> more steal attempts than its spin budget.
+ * First back off exponentially, then sleep until woken or until the sleep times out.
+ * Returns 1 if the worker was woken (or found something to do), 0 otherwise.
+ */
+static int
+lace_idle(unsigned int extra, int *quit)
+{
+    if (extra <= IDLE_BACKOFF_MAX) {
+        unsigned int i;
+        for (i = 1u << extra; i != 0; i--) asm volatile("pause");
+        return 0;
+    }
+
+    int seq = sleep_seq;
+    __sync_fetch_and_add(&lace_sleeping, 1); // full barrier, see wake_sleeping_fenced
+    int woken = 1;
+    if (!idle_has_work(quit)) {
+#ifdef __linux__
+        struct timespec timeout = { 0, IDLE_SLEEP_NS };
+        syscall(SYS_futex, &sleep_seq, FUTEX_WAIT_PRIVATE, seq, &timeout, NULL, 0);
+#else
+        struct timespec timeout = { 0, IDLE_SLEEP_NS / 10 };
+        nanosleep(&timeout, NULL);
+#endif
+        // if sleep_seq changed, a waker either claimed us, or bumped it just before we counted
+        // ourselves as sleeping (then the futex returned at once and we must still stop counting)
+        if (sleep_seq == seq) woken = 0;
+    }
+
+    // stop counting as sleeping, unless a waker claimed us in the meantime
+    for (;;) {
+        int n = lace_sleeping;
+        if (n == 0) return 1;
+        if (cas(&lace_sleeping, n, n-1)) return woken;
+    }
+}
+
+VOID_TASK_IMPL_0(lace_steal_random)
+{
+    YIELD_NEWFRAME();
+
+    steal_nearest(__lace_worker, __lace_dq_head, &__lace_worker->seed);
+}
+
+void
+lace_submit(lace_future_t *fut)
+{
+    fut->next = NULL;
+    fut->done = 0;
+
+    pthread_mutex_lock(&external_lock);
+    if (external_tail == NULL) external_head = fut;
+    else external_tail->next = fut;
+    external_tail = fut;
+    pthread_mutex_unlock(&external_lock);
+
+    wake_sleeping_fenced();
+}
+
+/**
+ * Take the oldest submitted task, or return NULL if there is none.
+ */
+static lace_future_t*
+external_take()
+{
+    if (external_head == NULL) return NULL;
+
+    pthread_mutex_lock(&external_lock);
+    lace_future_t *fut = external_head;
+    if (fut != NULL) {
+        external_head = fut->next;
+        if (external_head == NULL) external_tail = NULL;
+    }
+    pthread_mutex_unlock(&external_lock);
+    return fut;
+}
+
+/**
+ * Execute a submitted task as a root task and wake the thread that waits for it.
+ */
+static void
+external_run(WorkerP *__lace_worker, Task *__lace_dq_head, lace_future_t *fut)
+{
+    fut->task.f(__lace_worker, __lace_dq_head, &fut->task);
+    compiler_barrier();
+    fut->done = 1;
+#ifdef __linux__
+    syscall(SYS_futex, &fut->done, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+void
+lace_future_wait(lace_future_t *fut)
+{
+    WorkerP *__lace_worker = lace_get_worker();
+    if (__lace_worker != NULL) {
+        // a worker executes submitted tasks and steals while it waits
+        Task *__lace_dq_head = lace_get_head(__lace_worker);
+        while (!fut->done) {
+            lace_future_t *other = external_take();
+            if (other != NULL) external_run(__lace_worker, __lace_dq_head, other);
+            else if (n_workers > 1) lace_steal_random();
+        }
+        return;
+    }
+
+    while (!fut->done) {
+#ifdef __linux__
+        syscall(SYS_futex, &fut->done, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+#else
+        struct timespec timeout = { 0, 100000 };
+        nanosleep(&timeout, NULL);
+#endif
     }
 }
 
@@ -511,40 +776,27 @@ lace_main_wrapper(void *arg)
 
 VOID_TASK_IMPL_1(lace_steal_loop, int*, quit)
 {
-    // Determine who I am
-    const int worker_id = __lace_worker->worker;
-
-    // Prepare self, victim
-    Worker ** const self = &workers[worker_id];
-    Worker **victim = self;
-
 #if LACE_PIE_TIMES
     __lace_worker->time = gethrtime();
 #endif
 
-    uint32_t seed = worker_id;
-    unsigned int n = n_workers;
-    int i=0;
+    uint32_t seed = __lace_worker->worker;
+    unsigned int fails = 0;
 
-    while(*(volatile int*)quit == 0) {
-        // Select victim
-        if( i>0 ) {
-            i--;
-            victim++;
-            if (victim == self) victim++;
-            if (victim >= workers + n) victim = workers;
-            if (victim == self) victim++;
-        } else {
-            i = rng(&seed, 40); // compute random i 0..40
-            victim = workers + (rng(&seed, n-1) + worker_id + 1) % n;
-        }
+    // only the outermost steal loop (not the steal loop in a new frame) executes submitted tasks
+    const int outermost = quit == &lace_quits;
+    lace_future_t *fut;
 
-        PR_COUNTSTEALS(__lace_worker, CTR_steal_tries);
-        Worker *res = lace_steal(__lace_worker, __lace_dq_head, *victim);
-        if (res == LACE_STOLEN) {
-            PR_COUNTSTEALS(__lace_worker, CTR_steals);
-        } else if (res == LACE_BUSY) {
-            PR_COUNTSTEALS(__lace_worker, CTR_steal_busy);
+    while(*(volatile int*)quit == 0) {
+        if (outermost && unlikely(external_head != NULL) && (fut = external_take()) != NULL) {
+            external_run(__lace_worker, __lace_dq_head, fut);
+            fails = 0;
+        } else if (n_workers > 1 && steal_nearest(__lace_worker, __lace_dq_head, &seed)) {
+            fails = 0;
+        } else if (idle_spins != 0 && ++fails > idle_spins) {
+            // after a timeout, sleep again after a single steal attempt
+            if (lace_idle(fails - idle_spins, quit)) fails = 0;
+            else if (fails > idle_spins + IDLE_BACKOFF_MAX) fails = idle_spins + IDLE_BACKOFF_MAX;
         }
 
         YIELD_NEWFRAME();
@@ -567,6 +819,7 @@ lace_default_worker(void* arg)
     lace_steal_loop(&lace_quits);
     lace_time_event(__lace_worker, 9);
     lace_barrier();
+    __sync_fetch_and_add(&workers_exited, 1);
     return NULL;
 }
 
@@ -643,6 +896,128 @@ get_cpu_count()
     return count < 1 ? 1 : count;
 }
 
+#if !USE_HWLOC && defined(__linux__)
+/**
+ * Read an integer from a file in /sys, or return -1 if the file cannot be read.
+ */
+static int
+read_sys_int(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int value;
+    if (fscanf(f, "%d", &value) != 1) value = -1;
+    fclose(f);
+    return value;
+}
+
+/**
+ * Get the NUMA node of a cpu from /sys, or 0 if it is unknown.
+ */
+static int
+sys_cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) return 0;
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) break;
+        node = 0;
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * Get the id of the last level cache of a cpu from /sys, or -1 if it is unknown.
+ */
+static int
+sys_cpu_llc(int cpu)
+{
+    int index, best_level = 0, id = -1;
+    for (index=0; ; index++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+        int level = read_sys_int(path);
+        if (level < 0) break;
+        if (level > best_level) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/id", cpu, index);
+            best_level = level;
+            id = read_sys_int(path);
+        }
+    }
+    return id;
+}
+#endif
+
+/**
+ * Determine the NUMA node and the core complex of every worker.
+ * With hwloc, worker <i> runs on logical processor <i % n_pus>. Without hwloc, on Linux,
+ * worker <i> runs on the <i % n>th of the <n> cpus we may run on, with the topology from /sys.
+ */
+static void
+lace_init_topology()
+{
+    free(worker_node);
+    free(worker_cluster);
+    free(worker_cpu);
+    worker_node = (int*)calloc(n_workers, sizeof(int));
+    worker_cluster = (int*)calloc(n_workers, sizeof(int));
+    worker_cpu = (int*)malloc(n_workers * sizeof(int));
+    if (worker_node == NULL || worker_cluster == NULL || worker_cpu == NULL) {
+        fprintf(stderr, "Lace error: unable to allocate memory!\n");
+        exit(1);
+    }
+
+    int i;
+    for (i=0; i<n_workers; i++) worker_cpu[i] = -1;
+
+#if USE_HWLOC
+    for (i=0; i<n_workers; i++) {
+        hwloc_obj_t pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, i % n_pus);
+        int node = pu->nodeset != NULL ? hwloc_bitmap_first(pu->nodeset) : 0;
+        worker_node[i] = node < 0 ? 0 : node;
+        // the core complex is the cache above the cores with the largest depth (usually L3)
+        hwloc_obj_t llc = NULL, obj;
+        for (obj = pu->parent; obj != NULL; obj = obj->parent) {
+#if HWLOC_API_VERSION >= 0x00020000
+            if (hwloc_obj_type_is_cache(obj->type)) llc = obj;
+#else
+            if (obj->type == HWLOC_OBJ_CACHE) llc = obj;
+#endif
+        }
+        worker_cluster[i] = llc != NULL ? (int)llc->logical_index : -1;
+    }
+#elif defined(__linux__)
+    cpu_set_t cs;
+    CPU_ZERO(&cs);
+    if (sched_getaffinity(0, sizeof(cs), &cs) != 0) return;
+    int count = CPU_COUNT(&cs);
+    if (count == 0) return;
+
+    int flat = 1;
+    for (i=0; i<n_workers; i++) {
+        // find the (i % count)th cpu in the affinity mask
+        int k = i % count, cpu;
+        for (cpu=0; cpu<CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &cs) && k-- == 0) break;
+        }
+        worker_cpu[i] = cpu;
+        worker_node[i] = sys_cpu_node(cpu);
+        worker_cluster[i] = sys_cpu_llc(cpu);
+        if (worker_node[i] != worker_node[0] || worker_cluster[i] != worker_cluster[0]) flat = 0;
+    }
+
+    // only pin the workers if the topology matters
+    if (flat) {
+        for (i=0; i<n_workers; i++) worker_cpu[i] = -1;
+    }
+#endif
+}
+
 void
 lace_set_verbosity(int level)
 {
@@ -666,7 +1041,11 @@ lace_init(int n, size_t dqsize)
     if (n_workers == 0) n_workers = get_cpu_count();
     enabled_workers = n_workers;
     if (dqsize != 0) default_dqsize = dqsize;
+
+    // Determine the topology of the workers
+    lace_init_topology();
     lace_quits = 0;
+    workers_exited = 0;
 
     // Create barrier for all workers
     lace_barrier_init();
@@ -752,6 +1131,19 @@ lace_startup(size_t stacksize, lace_startup_cb cb, void *arg)
     }
 }
 
+void
+lace_startup_background(size_t stacksize)
+{
+    if (stacksize == 0) stacksize = default_stacksize;
+
+    if (verbosity) {
+        fprintf(stderr, "Lace startup, creating %d background worker threads with program stack %zu bytes.\n", n_workers, stacksize);
+    }
+
+    int i;
+    for (i=0; i<n_workers; i++) lace_spawn_worker(i, stacksize, 0, 0);
+}
+
 #if LACE_COUNT_EVENTS
 static uint64_t ctr_all[CTR_MAX];
 #endif
@@ -816,6 +1208,14 @@ lace_count_report_file(FILE *file)
         ctr_all[CTR_steal_tries], ctr_all[CTR_leaps],
         ctr_all[CTR_leap_busy], ctr_all[CTR_leap_tries]);
     fprintf(file, "\n");
+
+    for (i=0;i<n_workers;i++) {
+        fprintf(file, "Steals from NUMA node (%d): %zu local/%zu remote\n", i,
+            workers_p[i]->ctr[CTR_steal_local], workers_p[i]->ctr[CTR_steal_remote]);
+    }
+    fprintf(file, "Steals from NUMA node (sum): %zu local/%zu remote\n",
+        ctr_all[CTR_steal_local], ctr_all[CTR_steal_remote]);
+    fprintf(file, "\n");
 #endif
 
 #if LACE_COUNT_STEALS && LACE_COUNT_TASKS
@@ -878,8 +1278,310 @@ lace_count_report_file(FILE *file)
     (void)file;
 }
 
+#if LACE_TRACE
+volatile int lace_tracing = 0;
+
+// calibration of gethrtime: ticks and nanoseconds at lace_trace_start and lace_trace_stop
+static uint64_t trace_ticks_start, trace_ticks_stop = 0;
+static uint64_t trace_ns_start, trace_ns_stop;
+
+static uint64_t
+trace_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void
+lace_trace_start(void)
+{
+    int i;
+    for (i=0; i<n_workers; i++) workers_p[i]->trace_next = 0;
+    trace_ns_start = trace_now_ns();
+    trace_ticks_start = gethrtime();
+    trace_ticks_stop = 0;
+    mfence();
+    lace_tracing = 1;
+}
+
+void
+lace_trace_stop(void)
+{
+    lace_tracing = 0;
+    mfence();
+    trace_ticks_stop = gethrtime();
+    trace_ns_stop = trace_now_ns();
+}
+
+/**
+ * Nanoseconds per tick of gethrtime, measured between lace_trace_start and lace_trace_stop.
+ */
+static double
+trace_ns_per_tick(void)
+{
+    uint64_t ticks = trace_ticks_stop, ns = trace_ns_stop;
+    if (ticks == 0) {
+        ticks = gethrtime();
+        ns = trace_now_ns();
+    }
+    if (ticks <= trace_ticks_start || ns <= trace_ns_start) return 1.0;
+    return (double)(ns - trace_ns_start) / (double)(ticks - trace_ticks_start);
+}
+
+/**
+ * The events of worker <w> that are still in its ring buffer are <first> to <end> (exclusive).
+ */
+static void
+trace_range(WorkerP *w, uint64_t *first, uint64_t *end)
+{
+    *end = w->trace_next;
+    *first = *end > LACE_TRACE_SIZE ? *end - LACE_TRACE_SIZE : 0;
+}
+
+static int
+trace_victim(const void *p)
+{
+    int i;
+    for (i=0; i<n_workers; i++) if (workers[i] == p) return i;
+    return -1;
+}
+
+void
+lace_trace_write_chrome(FILE *file)
+{
+    const double us_per_tick = trace_ns_per_tick() / 1000.0;
+    int i;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (i=0; i<n_workers; i++) {
+        WorkerP *w = workers_p[i];
+        uint64_t k, first, end, depth = 0;
+        double ts = 0.0;
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+            i == 0 ? "" : ",\n", i, i);
+
+        trace_range(w, &first, &end);
+        for (k=first; k<end; k++) {
+            lace_trace_event_t *e = &w->trace[k & (LACE_TRACE_SIZE-1)];
+            ts = (double)(e->time - trace_ticks_start) * us_per_tick;
+            switch (e->type) {
+            case LACE_TRACE_BEGIN:
+                depth++;
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"depth\":%u}}",
+                    (const char*)e->p, ts, i, e->arg);
+                break;
+            case LACE_TRACE_END:
+                if (depth == 0) break; // the task began before the first event in the buffer
+                depth--;
+                fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", ts, i);
+                break;
+            case LACE_TRACE_SPAWN:
+                fprintf(file, ",\n{\"name\":\"spawn %s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"depth\":%u}}",
+                    (const char*)e->p, ts, i, e->arg);
+                break;
+            case LACE_TRACE_STEAL:
+                fprintf(file, ",\n{\"name\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"victim\":%d,\"depth\":%u}}",
+                    ts, i, trace_victim(e->p), e->arg);
+                break;
+            }
+        }
+
+        // end the tasks that were still running at the last event
+        while (depth-- > 0) fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", ts, i);
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+/**
+ * Hash table from stacks of tasks (strings) to ticks, for lace_trace_write_folded.
+ */
+typedef struct trace_stack {
+    char *stack;
+    uint64_t ticks;
+} trace_stack_t;
+
+typedef struct trace_stacks {
+    trace_stack_t *table;
+    size_t size, count;
+} trace_stacks_t;
+
+static uint64_t
+trace_stack_hash(const char *stack)
+{
+    uint64_t h = 14695981039346656037ULL;
+    while (*stack) h = (h ^ (uint8_t)*stack++) * 1099511628211ULL;
+    return h;
+}
+
+static void
+trace_stacks_add(trace_stacks_t *stacks, const char *stack, uint64_t ticks)
+{
+    if (2*(stacks->count+1) > stacks->size) {
+        // grow the table
+        trace_stacks_t grown = { NULL, stacks->size == 0 ? 1024 : 2*stacks->size, 0 };
+        size_t i;
+        grown.table = (trace_stack_t*)calloc(grown.size, sizeof(trace_stack_t));
+        if (grown.table == NULL) {
+            fprintf(stderr, "Lace error: Unable to allocate memory for the trace!\n");
+            exit(1);
+        }
+        for (i=0; i<stacks->size; i++) {
+            trace_stack_t *s = &stacks->table[i];
+            if (s->stack == NULL) continue;
+            size_t j = trace_stack_hash(s->stack) & (grown.size-1);
+            while (grown.table[j].stack != NULL) j = (j+1) & (grown.size-1);
+            grown.table[j] = *s;
+        }
+        grown.count = stacks->count;
+        free(stacks->table);
+        *stacks = grown;
+    }
+
+    size_t j = trace_stack_hash(stack) & (stacks->size-1);
+    while (stacks->table[j].stack != NULL) {
+        if (strcmp(stacks->table[j].stack, stack) == 0) {
+            stacks->table[j].ticks += ticks;
+            return;
+        }
+        j = (j+1) & (stacks->size-1);
+    }
+    stacks->table[j].stack = strdup(stack);
+    if (stacks->table[j].stack == NULL) {
+        fprintf(stderr, "Lace error: Unable to allocate memory for the trace!\n");
+        exit(1);
+    }
+    stacks->table[j].ticks = ticks;
+    stacks->count++;
+}
+
+static int
+trace_stack_cmp(const void *a, const void *b)
+{
+    const trace_stack_t *sa = (const trace_stack_t *)a, *sb = (const trace_stack_t *)b;
+    if (sa->stack == NULL || sb->stack == NULL) return (sa->stack == NULL) - (sb->stack == NULL);
+    return strcmp(sa->stack, sb->stack);
+}
+
+void
+lace_trace_write_folded(FILE *file)
+{
+    const double ns_per_tick = trace_ns_per_tick();
+    trace_stacks_t stacks = { NULL, 0, 0 };
+    struct { size_t len; uint64_t begin, children; } *frames = NULL;
+    size_t frames_size = 0, buf_size = 256;
+    char *buf = (char*)malloc(buf_size);
+    int i;
+
+    if (buf == NULL) {
+        fprintf(stderr, "Lace error: Unable to allocate memory for the trace!\n");
+        exit(1);
+    }
+
+    for (i=0; i<n_workers; i++) {
+        WorkerP *w = workers_p[i];
+        uint64_t k, first, end, depth = 0, idle_since, last;
+        size_t len = (size_t)sprintf(buf, "worker %d", i), base = len;
+
+        // the stack of running tasks is "worker N;task;subtask;..." in buf
+        trace_range(w, &first, &end);
+        idle_since = first == 0 ? trace_ticks_start : w->trace[first & (LACE_TRACE_SIZE-1)].time;
+        last = idle_since;
+        for (k=first; k<end; k++) {
+            lace_trace_event_t *e = &w->trace[k & (LACE_TRACE_SIZE-1)];
+            last = e->time;
+            if (e->type == LACE_TRACE_BEGIN) {
+                const char *name = (const char*)e->p;
+                size_t n = strlen(name);
+                if (depth == 0 && e->time > idle_since) {
+                    strcpy(buf + base, ";[idle]");
+                    trace_stacks_add(&stacks, buf, e->time - idle_since);
+                    buf[base] = 0;
+                }
+                if (depth == frames_size) {
+                    frames_size = frames_size == 0 ? 64 : 2*frames_size;
+                    frames = realloc(frames, frames_size * sizeof(*frames));
+                }
+                if (len + n + 2 > buf_size) {
+                    while (len + n + 2 > buf_size) buf_size *= 2;
+                    buf = (char*)realloc(buf, buf_size);
+                }
+                if (frames == NULL || buf == NULL) {
+                    fprintf(stderr, "Lace error: Unable to allocate memory for the trace!\n");
+                    exit(1);
+                }
+                frames[depth].len = len;
+                frames[depth].begin = e->time;
+                frames[depth].children = 0;
+                depth++;
+                buf[len++] = ';';
+                memcpy(buf + len, name, n + 1);
+                len += n;
+            } else if (e->type == LACE_TRACE_END) {
+                if (depth == 0) {
+                    // the task began before the first event in the buffer; the worker was not idle
+                    idle_since = e->time;
+                    continue;
+                }
+                depth--;
+                uint64_t total = e->time - frames[depth].begin;
+                trace_stacks_add(&stacks, buf, total - frames[depth].children);
+                len = frames[depth].len;
+                buf[len] = 0;
+                if (depth > 0) frames[depth-1].children += total;
+                else idle_since = e->time;
+            }
+        }
+
+        // end the tasks that were still running at the end of the trace
+        if (trace_ticks_stop > last) last = trace_ticks_stop;
+        if (depth == 0 && last > idle_since) {
+            strcpy(buf + base, ";[idle]");
+            trace_stacks_add(&stacks, buf, last - idle_since);
+        }
+        while (depth > 0) {
+            depth--;
+            uint64_t total = last - frames[depth].begin;
+            trace_stacks_add(&stacks, buf, total - frames[depth].children);
+            len = frames[depth].len;
+            buf[len] = 0;
+            if (depth > 0) frames[depth-1].children += total;
+        }
+    }
+
+    // write the stacks in lexicographic order
+    if (stacks.size != 0) qsort(stacks.table, stacks.size, sizeof(trace_stack_t), trace_stack_cmp);
+    size_t j;
+    for (j=0; j<stacks.count; j++) {
+        fprintf(file, "%s %llu\n", stacks.table[j].stack, (unsigned long long)(stacks.table[j].ticks * ns_per_tick + 0.5));
+        free(stacks.table[j].stack);
+    }
+
+    free(stacks.table);
+    free(frames);
+    free(buf);
+}
+#endif
+
 void lace_exit()
 {
+    if (lace_get_worker() == NULL) {
+        // all workers run in the background (lace_startup_background): let them quit and wait until they have left
+        lace_quits = 1;
+        wake_sleeping_fenced();
+        while (workers_exited != n_workers) {
+            struct timespec timeout = { 0, 100000 };
+            nanosleep(&timeout, NULL);
+        }
+        lace_barrier_destroy();
+        pthread_barrier_destroy(&suspend_barrier);
+#if LACE_COUNT_EVENTS
+        lace_count_report_file(stderr);
+#endif
+        return;
+    }
+
     lace_time_event(lace_get_worker(), 2);
 
     // first suspend all other threads
@@ -902,6 +1604,15 @@ void lace_exit()
 #endif
 }
 
+void
+lace_inlined(WorkerP *__lace_worker, Task *__lace_dq_head, Task *t)
+{
+    // the task was executed by SPAWN and its result is in the task already
+    (void)__lace_worker;
+    (void)__lace_dq_head;
+    (void)t;
+}
+
 void
 lace_exec_in_new_frame(WorkerP *__lace_worker, Task *__lace_dq_head, Task *root)
 {
@@ -952,6 +1663,7 @@ VOID_TASK_IMPL_2(lace_steal_loop_root, Task*, t, int*, done)
 {
     t->f(__lace_worker, __lace_dq_head, t);
     *done = 1;
+    wake_sleeping_fenced();
 }
 
 VOID_TASK_2(lace_together_helper, Task*, t, volatile int*, finished)
@@ -1017,6 +1729,7 @@ lace_do_together(WorkerP *__lace_worker, Task *__lace_dq_head, Task *t)
     t2->d.args.arg_2 = &done;
 
     while (!cas(&lace_newframe.t, 0, &_t2)) lace_yield(__lace_worker, __lace_dq_head);
+    wake_sleeping_fenced();
     lace_sync_and_exec(__lace_worker, __lace_dq_head, &_t2);
 }
 
@@ -1044,5 +1757,6 @@ lace_do_newframe(WorkerP *__lace_worker, Task *__lace_dq_head, Task *t)
     compiler_barrier();
 
     while (!cas(&lace_newframe.t, 0, &_s)) lace_yield(__lace_worker, __lace_dq_head);
+    wake_sleeping_fenced();
     lace_sync_and_exec(__lace_worker, __lace_dq_head, &_t2);
 }
@@ -52,6 +52,26 @@ extern "C" {
 #define LACE_COUNT_SPLITS 0
 #endif
 
+#ifndef LACE_CUTOFF_DEPTH /* SPAWN executes a task immediately when the deque has this many private tasks (0 = never) */
+#define LACE_CUTOFF_DEPTH 8
+#endif
+
+#ifndef LACE_STEAL_LOCAL_TRIES /* Failed steal attempts before stealing outside the core complex, and then outside the NUMA node */
+#define LACE_STEAL_LOCAL_TRIES 8
+#endif
+
+#ifndef LACE_IDLE_SPINS /* Failed steal attempts before an idle worker backs off and then sleeps (0 = never) */
+#define LACE_IDLE_SPINS 100000
+#endif
+
+#ifndef LACE_TRACE /* Record task events in a ring buffer per worker (see lace_trace_start) */
+#define LACE_TRACE 0
+#endif
+
+#ifndef LACE_TRACE_SIZE /* Number of events in the trace ring buffer of each worker (power of 2) */
+#define LACE_TRACE_SIZE (1<<18)
+#endif
+
 #ifndef LACE_COUNT_EVENTS
 #define LACE_COUNT_EVENTS (LACE_PIE_TIMES || LACE_COUNT_TASKS || LACE_COUNT_STEALS || LACE_COUNT_SPLITS)
 #endif
@@ -92,7 +112,7 @@ extern "C" {
 #define unlikely(x)     __builtin_expect((x),0)
 #endif
 
-#if LACE_PIE_TIMES
+#if LACE_PIE_TIMES || LACE_TRACE
 /* High resolution timer */
 static inline uint64_t gethrtime()
 {
@@ -107,6 +127,30 @@ void lace_count_reset();
 void lace_count_report_file(FILE *file);
 #endif
 
+#if LACE_TRACE
+/**
+ * Record a trace of the tasks executed by each worker: the begin and end of every task,
+ * spawned tasks and steals, with the time (gethrtime) and the name of the task.
+ * Each worker keeps the last LACE_TRACE_SIZE events in a ring buffer.
+ * Start and stop recording between Lace tasks; write the trace after lace_trace_stop.
+ */
+void lace_trace_start(void);
+void lace_trace_stop(void);
+
+/**
+ * Write the trace in the JSON format of the Chrome trace viewer (chrome://tracing, Perfetto),
+ * with one thread per worker. Times are in microseconds.
+ */
+void lace_trace_write_chrome(FILE *file);
+
+/**
+ * Write the trace in the folded stack format of flame graphs ("worker 0;task;subtask ns"),
+ * i.e., the time in nanoseconds spent in every stack of tasks, excluding subtasks.
+ * Time that a worker spends outside of tasks is written as "worker N;[idle]".
+ */
+void lace_trace_write_folded(FILE *file);
+#endif
+
 #if LACE_COUNT_TASKS
 #define PR_COUNTTASK(s) PR_INC(s,CTR_tasks)
 #else
@@ -143,6 +187,8 @@ typedef enum {
     CTR_leaps,       /* Number of succesful leaps */
     CTR_steal_busy,  /* Number of steal busies */
     CTR_leap_busy,   /* Number of leap busies */
+    CTR_steal_local, /* Number of succesful steals from the same NUMA node */
+    CTR_steal_remote,/* Number of succesful steals from another NUMA node */
 #endif
 #ifdef LACE_COUNT_SPLITS
     CTR_split_grow,  /* Number of split right */
@@ -170,6 +216,22 @@ struct _WorkerP;
 struct _Worker;
 struct _Task;
 
+#if LACE_TRACE
+typedef enum {
+    LACE_TRACE_BEGIN,   /* Begin of a task (p = name, arg = position in the deque) */
+    LACE_TRACE_END,     /* End of a task (p = name) */
+    LACE_TRACE_SPAWN,   /* Task put on the deque (p = name, arg = position in the deque) */
+    LACE_TRACE_STEAL,   /* Task stolen (p = victim, arg = position in the deque of the victim) */
+} lace_trace_type;
+
+typedef struct lace_trace_event {
+    uint64_t time;
+    const void *p;
+    uint32_t type;
+    uint32_t arg;
+} lace_trace_event_t;
+#endif
+
 #define THIEF_EMPTY     ((struct _Worker*)0x0)
 #define THIEF_TASK      ((struct _Worker*)0x1)
 #define THIEF_COMPLETED ((struct _Worker*)0x2)
@@ -214,6 +276,10 @@ typedef struct _WorkerP {
     size_t stack_trigger;       // for stack overflow detection
     uint64_t rng;               // my random seed (for lace_trng)
     uint32_t seed;              // my random seed (for lace_steal_random)
+    uint32_t steal_fails;       // number of failed steal attempts since the last steal
+    int16_t *victims;           // other workers, nearest first (for victim selection)
+    int16_t victims_cluster;    // number of victims in my core complex
+    int16_t victims_node;       // number of victims in my NUMA node (including my core complex)
     int16_t worker;             // what is my worker id?
     uint8_t allstolen;          // my allstolen
     volatile int8_t enabled;    // if this worker is enabled
@@ -224,9 +290,32 @@ typedef struct _WorkerP {
     volatile int level;
 #endif
 
+#if LACE_TRACE
+    lace_trace_event_t *trace;  // ring buffer of trace events
+    uint64_t trace_next;        // number of recorded trace events
+#endif
+
     int16_t pu;                 // my pu (for HWLOC)
 } WorkerP;
 
+#if LACE_TRACE
+extern volatile int lace_tracing;
+
+static inline void
+lace_trace_record(WorkerP *w, uint32_t type, const void *p, uint32_t arg)
+{
+    lace_trace_event_t *e = &w->trace[w->trace_next++ & (LACE_TRACE_SIZE-1)];
+    e->time = gethrtime();
+    e->p = p;
+    e->type = type;
+    e->arg = arg;
+}
+
+#define LACE_TRACE_EVENT(w, type, p, arg) { if (unlikely(lace_tracing)) lace_trace_record((w), (type), (p), (arg)); }
+#else
+#define LACE_TRACE_EVENT(w, type, p, arg) /* Empty */
+#endif
+
 #define LACE_TYPEDEF_CB(t, f, ...) typedef t (*f)(WorkerP *, Task *, ##__VA_ARGS__);
 LACE_TYPEDEF_CB(void, lace_startup_cb, void*);
 
@@ -236,6 +325,13 @@ LACE_TYPEDEF_CB(void, lace_startup_cb, void*);
  */
 void lace_set_verbosity(int level);
 
+/**
+ * Set the number of failed steal attempts after which an idle worker backs off exponentially,
+ * and then sleeps until there is new work, instead of spinning (0 = always spin).
+ * Default: LACE_IDLE_SPINS
+ */
+void lace_set_idle_spins(unsigned int spins);
+
 /**
  * Initialize master structures for Lace with <n_workers> workers
  * and default deque size of <dqsize>.
@@ -252,6 +348,12 @@ void lace_init(int n_workers, size_t dqsize);
  */
 void lace_startup(size_t stacksize, lace_startup_cb, void* arg);
 
+/**
+ * After lace_init, start all workers as background threads; the current thread does not become a worker.
+ * Use RUN or SUBMIT to execute tasks from this thread (or any other thread), and lace_exit to stop the workers.
+ */
+void lace_startup_background(size_t stacksize);
+
 /**
  * Initialize current thread as worker <idx> and allocate a deque with size <dqsize>.
  * Use this when manually creating worker threads.
@@ -323,9 +425,26 @@ Task *lace_get_head(WorkerP *);
 
 /**
  * Exit Lace. Automatically called when started with cb,arg.
+ * After lace_startup_background, call lace_exit from a thread that is not a worker.
  */
 void lace_exit();
 
+/**
+ * A task submitted with SUBMIT, typically by a thread that is not a Lace worker.
+ * Idle workers execute submitted tasks in the order of submission, as root tasks.
+ * The future must stay valid until the task is done; wait with lace_future_wait or poll with lace_future_done,
+ * then get the result with FUTURE_RESULT.
+ */
+typedef struct lace_future {
+    Task task;
+    struct lace_future *next;
+    volatile int done;
+} lace_future_t;
+
+void lace_submit(lace_future_t *fut);
+void lace_future_wait(lace_future_t *fut);
+static inline int lace_future_done(lace_future_t *fut) { return fut->done; }
+
 #define LACE_STOLEN   ((Worker*)0)
 #define LACE_BUSY     ((Worker*)1)
 #define LACE_NOWORK   ((Worker*)2)
@@ -338,6 +457,9 @@ void lace_exit();
 #define CALL(f, ...)      ( WRAP(f##_CALL, ##__VA_ARGS__) )
 #define TOGETHER(f, ...)  ( WRAP(f##_TOGETHER, ##__VA_ARGS__) )
 #define NEWFRAME(f, ...)  ( WRAP(f##_NEWFRAME, ##__VA_ARGS__) )
+#define SUBMIT(f, fut, ...) ( f##_SUBMIT((fut), ##__VA_ARGS__) )
+#define RUN(f, ...)       ( f##_RUN(__VA_ARGS__) )
+#define FUTURE_RESULT(f, fut) ( ((TD_##f *)&(fut)->task)->d.res )
 #define STEAL_RANDOM()    ( CALL(lace_steal_random) )
 #define LACE_WORKER_ID    ( __lace_worker->worker )
 #define LACE_WORKER_PU    ( __lace_worker->pu )
@@ -349,6 +471,13 @@ void lace_exit();
 #define TASK_IS_COMPLETED(t) ((size_t)t->thief == 2)
 #define TASK_RESULT(t) (&t->d[0])
 
+/**
+ * A task that SPAWN executed immediately (see LACE_CUTOFF_DEPTH) already holds its result.
+ * It stays on the deque until SYNC; if it is stolen in the meantime, the thief does nothing.
+ */
+void lace_inlined(WorkerP *, Task *, Task *);
+#define TASK_IS_INLINED(t) ((t)->f == &lace_inlined)
+
 #if LACE_DEBUG_PROGRAMSTACK
 static inline void CHECKSTACK(WorkerP *w)
 {
@@ -385,6 +514,14 @@ void lace_do_newframe(WorkerP *__lace_worker, Task *__lace_dq_head, Task *task);
 void lace_yield(WorkerP *__lace_worker, Task *__lace_dq_head);
 #define YIELD_NEWFRAME() { if (unlikely((*(Task* volatile *)&lace_newframe.t) != NULL)) lace_yield(__lace_worker, __lace_dq_head); }
 
+/**
+ * Number of idle workers that sleep (see lace_set_idle_spins).
+ * SPAWN wakes them, as do TOGETHER, NEWFRAME and lace_suspend.
+ */
+extern volatile int lace_sleeping;
+void lace_wake_sleeping(void);
+#define WAKE_SLEEPING() { if (unlikely(lace_sleeping != 0)) lace_wake_sleeping(); }
+
 /**
  * Compute a random number, thread-local
  */
@@ -499,6 +636,7 @@ lace_steal(WorkerP *self, Task *__dq_head, Worker *victim)
                 // Stolen
                 Task *t = &victim->dq[ts.ts.tail];
                 t->thief = self->_public;
+                LACE_TRACE_EVENT(self, LACE_TRACE_STEAL, victim, ts.ts.tail);
                 lace_time_event(self, 1);
                 t->f(self, __dq_head, t);
                 lace_time_event(self, 2);
@@ -644,12 +782,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head )
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head );                                       \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
                                                                                       \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -697,6 +851,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head )
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut )                                               \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN()                                                                    \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) );                          \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut );                                                             \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -726,6 +900,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head );                                                \
 }                                                                                     \
                                                                                       \
@@ -734,9 +909,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head );                                        \
         }                                                                             \
@@ -760,7 +940,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head );
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head )                                       \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head );                                                \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head );                                           \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -794,12 +977,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head )
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head );                                                   \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
                                                                                       \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -847,6 +1045,25 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head )
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut )                                               \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN()                                                                     \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) ); return; }                     \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut );                                                             \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -876,6 +1093,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head );                                                \
 }                                                                                     \
                                                                                       \
@@ -884,9 +1102,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head );                                        \
         }                                                                             \
@@ -910,7 +1133,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head );
 void NAME##_CALL(WorkerP *w, Task *__dq_head )                                        \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head );                                                \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head );                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -947,12 +1172,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1);                                \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1;                                                         \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1000,6 +1241,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1)                                \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1;                                                         \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1)                                                       \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1);                   \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1);                                                      \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1029,6 +1291,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                               \
 }                                                                                     \
                                                                                       \
@@ -1037,9 +1300,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                       \
         }                                                                             \
@@ -1063,7 +1331,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1);
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)                        \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1);                                         \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1);                                    \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1097,12 +1368,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1);                                            \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1;                                                         \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1150,6 +1436,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1)                                \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1;                                                         \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1)                                                        \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1); return; }              \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1);                                                      \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1179,6 +1485,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                               \
 }                                                                                     \
                                                                                       \
@@ -1187,9 +1494,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                       \
         }                                                                             \
@@ -1213,7 +1525,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1);
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)                         \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1);                                         \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1);                                                \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1250,12 +1564,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2);                         \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1303,6 +1633,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2)                 \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2)                                        \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2);            \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2);                                               \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1332,6 +1683,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);              \
 }                                                                                     \
                                                                                       \
@@ -1340,9 +1692,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);      \
         }                                                                             \
@@ -1366,7 +1723,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)         \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2);                                  \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1, arg_2);                             \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1400,12 +1760,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2);                                     \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1453,6 +1828,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2)                 \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2)                                         \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2); return; }       \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2);                                               \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1482,6 +1877,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);              \
 }                                                                                     \
                                                                                       \
@@ -1490,9 +1886,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);      \
         }                                                                             \
@@ -1516,7 +1917,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_2
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)          \
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2);                                  \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1, arg_2);                                         \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1553,12 +1956,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3);                  \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1606,6 +2025,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)  \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)                         \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3);     \
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3);                                        \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1635,6 +2075,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
 }                                                                                     \
                                                                                       \
@@ -1643,9 +2084,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
         }                                                                             \
@@ -1669,7 +2115,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3);                           \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3);                      \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1703,12 +2152,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3);                              \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1756,6 +2220,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)  \
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)                          \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3); return; }\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3);                                        \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1785,6 +2269,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
 }                                                                                     \
                                                                                       \
@@ -1793,9 +2278,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
         }                                                                             \
@@ -1819,7 +2309,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_2
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3);                           \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3);                                  \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -1856,12 +2348,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4);           \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -1909,6 +2417,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)          \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4);\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4);                                 \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1938,6 +2467,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
 }                                                                                     \
                                                                                       \
@@ -1946,9 +2476,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
         }                                                                             \
@@ -1972,7 +2507,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4);                    \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4);               \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -2006,12 +2544,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4);                       \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -2059,6 +2612,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)           \
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4); return; }\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4);                                 \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2088,6 +2661,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
 }                                                                                     \
                                                                                       \
@@ -2096,9 +2670,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
         }                                                                             \
@@ -2122,7 +2701,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_2
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4);                    \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4);                           \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -2159,12 +2740,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);    \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -2212,6 +2809,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4, arg_5);\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4, arg_5);                          \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -2241,6 +2859,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
 }                                                                                     \
                                                                                       \
@@ -2249,9 +2868,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
         }                                                                             \
@@ -2275,7 +2899,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);             \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);        \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -2309,12 +2936,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);                \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -2362,6 +3004,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4, arg_5); return; }\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4, arg_5);                          \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2391,6 +3053,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
 }                                                                                     \
                                                                                       \
@@ -2399,9 +3062,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
         }                                                                             \
@@ -2425,7 +3093,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_2
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);             \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);                    \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -2462,12 +3132,28 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);\
+        t = (TD_##NAME *)__dq_head;                                                   \
+        t->d.res = res;                                                               \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -2515,6 +3201,27 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) return NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);                   \
+    lace_future_wait(&fut);                                                           \
+    return ((TD_##NAME *)&fut.task)->d.res;                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -2544,6 +3251,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return t->d.res;                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
 }                                                                                     \
                                                                                       \
@@ -2552,9 +3260,14 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return t->d.res;                                                              \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
         }                                                                             \
@@ -2578,7 +3291,10 @@ RTYPE NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_
 RTYPE NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);      \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    RTYPE res = NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6); \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
+    return res;                                                                       \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
@@ -2612,12 +3328,27 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
                                                                                       \
     /* assert(__dq_head < w->end); */ /* Assuming to be true */                       \
                                                                                       \
+    if (LACE_CUTOFF_DEPTH && likely(!w->allstolen) && likely(0 == w->_public->movesplit) &&\
+            __dq_head - w->split >= LACE_CUTOFF_DEPTH) {                              \
+        /* enough private tasks to share on demand: execute the task now */           \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);         \
+        t = (TD_##NAME *)__dq_head;                                                   \
+        ((Task *)t)->f = &lace_inlined;                                               \
+        /* if tasks of the call were stolen, all tasks may be stolen now: then the */ \
+        /* slot counts as stolen and SYNC must find it completed */                   \
+        t->thief = unlikely(w->allstolen) ? THIEF_COMPLETED : THIEF_TASK;             \
+        return;                                                                       \
+    }                                                                                 \
+                                                                                      \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->f = &NAME##_WRAP;                                                              \
     t->thief = THIEF_TASK;                                                            \
      t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
     compiler_barrier();                                                               \
                                                                                       \
+    LACE_TRACE_EVENT(w, LACE_TRACE_SPAWN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    WAKE_SLEEPING();                                                                  \
+                                                                                      \
     Worker *wt = w->_public;                                                          \
     if (unlikely(w->allstolen)) {                                                     \
         if (wt->movesplit) wt->movesplit = 0;                                         \
@@ -2665,6 +3396,26 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_SUBMIT(lace_future_t *fut , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    TD_##NAME *t = (TD_##NAME *)&fut->task;                                           \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+    lace_submit(fut);                                                                 \
+}                                                                                     \
+                                                                                      \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    WorkerP *w = lace_get_worker();                                                   \
+    if (w != NULL) { NAME##_CALL(w, lace_get_head(w) , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6); return; }\
+    lace_future_t fut;                                                                \
+    NAME##_SUBMIT(&fut , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);                   \
+    lace_future_wait(&fut);                                                           \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2694,6 +3445,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED((Task *)t)) return ;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
 }                                                                                     \
                                                                                       \
@@ -2702,9 +3454,14 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
 {                                                                                     \
     /* assert (__dq_head > 0); */  /* Commented out because we assume contract */     \
                                                                                       \
+    TD_##NAME *t = (TD_##NAME *)__dq_head;                                            \
+    if (LACE_CUTOFF_DEPTH && TASK_IS_INLINED((Task *)t) && likely(w->split <= __dq_head)) {\
+        t->thief = THIEF_EMPTY;                                                       \
+        return ;                                                                      \
+    }                                                                                 \
+                                                                                      \
     if (likely(0 == w->_public->movesplit)) {                                         \
         if (likely(w->split <= __dq_head)) {                                          \
-            TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
         }                                                                             \
@@ -2728,7 +3485,9 @@ void NAME##_WORK(WorkerP *__lace_worker, Task *__lace_dq_head , ATYPE_1, ATYPE_2
 void NAME##_CALL(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
 {                                                                                     \
     CHECKSTACK(w);                                                                    \
-    return NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);      \
+    LACE_TRACE_EVENT(w, LACE_TRACE_BEGIN, #NAME, (uint32_t)(__dq_head - w->dq));      \
+    NAME##_WORK(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);             \
+    LACE_TRACE_EVENT(w, LACE_TRACE_END, #NAME, 0);                                    \
 }                                                                                     \
                                                                                       \
 static inline __attribute__((always_inline))                                          \
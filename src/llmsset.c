@@ -25,8 +25,8 @@
 #include <sys/mman.h> // for mmap
 
 #include <llmsset.h>
+#include <sylvan_mem.h>
 #include <sylvan_stats.h>
-#include <tls.h>
 
 #ifndef USE_HWLOC
 #define USE_HWLOC 0
@@ -42,23 +42,33 @@ static hwloc_topology_t topo;
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
+#if LLMSSET_HASH_SIMD && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h> // for the AVX2/AVX-512 hash functions, selected at runtime
+#define LLMSSET_HASH_X86 1
+#else
+#define LLMSSET_HASH_X86 0
+#endif
+
 #ifndef cas
 #define cas(ptr, old, new) (__sync_bool_compare_and_swap((ptr),(old),(new)))
 #endif
 
-DECLARE_THREAD_LOCAL(my_region, uint64_t);
+/**
+ * Every worker claims regions of 512 data buckets and allocates from its current region.
+ * The current region of worker <w> is dbs->regions[w * REGION_STRIDE], one cache line per worker.
+ */
+#define REGION_STRIDE ((LINE_SIZE) / 8)
 
-VOID_TASK_0(llmsset_reset_region)
+VOID_TASK_1(llmsset_reset_region, llmsset_t, dbs)
 {
-    LOCALIZE_THREAD_LOCAL(my_region, uint64_t);
-    my_region = (uint64_t)-1; // no region
-    SET_THREAD_LOCAL(my_region, my_region);
+    dbs->regions[LACE_WORKER_ID * REGION_STRIDE] = (uint64_t)-1; // no region
 }
 
 static uint64_t
 claim_data_bucket(const llmsset_t dbs)
 {
-    LOCALIZE_THREAD_LOCAL(my_region, uint64_t);
+    const uint64_t worker = lace_get_worker()->worker;
+    uint64_t my_region = dbs->regions[worker * REGION_STRIDE];
 
     for (;;) {
         if (my_region != (uint64_t)-1) {
@@ -77,7 +87,7 @@ claim_data_bucket(const llmsset_t dbs)
             }
         } else {
             // special case on startup or after garbage collection
-            my_region += (lace_get_worker()->worker*(dbs->table_size/(64*8)))/lace_workers();
+            my_region += (worker*(dbs->table_size/(64*8)))/lace_workers();
         }
         uint64_t count = dbs->table_size/(64*8);
         for (;;) {
@@ -97,7 +107,7 @@ restart:
             if (cas(ptr, v, v|mask)) break;
             else goto restart;
         }
-        SET_THREAD_LOCAL(my_region, my_region);
+        dbs->regions[worker * REGION_STRIDE] = my_region;
     }
 }
 
@@ -150,6 +160,94 @@ llmsset_hash(const uint64_t a, const uint64_t b, const uint64_t seed)
     return hash ^ (hash >> 32);
 }
 
+static void
+llmsset_hash_many_scalar(size_t count, const uint64_t *a, const uint64_t *b, const uint64_t seed, uint64_t *hashes)
+{
+    for (size_t i=0; i<count; i++) hashes[i] = llmsset_hash(a[i], b[i], seed);
+}
+
+#if LLMSSET_HASH_X86
+/* 64-bit multiplication (low 64 bits) with AVX2, from three 32x32-bit multiplications */
+static inline __m256i __attribute__((target("avx2")))
+llmsset_mullo_avx2(__m256i x, __m256i y)
+{
+    __m256i lo = _mm256_mul_epu32(x, y);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y), _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+/* llmsset_hash of 4 keys at once */
+static void __attribute__((target("avx2")))
+llmsset_hash_many_avx2(size_t count, const uint64_t *a, const uint64_t *b, const uint64_t seed, uint64_t *hashes)
+{
+    const __m256i prime = _mm256_set1_epi64x(1099511628211);
+    const __m256i s = _mm256_set1_epi64x(seed);
+    size_t i = 0;
+    for (; i+4<=count; i+=4) {
+        __m256i hash = _mm256_xor_si256(s, _mm256_loadu_si256((const __m256i*)(a+i)));
+        hash = _mm256_or_si256(_mm256_slli_epi64(hash, 47), _mm256_srli_epi64(hash, 17));
+        hash = llmsset_mullo_avx2(hash, prime);
+        hash = _mm256_xor_si256(hash, _mm256_loadu_si256((const __m256i*)(b+i)));
+        hash = _mm256_or_si256(_mm256_slli_epi64(hash, 31), _mm256_srli_epi64(hash, 33));
+        hash = llmsset_mullo_avx2(hash, prime);
+        hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 32));
+        _mm256_storeu_si256((__m256i*)(hashes+i), hash);
+    }
+    llmsset_hash_many_scalar(count-i, a+i, b+i, seed, hashes+i);
+}
+
+/* llmsset_hash of 8 keys at once */
+static void __attribute__((target("avx512f,avx512dq")))
+llmsset_hash_many_avx512(size_t count, const uint64_t *a, const uint64_t *b, const uint64_t seed, uint64_t *hashes)
+{
+    const __m512i prime = _mm512_set1_epi64(1099511628211);
+    const __m512i s = _mm512_set1_epi64(seed);
+    size_t i = 0;
+    for (; i+8<=count; i+=8) {
+        __m512i hash = _mm512_xor_si512(s, _mm512_loadu_si512((const void*)(a+i)));
+        hash = _mm512_mullo_epi64(_mm512_rol_epi64(hash, 47), prime);
+        hash = _mm512_xor_si512(hash, _mm512_loadu_si512((const void*)(b+i)));
+        hash = _mm512_mullo_epi64(_mm512_rol_epi64(hash, 31), prime);
+        hash = _mm512_xor_si512(hash, _mm512_srli_epi64(hash, 32));
+        _mm512_storeu_si512((void*)(hashes+i), hash);
+    }
+    llmsset_hash_many_scalar(count-i, a+i, b+i, seed, hashes+i);
+}
+#endif
+
+typedef void (*llmsset_hash_many_fn)(size_t, const uint64_t*, const uint64_t*, const uint64_t, uint64_t*);
+
+/* the implementation of llmsset_hash_many for this CPU (see llmsset_hash_select) */
+static llmsset_hash_many_fn llmsset_hash_many_impl = llmsset_hash_many_scalar;
+
+int
+llmsset_hash_select(int impl)
+{
+#if LLMSSET_HASH_X86
+    __builtin_cpu_init();
+    const int avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    const int avx2 = __builtin_cpu_supports("avx2");
+    if (impl == LLMSSET_HASH_AUTO) impl = avx512 ? LLMSSET_HASH_AVX512 : avx2 ? LLMSSET_HASH_AVX2 : LLMSSET_HASH_SCALAR;
+    if (impl == LLMSSET_HASH_AVX512 && avx512) {
+        llmsset_hash_many_impl = llmsset_hash_many_avx512;
+        return 1;
+    }
+    if (impl == LLMSSET_HASH_AVX2 && avx2) {
+        llmsset_hash_many_impl = llmsset_hash_many_avx2;
+        return 1;
+    }
+#endif
+    if (impl != LLMSSET_HASH_AUTO && impl != LLMSSET_HASH_SCALAR) return 0;
+    llmsset_hash_many_impl = llmsset_hash_many_scalar;
+    return 1;
+}
+
+void
+llmsset_hash_many(size_t count, const uint64_t *a, const uint64_t *b, const uint64_t seed, uint64_t *hashes)
+{
+    llmsset_hash_many_impl(count, a, b, seed, hashes);
+}
+
 /*
  * CL_MASK and CL_MASK_R are for the probe sequence calculation.
  * With 64 bytes per cacheline, there are 8 64-bit values per cacheline.
@@ -158,145 +256,582 @@ llmsset_hash(const uint64_t a, const uint64_t b, const uint64_t seed)
 static const uint64_t CL_MASK     = ~(((LINE_SIZE) / 8) - 1);
 static const uint64_t CL_MASK_R   = ((LINE_SIZE) / 8) - 1;
 
-/* 40 bits for the index, 24 bits for the hash */
-#define MASK_INDEX ((uint64_t)0x000000ffffffffff)
-#define MASK_HASH  ((uint64_t)0xffffff0000000000)
-
+/* the first bucket of the cache line after the cache line of <idx> (overflow probing) */
 static inline uint64_t
-llmsset_lookup2(const llmsset_t dbs, uint64_t a, uint64_t b, int* created, const int custom)
+llmsset_next_line(uint64_t idx, size_t size)
 {
-    uint64_t hash_rehash = 14695981039346656037LLU;
-    if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
-    else hash_rehash = llmsset_hash(a, b, hash_rehash);
+    idx = (idx & CL_MASK) + ((LINE_SIZE) / 8);
+    return idx < size ? idx : 0;
+}
 
-    const uint64_t hash = hash_rehash & MASK_HASH;
-    uint64_t idx, last, cidx = 0;
-    int i=0;
+/* 40 bits for the index (48 with SYLVAN_WIDE_INDEX), 1 bit to freeze buckets during online resize, the rest for the hash */
+#define MASK_INDEX  SYLVAN_INDEX_MASK
+#define MASK_FROZEN (SYLVAN_INDEX_MASK + 1)
+#define MASK_HASH   (~(MASK_INDEX | MASK_FROZEN))
+
+/* a bucket of which the hash was removed (llmsset_unhash), never matches since index 0 is not used */
+#define TOMBSTONE   MASK_HASH
+
+/**
+ * Read and write the data of a bucket (16 bytes, or 12 bytes with SYLVAN_COMPACT_NODES).
+ */
+static inline void
+llmsset_data_get(const llmsset_t dbs, uint64_t d_idx, uint64_t *a, uint64_t *b)
+{
+    const uint8_t *d_ptr = dbs->data + d_idx * LLMSSET_DATA_SIZE;
+#if SYLVAN_COMPACT_NODES
+    uint32_t b32;
+    memcpy(a, d_ptr, 8);
+    memcpy(&b32, d_ptr + 8, 4);
+    *b = b32;
+#else
+    *a = ((const uint64_t*)d_ptr)[0];
+    *b = ((const uint64_t*)d_ptr)[1];
+#endif
+}
+
+static inline void
+llmsset_data_set(const llmsset_t dbs, uint64_t d_idx, uint64_t a, uint64_t b)
+{
+    uint8_t *d_ptr = dbs->data + d_idx * LLMSSET_DATA_SIZE;
+#if SYLVAN_COMPACT_NODES
+    const uint32_t b32 = (uint32_t)b;
+    memcpy(d_ptr, &a, 8);
+    memcpy(d_ptr + 8, &b32, 4);
+#else
+    ((uint64_t*)d_ptr)[0] = a;
+    ((uint64_t*)d_ptr)[1] = b;
+#endif
+}
+
+/* number of keys of which the first cache line is prefetched ahead by llmsset_lookup_batch */
+#define LLMSSET_BATCH_WINDOW 16
+
+/* number of cache lines migrated by every lookup during an online resize */
+#define LLMSSET_MIGRATE_CHUNK 8
+
+/**
+ * An online resize migrates the buckets of the old hash array to the new hash array.
+ * Every cache line is migrated by the worker that claims it: it freezes every bucket in the line
+ * (so no lookup can insert into it anymore) and then rehashes the buckets into the new array.
+ */
+struct llmsset_migration
+{
+    uint64_t          *table;       // the old hash array
+    size_t            size;         // number of buckets of the old hash array
+    int               threshold;    // threshold of the old hash array
+    uint32_t          overflow;     // overflow of the old hash array
+    size_t            lines;        // number of cache lines of the old hash array
+    uint64_t          *claimed;     // bitmap: cache line claimed for migration
+    uint64_t          *done;        // bitmap: cache line migrated
+    volatile size_t   next;         // next cache line to migrate proactively
+    volatile size_t   count;        // number of migrated cache lines
+    struct llmsset_migration *next_retired;
+};
 
+static inline uint64_t
+llmsset_first_idx(uint64_t hash_rehash, size_t size)
+{
 #if LLMSSET_MASK
-    last = idx = hash_rehash & dbs->mask;
+    return hash_rehash & (size - 1);
 #else
-    last = idx = hash_rehash % dbs->table_size;
+    return hash_rehash % size;
+#endif
+}
+
+static uint64_t*
+llmsset_alloc_table(const llmsset_t dbs)
+{
+    uint64_t *table = (uint64_t*)sylvan_mem_alloc(dbs->max_size * 8);
+    if (table == (uint64_t*)-1) return NULL;
+#if defined(madvise) && defined(MADV_RANDOM)
+    madvise(table, dbs->max_size * 8, MADV_RANDOM);
 #endif
+#if USE_HWLOC
+    hwloc_set_area_membind(topo, table, dbs->max_size * 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_INTERLEAVE, 0);
+#endif
+    return table;
+}
 
+static void
+llmsset_migration_free(const llmsset_t dbs, struct llmsset_migration *m)
+{
+    sylvan_mem_free(m->table, dbs->max_size * 8);
+    sylvan_mem_free(m->claimed, ((m->lines + 63) / 64) * 8);
+    sylvan_mem_free(m->done, ((m->lines + 63) / 64) * 8);
+    free(m);
+}
+
+/**
+ * Called by the worker that migrated the last cache line.
+ */
+static void
+llmsset_migration_finish(const llmsset_t dbs, struct llmsset_migration *m)
+{
+    dbs->resize_seq++;
+    compiler_barrier();
+    dbs->migration = NULL;
+    compiler_barrier();
+    dbs->resize_seq++;
+
+    // lookups may still read the old array, so it is only released during garbage collection
+    m->next_retired = dbs->retired;
+    dbs->retired = m;
+
+    compiler_barrier();
+    dbs->resize_state = 0;
+}
+
+static void
+llmsset_migrate_line(const llmsset_t dbs, struct llmsset_migration *m, uint64_t line)
+{
+    volatile uint64_t *bucket = m->table + line * ((LINE_SIZE) / 8);
+    for (int k=0; k<(LINE_SIZE)/8; k++, bucket++) {
+        uint64_t v;
+        do { v = *bucket; } while (!cas(bucket, v, v | MASK_FROZEN));
+        if (v != 0 && v != TOMBSTONE) llmsset_rehash_bucket(dbs, v & MASK_INDEX);
+    }
+
+    __sync_fetch_and_or(m->done + line/64, 0x8000000000000000LL >> (line&63));
+    if (__sync_add_and_fetch(&m->count, 1) == m->lines) llmsset_migration_finish(dbs, m);
+}
+
+static inline int
+llmsset_migrate_claim(struct llmsset_migration *m, uint64_t line)
+{
+    const uint64_t mask = 0x8000000000000000LL >> (line&63);
+    if (m->claimed[line/64] & mask) return 0;
+    return (__sync_fetch_and_or(m->claimed + line/64, mask) & mask) ? 0 : 1;
+}
+
+/**
+ * Ensure that the given cache line of the old hash array is migrated.
+ * Returns 1 if the line had an empty bucket (thus the probe sequence ends here).
+ */
+static int
+llmsset_migrate_wait(const llmsset_t dbs, struct llmsset_migration *m, uint64_t line)
+{
+    volatile uint64_t *done = m->done + line/64;
+    const uint64_t mask = 0x8000000000000000LL >> (line&63);
+    if ((*done & mask) == 0) {
+        if (llmsset_migrate_claim(m, line)) llmsset_migrate_line(dbs, m, line);
+        else while ((*done & mask) == 0) continue;
+    }
+
+    volatile uint64_t *bucket = m->table + line * ((LINE_SIZE) / 8);
+    for (int k=0; k<(LINE_SIZE)/8; k++) {
+        if (bucket[k] == MASK_FROZEN) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Migrate every cache line of the old hash array on which the given key could be stored.
+ * Buckets are never emptied between garbage collections, so the key can only be stored
+ * up to the first cache line on its probe sequence that has an empty bucket.
+ */
+static void
+llmsset_migrate_key(const llmsset_t dbs, struct llmsset_migration *m, uint64_t a, uint64_t b, uint64_t hash_rehash, const int custom)
+{
+    uint64_t line = llmsset_first_idx(hash_rehash, m->size) / ((LINE_SIZE) / 8);
+    for (int i=1; i<=m->threshold+(int)m->overflow; i++) {
+        if (llmsset_migrate_wait(dbs, m, line)) return;
+        if (i < m->threshold) {
+            if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
+            else hash_rehash = llmsset_hash(a, b, hash_rehash);
+            line = llmsset_first_idx(hash_rehash, m->size) / ((LINE_SIZE) / 8);
+        } else {
+            line = line + 1 < m->lines ? line + 1 : 0;
+        }
+    }
+}
+
+/**
+ * Migrate the next chunk of cache lines of the old hash array.
+ */
+static void
+llmsset_migrate_help(const llmsset_t dbs, struct llmsset_migration *m)
+{
+    if (m->next >= m->lines) return;
+    size_t first = __sync_fetch_and_add(&m->next, LLMSSET_MIGRATE_CHUNK);
+    for (size_t line=first; line<first+LLMSSET_MIGRATE_CHUNK && line<m->lines; line++) {
+        if (llmsset_migrate_claim(m, line)) llmsset_migrate_line(dbs, m, line);
+    }
+}
+
+/**
+ * Called by a lookup that did not find an empty bucket (with view <seq>).
+ * Starts an online resize, or helps to finish the resize in progress.
+ * Returns 1 if the lookup should be retried, 0 if the table cannot grow.
+ */
+static int
+llmsset_grow(const llmsset_t dbs, uint32_t seq)
+{
     for (;;) {
-        volatile uint64_t *bucket = dbs->table + idx;
-        uint64_t v = *bucket;
-
-        if (v == 0) {
-            if (cidx == 0) {
-                cidx = claim_data_bucket(dbs);
-                if (cidx == (uint64_t)-1) return 0; // failed to claim a data bucket
-                if (custom) dbs->create_cb(&a, &b);
-                uint64_t *d_ptr = ((uint64_t*)dbs->data) + 2*cidx;
-                d_ptr[0] = a;
-                d_ptr[1] = b;
-            }
-            if (cas(bucket, 0, hash | cidx)) {
-                if (custom) set_custom_bucket(dbs, cidx, custom);
-                *created = 1;
-                return cidx;
-            } else {
-                v = *bucket;
+        int state = dbs->resize_state;
+        if (state == 2) {
+            // another worker started a resize; help to migrate the old hash array
+            struct llmsset_migration *m = dbs->migration;
+            if (m != NULL) {
+                while (m->next < m->lines) llmsset_migrate_help(dbs, m);
+                while (dbs->migration == m) continue;
             }
+            return 1;
+        }
+        if (state == 1) continue; // another worker is preparing a resize
+        if (dbs->resize_seq != seq) return 1; // the table changed since the lookup started
+        if (dbs->table_size >= dbs->max_size) return 0; // cannot grow
+        if (!cas(&dbs->resize_state, 0, 1)) continue;
+        if (dbs->resize_seq != seq) {
+            dbs->resize_state = 0;
+            return 1;
+        }
+
+        struct llmsset_migration *m = (struct llmsset_migration*)malloc(sizeof(struct llmsset_migration));
+        uint64_t *new_table = llmsset_alloc_table(dbs);
+        if (m == NULL || new_table == NULL) {
+            if (new_table != NULL) sylvan_mem_free(new_table, dbs->max_size * 8);
+            free(m);
+            dbs->resize_state = 0;
+            return 0;
+        }
+
+        m->table = dbs->table;
+        m->size = dbs->table_size;
+        m->threshold = dbs->threshold;
+        m->overflow = dbs->overflow;
+        m->lines = m->size / ((LINE_SIZE) / 8);
+        m->claimed = (uint64_t*)sylvan_mem_alloc(((m->lines + 63) / 64) * 8);
+        m->done = (uint64_t*)sylvan_mem_alloc(((m->lines + 63) / 64) * 8);
+        m->next = 0;
+        m->count = 0;
+        if (m->claimed == (uint64_t*)-1 || m->done == (uint64_t*)-1) {
+            fprintf(stderr, "llmsset_grow: Unable to allocate memory: %s!\n", strerror(errno));
+            exit(1);
+        }
+
+        size_t new_size = dbs->table_size * 2;
+        if (new_size > dbs->max_size) new_size = dbs->max_size;
+
+        dbs->resize_seq++;
+        compiler_barrier();
+        dbs->table = new_table;
+        llmsset_set_size(dbs, new_size);
+        dbs->migration = m;
+        compiler_barrier();
+        dbs->resize_seq++;
+
+        dbs->resize_state = 2;
+        return 1;
+    }
+}
+
+/**
+ * Release the old hash arrays of online resizes (during garbage collection).
+ * An unfinished migration is abandoned, as all marked buckets are rehashed anyway.
+ */
+static void
+llmsset_release_migrations(const llmsset_t dbs)
+{
+    if (dbs->migration != NULL) {
+        dbs->migration->next_retired = dbs->retired;
+        dbs->retired = dbs->migration;
+        dbs->migration = NULL;
+        dbs->resize_state = 0;
+    }
+    while (dbs->retired != NULL) {
+        struct llmsset_migration *m = dbs->retired;
+        dbs->retired = m->next_retired;
+        llmsset_migration_free(dbs, m);
+    }
+}
+
+/**
+ * The hash of the key <a, b> that determines the first cache line of its probe sequence.
+ */
+static inline uint64_t
+llmsset_hash_first(const llmsset_t dbs, uint64_t a, uint64_t b, const int custom)
+{
+    const uint64_t hash_first = 14695981039346656037LLU;
+    if (custom) return dbs->hash_cb(a, b, hash_first);
+    else return llmsset_hash(a, b, hash_first);
+}
+
+static inline uint64_t
+llmsset_lookup2(const llmsset_t dbs, uint64_t a, uint64_t b, uint64_t hash_first, int* created, const int custom)
+{
+    const uint64_t hash = hash_first & MASK_HASH;
+    uint64_t cidx = 0;
+
+    for (;;) {
+        // obtain a consistent view on the table (see llmsset_grow)
+        uint32_t seq;
+        uint64_t *table;
+        size_t size;
+        int threshold;
+        uint32_t overflow;
+        struct llmsset_migration *m;
+        do {
+            seq = dbs->resize_seq;
+            compiler_barrier();
+            table = dbs->table;
+            size = dbs->table_size;
+            threshold = dbs->threshold;
+            overflow = dbs->overflow;
+            m = dbs->migration;
+            compiler_barrier();
+        } while ((seq & 1) || seq != dbs->resize_seq);
+
+        if (m != NULL) {
+            // online resize in progress: the key must be migrated before using the new array
+            llmsset_migrate_key(dbs, m, a, b, hash_first, custom);
+            llmsset_migrate_help(dbs, m);
         }
 
-        if (hash == (v & MASK_HASH)) {
-            uint64_t d_idx = v & MASK_INDEX;
-            uint64_t *d_ptr = ((uint64_t*)dbs->data) + 2*d_idx;
-            if (custom) {
-                if (dbs->equals_cb(a, b, d_ptr[0], d_ptr[1])) {
-                    if (cidx != 0) {
-                        dbs->destroy_cb(a, b);
-                        release_data_bucket(dbs, cidx);
+        uint64_t hash_rehash = hash_first;
+        uint64_t idx, last;
+        int i=0;
+
+        last = idx = llmsset_first_idx(hash_rehash, size);
+
+        for (;;) {
+            volatile uint64_t *bucket = table + idx;
+            uint64_t v = *bucket;
+
+            if (v == 0) {
+                if (cidx == 0) {
+                    cidx = claim_data_bucket(dbs);
+                    if (cidx == (uint64_t)-1) {
+                        // failed to claim a data bucket
+                        cidx = 0;
+                        goto full;
                     }
-                    *created = 0;
-                    return d_idx;
+                    if (custom) dbs->create_cb(&a, &b);
+                    llmsset_data_set(dbs, cidx, a, b);
+                    // set before inserting, a concurrent migration may rehash the bucket
+                    if (custom) set_custom_bucket(dbs, cidx, custom);
                 }
-            } else {
-                if (d_ptr[0] == a && d_ptr[1] == b) {
-                    if (cidx != 0) release_data_bucket(dbs, cidx);
-                    *created = 0;
-                    return d_idx;
+                if (cas(bucket, 0, hash | cidx)) {
+                    *created = 1;
+                    return cidx;
+                } else {
+                    v = *bucket;
                 }
             }
-        }
 
-        sylvan_stats_count(LLMSSET_LOOKUP);
+            if (v & MASK_FROZEN) break; // an online resize started, restart with the new view
+
+            if (hash == (v & MASK_HASH) && v != TOMBSTONE) {
+                uint64_t d_idx = v & MASK_INDEX, d_a, d_b;
+                llmsset_data_get(dbs, d_idx, &d_a, &d_b);
+                if (custom) {
+                    if (dbs->equals_cb(a, b, d_a, d_b)) {
+                        if (cidx != 0) {
+                            dbs->destroy_cb(a, b);
+                            set_custom_bucket(dbs, cidx, 0);
+                            release_data_bucket(dbs, cidx);
+                        }
+                        *created = 0;
+                        return d_idx;
+                    }
+                } else {
+                    if (d_a == a && d_b == b) {
+                        if (cidx != 0) release_data_bucket(dbs, cidx);
+                        *created = 0;
+                        return d_idx;
+                    }
+                }
+            }
 
-        // find next idx on probe sequence
-        idx = (idx & CL_MASK) | ((idx+1) & CL_MASK_R);
-        if (idx == last) {
-            if (++i == dbs->threshold) return 0; // failed to find empty spot in probe sequence
+            sylvan_stats_count(LLMSSET_LOOKUP);
 
-            // go to next cache line in probe sequence
-            if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
-            else hash_rehash = llmsset_hash(a, b, hash_rehash);
+            // find next idx on probe sequence
+            idx = (idx & CL_MASK) | ((idx+1) & CL_MASK_R);
+            if (idx == last) {
+                if (++i >= threshold) {
+                    if (i == threshold + (int)overflow) goto full; // failed to find empty spot in probe sequence
 
-#if LLMSSET_MASK
-            last = idx = hash_rehash & dbs->mask;
-#else
-            last = idx = hash_rehash % dbs->table_size;
-#endif
+                    // overflow probing: go to the next cache line
+                    last = idx = llmsset_next_line(idx, size);
+                } else {
+                    // go to next cache line in probe sequence
+                    if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
+                    else hash_rehash = llmsset_hash(a, b, hash_rehash);
+
+                    last = idx = llmsset_first_idx(hash_rehash, size);
+                }
+            }
+        }
+
+        continue;
+
+full:
+        // a concurrent migration extended the probe sequence (llmsset_rehash_bucket), retry
+        if (threshold != dbs->threshold || overflow != *(volatile uint32_t*)&dbs->overflow) continue;
+
+        if (!dbs->online_resize || !llmsset_grow(dbs, seq)) {
+            if (cidx != 0) {
+                if (custom) {
+                    dbs->destroy_cb(a, b);
+                    set_custom_bucket(dbs, cidx, 0);
+                }
+                release_data_bucket(dbs, cidx);
+            }
+            return 0;
         }
     }
 }
 
 uint64_t
-llmsset_lookup(const llmsset_t dbs, const uint64_t a, const uint64_t b, int* created)
+llmsset_lookup(const llmsset_t dbs, const uint64_t a, uint64_t b, int* created)
 {
-    return llmsset_lookup2(dbs, a, b, created, 0);
+#if SYLVAN_COMPACT_NODES
+    b &= 0xffffffff; // only 32 bits of b are stored
+#endif
+    return llmsset_lookup2(dbs, a, b, llmsset_hash_first(dbs, a, b, 0), created, 0);
 }
 
 uint64_t
-llmsset_lookupc(const llmsset_t dbs, const uint64_t a, const uint64_t b, int* created)
+llmsset_lookupc(const llmsset_t dbs, const uint64_t a, uint64_t b, int* created)
 {
-    return llmsset_lookup2(dbs, a, b, created, 1);
+#if SYLVAN_COMPACT_NODES
+    b &= 0xffffffff; // only 32 bits of b are stored
+#endif
+    return llmsset_lookup2(dbs, a, b, llmsset_hash_first(dbs, a, b, 1), created, 1);
+}
+
+/**
+ * Compute the first hash of the <count> keys <a[i], b[i]> (at most LLMSSET_BATCH_WINDOW), with the
+ * vectorized hash function, and prefetch the first cache line of their probe sequence.
+ */
+static void
+llmsset_hash_prefetch(const llmsset_t dbs, size_t count, const uint64_t *a, const uint64_t *b, uint64_t *hashes)
+{
+#if SYLVAN_COMPACT_NODES
+    uint64_t b32[LLMSSET_BATCH_WINDOW] = {0}; // only 32 bits of b are stored
+    for (size_t i=0; i<count; i++) b32[i] = b[i] & 0xffffffff;
+    b = b32;
+#endif
+    llmsset_hash_many(count, a, b, 14695981039346656037LLU, hashes);
+    for (size_t i=0; i<count; i++) __builtin_prefetch(dbs->table + llmsset_first_idx(hashes[i], dbs->table_size), 1);
+}
+
+size_t
+llmsset_lookup_batch(const llmsset_t dbs, size_t count, const uint64_t *a, const uint64_t *b, uint64_t *results, int *created)
+{
+    // the keys are hashed and prefetched one block of LLMSSET_BATCH_WINDOW keys ahead of the lookups
+    uint64_t hashes[2][LLMSSET_BATCH_WINDOW];
+
+    const size_t W = LLMSSET_BATCH_WINDOW;
+    llmsset_hash_prefetch(dbs, count < W ? count : W, a, b, hashes[0]);
+
+    for (size_t first=0; first<count; first+=W) {
+        const size_t next = first + W;
+        if (next < count) llmsset_hash_prefetch(dbs, count-next < W ? count-next : W, a+next, b+next, hashes[(next/W)&1]);
+
+        const uint64_t *h = hashes[(first/W)&1];
+        for (size_t j=first; j<first+W && j<count; j++) {
+#if SYLVAN_COMPACT_NODES
+            results[j] = llmsset_lookup2(dbs, a[j], b[j] & 0xffffffff, h[j-first], created + j, 0);
+#else
+            results[j] = llmsset_lookup2(dbs, a[j], b[j], h[j-first], created + j, 0);
+#endif
+            if (results[j] == 0) return j;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Insert the data bucket <d_idx> with key <a, b> and first hash <hash_rehash> in the hash array.
+ */
+static int
+llmsset_rehash_bucket2(const llmsset_t dbs, uint64_t d_idx, uint64_t a, uint64_t b, uint64_t hash_rehash, const int custom)
+{
+    const uint64_t new_v = (hash_rehash & MASK_HASH) | d_idx;
+    int i=0;
+
+    uint64_t idx, last;
+    last = idx = llmsset_first_idx(hash_rehash, dbs->table_size);
+
+    for (;;) {
+        volatile uint64_t *bucket = &dbs->table[idx];
+        if (*bucket == 0 && cas(bucket, 0, new_v)) return 1;
+        if (*bucket == TOMBSTONE && cas(bucket, TOMBSTONE, new_v)) return 2;
+
+        // find next idx on probe sequence
+        idx = (idx & CL_MASK) | ((idx+1) & CL_MASK_R);
+        if (idx == last) {
+            const int threshold = *(volatile int16_t*)&dbs->threshold;
+            const uint32_t overflow = *(volatile uint32_t*)&dbs->overflow;
+            if (++i == threshold + (int)overflow) {
+                // failed to find empty spot in probe sequence
+                // solution: increase probe sequence length (at its end, so it keeps its prefix)...
+                if (overflow) __sync_fetch_and_add(&dbs->overflow, 1);
+                else __sync_fetch_and_add(&dbs->threshold, 1);
+            }
+
+            if (i >= threshold && overflow) {
+                // overflow probing: go to the next cache line
+                last = idx = llmsset_next_line(idx, dbs->table_size);
+            } else {
+                // go to next cache line in probe sequence
+                if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
+                else hash_rehash = llmsset_hash(a, b, hash_rehash);
+
+                last = idx = llmsset_first_idx(hash_rehash, dbs->table_size);
+            }
+        }
+    }
 }
 
 int
 llmsset_rehash_bucket(const llmsset_t dbs, uint64_t d_idx)
 {
-    const uint64_t * const d_ptr = ((uint64_t*)dbs->data) + 2*d_idx;
-    const uint64_t a = d_ptr[0];
-    const uint64_t b = d_ptr[1];
+    uint64_t a, b;
+    llmsset_data_get(dbs, d_idx, &a, &b);
+    const int custom = get_custom_bucket(dbs, d_idx) ? 1 : 0;
+    return llmsset_rehash_bucket2(dbs, d_idx, a, b, llmsset_hash_first(dbs, a, b, custom), custom);
+}
+
+int
+llmsset_unhash(const llmsset_t dbs, uint64_t d_idx)
+{
+    uint64_t a, b;
+    llmsset_data_get(dbs, d_idx, &a, &b);
 
     uint64_t hash_rehash = 14695981039346656037LLU;
     const int custom = get_custom_bucket(dbs, d_idx) ? 1 : 0;
     if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
     else hash_rehash = llmsset_hash(a, b, hash_rehash);
-    const uint64_t new_v = (hash_rehash & MASK_HASH) | d_idx;
+    const uint64_t v = (hash_rehash & MASK_HASH) | d_idx;
     int i=0;
 
     uint64_t idx, last;
-#if LLMSSET_MASK
-    last = idx = hash_rehash & dbs->mask;
-#else
-    last = idx = hash_rehash % dbs->table_size;
-#endif
+    last = idx = llmsset_first_idx(hash_rehash, dbs->table_size);
 
     for (;;) {
         volatile uint64_t *bucket = &dbs->table[idx];
-        if (*bucket == 0 && cas(bucket, 0, new_v)) return 1;
+        if (*bucket == 0) return 0;
+        if (*bucket == v && cas(bucket, v, TOMBSTONE)) return 1;
 
         // find next idx on probe sequence
         idx = (idx & CL_MASK) | ((idx+1) & CL_MASK_R);
         if (idx == last) {
-            if (++i == *(volatile int16_t*)&dbs->threshold) {
-                // failed to find empty spot in probe sequence
-                // solution: increase probe sequence length...
-                __sync_fetch_and_add(&dbs->threshold, 1);
-            }
+            const int threshold = *(volatile int16_t*)&dbs->threshold;
+            if (++i >= threshold) {
+                if (i == threshold + (int)dbs->overflow) return 0;
 
-            // go to next cache line in probe sequence
-            if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
-            else hash_rehash = llmsset_hash(a, b, hash_rehash);
+                // overflow probing: go to the next cache line
+                last = idx = llmsset_next_line(idx, dbs->table_size);
+            } else {
+                // go to next cache line in probe sequence
+                if (custom) hash_rehash = dbs->hash_cb(a, b, hash_rehash);
+                else hash_rehash = llmsset_hash(a, b, hash_rehash);
 
-#if LLMSSET_MASK
-            last = idx = hash_rehash & dbs->mask;
-#else
-            last = idx = hash_rehash % dbs->table_size;
-#endif
+                last = idx = llmsset_first_idx(hash_rehash, dbs->table_size);
+            }
         }
     }
 }
@@ -346,50 +881,58 @@ llmsset_create(size_t initial_size, size_t max_size)
     /* This implementation of "resizable hash table" allocates the max_size table in virtual memory,
        but only uses the "actual size" part in real memory */
 
-    dbs->table = (uint64_t*)mmap(0, dbs->max_size * 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    dbs->data = (uint8_t*)mmap(0, dbs->max_size * 16, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    dbs->table = llmsset_alloc_table(dbs);
+    dbs->data = (uint8_t*)sylvan_mem_alloc(dbs->max_size * LLMSSET_DATA_SIZE);
 
     /* Also allocate bitmaps. Each region is 64*8 = 512 buckets.
        Overhead of bitmap1: 1 bit per 4096 bucket.
        Overhead of bitmap2: 1 bit per bucket.
        Overhead of bitmapc: 1 bit per bucket. */
 
-    dbs->bitmap1 = (uint64_t*)mmap(0, dbs->max_size / (512*8), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    dbs->bitmap2 = (uint64_t*)mmap(0, dbs->max_size / 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    dbs->bitmapc = (uint64_t*)mmap(0, dbs->max_size / 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    dbs->bitmap1 = (uint64_t*)sylvan_mem_alloc(dbs->max_size / (512*8));
+    dbs->bitmap2 = (uint64_t*)sylvan_mem_alloc(dbs->max_size / 8);
+    dbs->bitmapc = (uint64_t*)sylvan_mem_alloc(dbs->max_size / 8);
+    dbs->bitmap3 = (uint64_t*)sylvan_mem_alloc(dbs->max_size / 8);
 
-    if (dbs->table == (uint64_t*)-1 || dbs->data == (uint8_t*)-1 || dbs->bitmap1 == (uint64_t*)-1 || dbs->bitmap2 == (uint64_t*)-1 || dbs->bitmapc == (uint64_t*)-1) {
+    if (dbs->table == NULL || dbs->data == (uint8_t*)-1 || dbs->bitmap1 == (uint64_t*)-1 || dbs->bitmap2 == (uint64_t*)-1 || dbs->bitmapc == (uint64_t*)-1 || dbs->bitmap3 == (uint64_t*)-1) {
         fprintf(stderr, "llmsset_create: Unable to allocate memory: %s!\n", strerror(errno));
         exit(1);
     }
 
-#if defined(madvise) && defined(MADV_RANDOM)
-    madvise(dbs->table, dbs->max_size * 8, MADV_RANDOM);
-#endif
-
 #if USE_HWLOC
-    hwloc_set_area_membind(topo, dbs->table, dbs->max_size * 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_INTERLEAVE, 0);
-    hwloc_set_area_membind(topo, dbs->data, dbs->max_size * 16, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+    hwloc_set_area_membind(topo, dbs->data, dbs->max_size * LLMSSET_DATA_SIZE, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
     hwloc_set_area_membind(topo, dbs->bitmap1, dbs->max_size / (512*8), hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_INTERLEAVE, 0);
     hwloc_set_area_membind(topo, dbs->bitmap2, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
     hwloc_set_area_membind(topo, dbs->bitmapc, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+    hwloc_set_area_membind(topo, dbs->bitmap3, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
 #endif
 
     // forbid first two positions (index 0 and 1)
     dbs->bitmap2[0] = 0xc000000000000000LL;
+    dbs->bitmapm = dbs->bitmap2;
 
     dbs->hash_cb = NULL;
     dbs->equals_cb = NULL;
     dbs->create_cb = NULL;
     dbs->destroy_cb = NULL;
 
-    // yes, ugly. for now, we use a global thread-local value.
-    // that is a problem with multiple tables.
-    // so, for now, do NOT use multiple tables!!
+    dbs->overflow_probe = 0;
+    dbs->overflow = 0;
+    dbs->online_resize = 0;
+    dbs->resize_state = 0;
+    dbs->resize_seq = 0;
+    dbs->migration = NULL;
+    dbs->retired = NULL;
+
+    if (posix_memalign((void**)&dbs->regions, LINE_SIZE, sizeof(uint64_t) * REGION_STRIDE * lace_workers()) != 0) {
+        fprintf(stderr, "llmsset_create: Unable to allocate memory!\n");
+        exit(1);
+    }
+
+    llmsset_hash_select(LLMSSET_HASH_AUTO);
 
     LACE_ME;
-    INIT_THREAD_LOCAL(my_region);
-    TOGETHER(llmsset_reset_region);
+    TOGETHER(llmsset_reset_region, dbs);
 
     return dbs;
 }
@@ -397,11 +940,14 @@ llmsset_create(size_t initial_size, size_t max_size)
 void
 llmsset_free(llmsset_t dbs)
 {
-    munmap(dbs->table, dbs->max_size * 8);
-    munmap(dbs->data, dbs->max_size * 16);
-    munmap(dbs->bitmap1, dbs->max_size / (512*8));
-    munmap(dbs->bitmap2, dbs->max_size / 8);
-    munmap(dbs->bitmapc, dbs->max_size / 8);
+    llmsset_release_migrations(dbs);
+    sylvan_mem_free(dbs->table, dbs->max_size * 8);
+    sylvan_mem_free(dbs->data, dbs->max_size * LLMSSET_DATA_SIZE);
+    sylvan_mem_free(dbs->bitmap1, dbs->max_size / (512*8));
+    sylvan_mem_free(dbs->bitmap2, dbs->max_size / 8);
+    sylvan_mem_free(dbs->bitmapc, dbs->max_size / 8);
+    sylvan_mem_free(dbs->bitmap3, dbs->max_size / 8);
+    free(dbs->regions);
     free(dbs);
 }
 
@@ -413,7 +959,7 @@ VOID_TASK_IMPL_1(llmsset_clear, llmsset_t, dbs)
 
 VOID_TASK_IMPL_1(llmsset_clear_data, llmsset_t, dbs)
 {
-    if (mmap(dbs->bitmap1, dbs->max_size / (512*8), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != (void*)-1) {
+    if (sylvan_mem_clear(dbs->bitmap1, dbs->max_size / (512*8))) {
 #if USE_HWLOC
         hwloc_set_area_membind(topo, dbs->bitmap1, dbs->max_size / (512*8), hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_INTERLEAVE, 0);
 #endif
@@ -421,7 +967,7 @@ VOID_TASK_IMPL_1(llmsset_clear_data, llmsset_t, dbs)
         memset(dbs->bitmap1, 0, dbs->max_size / (512*8));
     }
 
-    if (mmap(dbs->bitmap2, dbs->max_size / 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != (void*)-1) {
+    if (sylvan_mem_clear(dbs->bitmap2, dbs->max_size / 8)) {
 #if USE_HWLOC
         hwloc_set_area_membind(topo, dbs->bitmap2, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
 #endif
@@ -432,13 +978,19 @@ VOID_TASK_IMPL_1(llmsset_clear_data, llmsset_t, dbs)
     // forbid first two positions (index 0 and 1)
     dbs->bitmap2[0] = 0xc000000000000000LL;
 
-    TOGETHER(llmsset_reset_region);
+    TOGETHER(llmsset_reset_region, dbs);
 }
 
 VOID_TASK_IMPL_1(llmsset_clear_hashes, llmsset_t, dbs)
 {
+    // no lookups during garbage collection: release the old arrays of online resizes
+    llmsset_release_migrations(dbs);
+
+    // the probe sequence may change now that the hash array is empty
+    dbs->overflow = dbs->overflow_probe ? LLMSSET_OVERFLOW_LINES : 0;
+
     // just reallocate...
-    if (mmap(dbs->table, dbs->max_size * 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != (void*)-1) {
+    if (sylvan_mem_clear(dbs->table, dbs->max_size * 8)) {
 #if defined(madvise) && defined(MADV_RANDOM)
         madvise(dbs->table, sizeof(uint64_t[dbs->max_size]), MADV_RANDOM);
 #endif
@@ -451,6 +1003,41 @@ VOID_TASK_IMPL_1(llmsset_clear_hashes, llmsset_t, dbs)
     }
 }
 
+void
+llmsset_marking_start(const llmsset_t dbs)
+{
+    // bitmap3 is cleared by llmsset_marking_finish (or empty after llmsset_create)
+    dbs->bitmap3[0] = 0xc000000000000000LL;
+    dbs->bitmapm = dbs->bitmap3;
+}
+
+VOID_TASK_IMPL_1(llmsset_marking_finish, llmsset_t, dbs)
+{
+    // the marked buckets are now the used buckets; the old bitmap2 is reused for the next marking
+    uint64_t *used = dbs->bitmap2;
+    dbs->bitmap2 = dbs->bitmap3;
+    dbs->bitmap3 = used;
+    dbs->bitmapm = dbs->bitmap2;
+
+    if (sylvan_mem_clear(dbs->bitmap3, dbs->max_size / 8)) {
+#if USE_HWLOC
+        hwloc_set_area_membind(topo, dbs->bitmap3, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+#endif
+    } else {
+        memset(dbs->bitmap3, 0, dbs->max_size / 8);
+    }
+
+    if (sylvan_mem_clear(dbs->bitmap1, dbs->max_size / (512*8))) {
+#if USE_HWLOC
+        hwloc_set_area_membind(topo, dbs->bitmap1, dbs->max_size / (512*8), hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_INTERLEAVE, 0);
+#endif
+    } else {
+        memset(dbs->bitmap1, 0, dbs->max_size / (512*8));
+    }
+
+    TOGETHER(llmsset_reset_region, dbs);
+}
+
 int
 llmsset_is_marked(const llmsset_t dbs, uint64_t index)
 {
@@ -462,7 +1049,7 @@ llmsset_is_marked(const llmsset_t dbs, uint64_t index)
 int
 llmsset_mark(const llmsset_t dbs, uint64_t index)
 {
-    volatile uint64_t *ptr = dbs->bitmap2 + (index/64);
+    volatile uint64_t *ptr = dbs->bitmapm + (index/64);
     uint64_t mask = 0x8000000000000000LL >> (index&63);
     for (;;) {
         uint64_t v = *ptr;
@@ -478,12 +1065,30 @@ TASK_3(int, llmsset_rehash_par, llmsset_t, dbs, size_t, first, size_t, count)
         int bad = CALL(llmsset_rehash_par, dbs, first + count/2, count - count/2);
         return bad + SYNC(llmsset_rehash_par);
     } else {
+        // the buckets with the default hash function are hashed and prefetched in blocks
+        uint64_t d_idx[LLMSSET_BATCH_WINDOW], a[LLMSSET_BATCH_WINDOW], b[LLMSSET_BATCH_WINDOW];
+        uint64_t hashes[LLMSSET_BATCH_WINDOW];
+        size_t n = 0;
+
         int bad = 0;
         uint64_t *ptr = dbs->bitmap2 + (first / 64);
         uint64_t mask = 0x8000000000000000LL >> (first & 63);
         for (size_t k=0; k<count; k++) {
             if (*ptr & mask) {
-                if (llmsset_rehash_bucket(dbs, first+k) == 0) bad++;
+                if (get_custom_bucket(dbs, first+k)) {
+                    if (llmsset_rehash_bucket(dbs, first+k) == 0) bad++;
+                } else {
+                    d_idx[n] = first+k;
+                    llmsset_data_get(dbs, first+k, a+n, b+n);
+                    n++;
+                }
+            }
+            if (n == LLMSSET_BATCH_WINDOW || (k == count-1 && n != 0)) {
+                llmsset_hash_prefetch(dbs, n, a, b, hashes);
+                for (size_t j=0; j<n; j++) {
+                    if (llmsset_rehash_bucket2(dbs, d_idx[j], a[j], b[j], hashes[j], 0) == 0) bad++;
+                }
+                n = 0;
             }
             mask >>= 1;
             if (mask == 0) {
@@ -540,6 +1145,16 @@ TASK_IMPL_1(size_t, llmsset_count_marked, llmsset_t, dbs)
     return CALL(llmsset_count_marked_par, dbs, 0, dbs->table_size);
 }
 
+size_t
+llmsset_marked_bound(const llmsset_t dbs)
+{
+    for (size_t i=dbs->table_size/64; i>0; i--) {
+        const uint64_t v = dbs->bitmap2[i-1];
+        if (v != 0) return (i-1)*64 + 64 - __builtin_ctzll(v);
+    }
+    return 0;
+}
+
 VOID_TASK_3(llmsset_destroy_par, llmsset_t, dbs, size_t, first, size_t, count)
 {
     if (count > 1024) {
@@ -555,8 +1170,9 @@ VOID_TASK_3(llmsset_destroy_par, llmsset_t, dbs, size_t, first, size_t, count)
 
             // if not marked but is custom
             if ((*ptr2 & mask) == 0 && (*ptrc & mask)) {
-                uint64_t *d_ptr = ((uint64_t*)dbs->data) + 2*k;
-                dbs->destroy_cb(d_ptr[0], d_ptr[1]);
+                uint64_t a, b;
+                llmsset_data_get(dbs, k, &a, &b);
+                dbs->destroy_cb(a, b);
                 *ptrc &= ~mask;
             }
         }
@@ -569,6 +1185,66 @@ VOID_TASK_IMPL_1(llmsset_destroy_unmarked, llmsset_t, dbs)
     CALL(llmsset_destroy_par, dbs, 0, dbs->table_size);
 }
 
+/* The new arrays during llmsset_relocate */
+typedef struct llmsset_relocation
+{
+    llmsset_relocate_cb relocate;
+    uint8_t *data;
+    uint64_t *bitmap2;
+    uint64_t *bitmapc;
+} *llmsset_relocation_t;
+
+VOID_TASK_4(llmsset_relocate_par, llmsset_t, dbs, llmsset_relocation_t, r, size_t, first, size_t, count)
+{
+    if (count > 4096) {
+        SPAWN(llmsset_relocate_par, dbs, r, first, count/2);
+        CALL(llmsset_relocate_par, dbs, r, first+count/2, count-count/2);
+        SYNC(llmsset_relocate_par);
+        return;
+    }
+
+    for (size_t i=first; i<first+count; i++) {
+        if (i < 2 || !llmsset_is_marked(dbs, i)) continue;
+        const uint64_t j = r->relocate(i);
+        memcpy(r->data + j*LLMSSET_DATA_SIZE, dbs->data + i*LLMSSET_DATA_SIZE, LLMSSET_DATA_SIZE);
+        const uint64_t mask = 0x8000000000000000LL >> (j&63);
+        __sync_fetch_and_or(r->bitmap2 + j/64, mask);
+        if (dbs->bitmapc[i/64] & (0x8000000000000000LL >> (i&63))) __sync_fetch_and_or(r->bitmapc + j/64, mask);
+    }
+}
+
+VOID_TASK_IMPL_2(llmsset_relocate, llmsset_t, dbs, llmsset_relocate_cb, relocate)
+{
+    struct llmsset_relocation r;
+    r.relocate = relocate;
+    r.data = (uint8_t*)sylvan_mem_alloc(dbs->max_size * LLMSSET_DATA_SIZE);
+    r.bitmap2 = (uint64_t*)sylvan_mem_alloc(dbs->max_size / 8);
+    r.bitmapc = (uint64_t*)sylvan_mem_alloc(dbs->max_size / 8);
+    if (r.data == (uint8_t*)-1 || r.bitmap2 == (uint64_t*)-1 || r.bitmapc == (uint64_t*)-1) {
+        fprintf(stderr, "llmsset_relocate: Unable to allocate memory: %s!\n", strerror(errno));
+        exit(1);
+    }
+
+#if USE_HWLOC
+    hwloc_set_area_membind(topo, r.data, dbs->max_size * LLMSSET_DATA_SIZE, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+    hwloc_set_area_membind(topo, r.bitmap2, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+    hwloc_set_area_membind(topo, r.bitmapc, dbs->max_size / 8, hwloc_topology_get_allowed_cpuset(topo), HWLOC_MEMBIND_FIRSTTOUCH, 0);
+#endif
+
+    // forbid first two positions (index 0 and 1)
+    r.bitmap2[0] = 0xc000000000000000LL;
+
+    CALL(llmsset_relocate_par, dbs, &r, 0, dbs->table_size);
+
+    sylvan_mem_free(dbs->data, dbs->max_size * LLMSSET_DATA_SIZE);
+    sylvan_mem_free(dbs->bitmap2, dbs->max_size / 8);
+    sylvan_mem_free(dbs->bitmapc, dbs->max_size / 8);
+    dbs->data = r.data;
+    dbs->bitmap2 = r.bitmap2;
+    dbs->bitmapc = r.bitmapc;
+    dbs->bitmapm = r.bitmap2;
+}
+
 /**
  * Set custom functions
  */
@@ -579,3 +1255,17 @@ void llmsset_set_custom(const llmsset_t dbs, llmsset_hash_cb hash_cb, llmsset_eq
     dbs->create_cb = create_cb;
     dbs->destroy_cb = destroy_cb;
 }
+
+void
+llmsset_set_online_resize(llmsset_t dbs, int enabled)
+{
+    dbs->online_resize = enabled ? 1 : 0;
+}
+
+void
+llmsset_set_overflow_probe(llmsset_t dbs, int enabled)
+{
+    dbs->overflow_probe = enabled ? 1 : 0;
+    // extending the probe sequence is always safe, shortening it only when the hash array is cleared
+    if (enabled && dbs->overflow < LLMSSET_OVERFLOW_LINES) dbs->overflow = LLMSSET_OVERFLOW_LINES;
+}
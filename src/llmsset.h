@@ -35,15 +35,25 @@ extern "C" {
 
 /**
  * Lockless hash table (set) to store 16-byte keys.
- * Each unique key is associated with a 42-bit number.
+ * Each unique key is associated with a SYLVAN_INDEX_BITS-bit number (40 bits, or 48 bits with
+ * SYLVAN_WIDE_INDEX). The hash array stores this number with the remaining bits of the hash.
  *
  * The set has support for stop-the-world garbage collection.
  * Methods llmsset_clear, llmsset_mark and llmsset_rehash implement garbage collection.
  * During their execution, llmsset_lookup is not allowed.
  *
- * WARNING: Originally, this table is designed to allow multiple tables.
- * However, this is not compatible with thread local storage for now.
- * Do not use multiple tables.
+ * Optionally, the set grows online (see llmsset_set_online_resize). The hash array is then
+ * doubled by the lookup that finds the table full, and the existing hashes are migrated one
+ * cache line at a time by the workers that perform lookups, while lookups continue.
+ *
+ * The probe sequence of a key visits <threshold> cache lines, chosen by rehashing the key, and
+ * with overflow probing (see llmsset_set_overflow_probe) then a number of consecutive cache lines.
+ * A key is always inserted in the first empty bucket of its probe sequence, so every lookup finds
+ * an existing key before it reaches an empty bucket.
+ *
+ * With SYLVAN_COMPACT_NODES, every bucket stores 12 bytes: the key <a, b> must have b < 2^32.
+ *
+ * Every table keeps the data region of every worker, so multiple tables can be used at once.
  */
 
 /**
@@ -53,11 +63,20 @@ extern "C" {
  *                 but must keep hash/equals same!
  * destroy(a, b)
  */
+/* number of bytes of data per bucket */
+#if SYLVAN_COMPACT_NODES
+#define LLMSSET_DATA_SIZE 12
+#else
+#define LLMSSET_DATA_SIZE 16
+#endif
+
 typedef uint64_t (*llmsset_hash_cb)(uint64_t, uint64_t, uint64_t);
 typedef int (*llmsset_equals_cb)(uint64_t, uint64_t, uint64_t, uint64_t);
 typedef void (*llmsset_create_cb)(uint64_t *, uint64_t *);
 typedef void (*llmsset_destroy_cb)(uint64_t, uint64_t);
 
+struct llmsset_migration;
+
 typedef struct llmsset
 {
     uint64_t          *table;       // table with hashes
@@ -65,6 +84,9 @@ typedef struct llmsset
     uint64_t          *bitmap1;     // ownership bitmap (per 512 buckets)
     uint64_t          *bitmap2;     // bitmap for "contains data"
     uint64_t          *bitmapc;     // bitmap for "use custom functions"
+    uint64_t          *bitmapm;     // bitmap for llmsset_mark (bitmap2, or bitmap3 during incremental marking)
+    uint64_t          *bitmap3;     // bitmap for marking while the table is in use
+    uint64_t          *regions;     // current data region of every worker (one cache line per worker)
     size_t            max_size;     // maximum size of the hash table (for resizing)
     size_t            table_size;   // size of the hash table (number of slots) --> power of 2!
 #if LLMSSET_MASK
@@ -76,15 +98,22 @@ typedef struct llmsset
     llmsset_create_cb create_cb;    // custom create function
     llmsset_destroy_cb destroy_cb;  // custom destroy function
     int16_t           threshold;    // number of iterations for insertion until returning error
+    int               overflow_probe; // probe consecutive cache lines after the threshold
+    uint32_t          overflow;     // number of consecutive cache lines probed after the threshold
+    int               online_resize; // grow the table during lookups instead of returning 0
+    volatile int      resize_state; // 0: no online resize, 1: preparing, 2: migrating
+    volatile uint32_t resize_seq;   // odd while the table is being swapped (online resize)
+    struct llmsset_migration *migration; // the online resize in progress (or NULL)
+    struct llmsset_migration *retired;   // old hash arrays, released during garbage collection
 } *llmsset_t;
 
 /**
- * Retrieve a pointer to the data associated with the 42-bit value.
+ * Retrieve a pointer to the data associated with the value.
  */
 static inline void*
 llmsset_index_to_ptr(const llmsset_t dbs, size_t index)
 {
-    return dbs->data + index * 16;
+    return dbs->data + index * LLMSSET_DATA_SIZE;
 }
 
 /**
@@ -133,12 +162,33 @@ llmsset_set_size(llmsset_t dbs, size_t size)
         dbs->mask = dbs->table_size - 1;
 #endif
         dbs->threshold = (64 - __builtin_clzll(dbs->table_size)) + 4; // doubling table_size increases threshold by 1
+        dbs->overflow = dbs->overflow_probe ? LLMSSET_OVERFLOW_LINES : 0;
     }
 }
 
+/**
+ * Enable or disable online resizing (disabled by default).
+ * When enabled, a lookup that finds the table full doubles the table (up to max_size) instead
+ * of returning 0. Buckets of the old hash array are migrated per cache line, by lookups that
+ * need them and by every lookup that runs while the migration is in progress.
+ * The data array is not moved, so the values remain the same.
+ * Old hash arrays are kept until the next garbage collection (llmsset_clear_hashes).
+ */
+void llmsset_set_online_resize(llmsset_t dbs, int enabled);
+
+/**
+ * Enable or disable overflow probing (disabled by default).
+ * When enabled, a lookup that finds no empty bucket on the <threshold> cache lines of its probe
+ * sequence continues with the next LLMSSET_OVERFLOW_LINES consecutive cache lines before it
+ * reports that the table is full. This lets the table reach a higher load before garbage
+ * collection, at the cost of longer probe sequences when the table is almost full.
+ * Disabling takes effect when the hash array is cleared (llmsset_clear_hashes).
+ */
+void llmsset_set_overflow_probe(llmsset_t dbs, int enabled);
+
 /**
  * Core function: find existing data or add new.
- * Returns the unique 42-bit value associated with the data, or 0 when table is full.
+ * Returns the unique value associated with the data, or 0 when table is full.
  * Also, this value will never equal 0 or 1.
  * Note: garbage collection during lookup strictly forbidden
  */
@@ -149,6 +199,16 @@ uint64_t llmsset_lookup(const llmsset_t dbs, const uint64_t a, const uint64_t b,
  */
 uint64_t llmsset_lookupc(const llmsset_t dbs, const uint64_t a, const uint64_t b, int *created);
 
+/**
+ * Find existing data or add new for the <count> keys <a[i], b[i]> (without the custom functions).
+ * The first cache line of the probe sequence of the next keys is prefetched while a key is looked up,
+ * so the cache misses of independent keys overlap.
+ * Stores the value of every key in results[i] and whether it was created in created[i].
+ * Returns the number of keys that were found or added. If this is less than <count>, then the
+ * table was full when adding the key at that position, and the remaining keys are not looked up.
+ */
+size_t llmsset_lookup_batch(const llmsset_t dbs, size_t count, const uint64_t *a, const uint64_t *b, uint64_t *results, int *created);
+
 /**
  * To perform garbage collection, the user is responsible that no lookups are performed during the process.
  *
@@ -165,6 +225,20 @@ VOID_TASK_DECL_1(llmsset_clear_data, llmsset_t);
 VOID_TASK_DECL_1(llmsset_clear_hashes, llmsset_t);
 #define llmsset_clear_hashes(dbs) CALL(llmsset_clear_hashes, dbs)
 
+/**
+ * Incremental marking, while lookups continue.
+ *
+ * 1) call llmsset_marking_start (no lookups allowed during this call)
+ * 2) call llmsset_mark for every bucket to rehash; lookups are allowed
+ * 3) call llmsset_marking_finish (no lookups allowed), which replaces llmsset_clear_data,
+ *    i.e., the marked buckets are now the used buckets
+ * 4) call llmsset_clear_hashes and llmsset_rehash
+ */
+void llmsset_marking_start(const llmsset_t dbs);
+
+VOID_TASK_DECL_1(llmsset_marking_finish, llmsset_t);
+#define llmsset_marking_finish(dbs) CALL(llmsset_marking_finish, dbs)
+
 /**
  * Check if a certain data bucket is marked (in use).
  */
@@ -186,16 +260,42 @@ TASK_DECL_1(int, llmsset_rehash, llmsset_t);
 
 /**
  * Rehash a single bucket.
- * Returns 0 if successful, or 1 if not.
+ * Returns 1, or 2 if the hash was stored in a bucket of a removed hash (see llmsset_unhash).
  */
 int llmsset_rehash_bucket(const llmsset_t dbs, uint64_t d_idx);
 
+/**
+ * Remove the hash of a single bucket, for example to change its data in place (see reordering).
+ * The data bucket stays in use. The hash bucket is not emptied, as lookups stop at empty buckets;
+ * it is reused by llmsset_rehash_bucket, and cleared by llmsset_clear_hashes.
+ * Only call this when no lookups for the data of the bucket are performed.
+ * Returns 1 if the hash was removed, or 0 if it was not found.
+ */
+int llmsset_unhash(const llmsset_t dbs, uint64_t d_idx);
+
 /**
  * Retrieve number of marked buckets.
  */
 TASK_DECL_1(size_t, llmsset_count_marked, llmsset_t);
 #define llmsset_count_marked(dbs) CALL(llmsset_count_marked, dbs)
 
+/**
+ * Retrieve 1 + the highest index of a marked bucket.
+ * During garbage collection (after marking), the table can be shrunk to this size without losing nodes.
+ */
+size_t llmsset_marked_bound(const llmsset_t dbs);
+
+/**
+ * Move the marked buckets to other positions (compacting garbage collection, after marking).
+ * <relocate> returns the new position of a marked bucket; the new positions must be different,
+ * at least 2 and smaller than the table size. The data moves to new arrays, so the memory of the
+ * old arrays is returned to the operating system. Afterwards, the marked buckets are the new
+ * positions and the hash array must be rebuilt (llmsset_clear_hashes and llmsset_rehash).
+ */
+typedef uint64_t (*llmsset_relocate_cb)(uint64_t);
+VOID_TASK_DECL_2(llmsset_relocate, llmsset_t, llmsset_relocate_cb);
+#define llmsset_relocate(dbs, relocate) CALL(llmsset_relocate, dbs, relocate)
+
 /**
  * During garbage collection, this method calls the destroy callback
  * for all 'custom' data that is not kept.
@@ -213,6 +313,24 @@ void llmsset_set_custom(const llmsset_t dbs, llmsset_hash_cb hash_cb, llmsset_eq
  */
 uint64_t llmsset_hash(const uint64_t a, const uint64_t b, const uint64_t seed);
 
+/**
+ * Compute hashes[i] = llmsset_hash(a[i], b[i], seed) for <count> keys.
+ * Uses AVX-512 or AVX2 if the CPU supports it (detected in llmsset_create), which hashes
+ * 8 or 4 keys at once. Used by llmsset_lookup_batch and llmsset_rehash.
+ */
+void llmsset_hash_many(size_t count, const uint64_t *a, const uint64_t *b, const uint64_t seed, uint64_t *hashes);
+
+/**
+ * Select the implementation of llmsset_hash_many (for testing); llmsset_create selects LLMSSET_HASH_AUTO,
+ * the widest implementation that the CPU supports.
+ * Returns 0 (and keeps the current implementation) if the CPU or the build does not support <impl>.
+ */
+#define LLMSSET_HASH_AUTO   0
+#define LLMSSET_HASH_SCALAR 1
+#define LLMSSET_HASH_AVX2   2
+#define LLMSSET_HASH_AVX512 3
+int llmsset_hash_select(int impl);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
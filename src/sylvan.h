@@ -34,7 +34,10 @@
 #include <tls.h>
 
 #include <sylvan_common.h>
+#include <sylvan_mem.h>
 #include <sylvan_stats.h>
 #include <sylvan_mtbdd.h>
 #include <sylvan_bdd.h>
 #include <sylvan_ldd.h>
+#include <sylvan_reorder.h>
+#include <sylvan_levels.h>
@@ -1913,6 +1913,43 @@ sylvan_serialize_reset()
     sylvan_ser_done = 0;
 }
 
+/**
+ * The serialization state of a detached context (see sylvan_context_detach)
+ */
+struct sylvan_ser_context
+{
+    avl_node_t *set;
+    avl_node_t *reversed_set;
+    size_t counter;
+    size_t done;
+};
+
+void*
+sylvan_serialize_context_detach()
+{
+    struct sylvan_ser_context *c = (struct sylvan_ser_context*)malloc(sizeof(struct sylvan_ser_context));
+    c->set = sylvan_ser_set;
+    c->reversed_set = sylvan_ser_reversed_set;
+    c->counter = sylvan_ser_counter;
+    c->done = sylvan_ser_done;
+    sylvan_ser_set = NULL;
+    sylvan_ser_reversed_set = NULL;
+    sylvan_ser_counter = 1;
+    sylvan_ser_done = 0;
+    return c;
+}
+
+void
+sylvan_serialize_context_attach(void *context)
+{
+    struct sylvan_ser_context *c = (struct sylvan_ser_context*)context;
+    sylvan_ser_set = c->set;
+    sylvan_ser_reversed_set = c->reversed_set;
+    sylvan_ser_counter = c->counter;
+    sylvan_ser_done = c->done;
+    free(c);
+}
+
 size_t
 sylvan_serialize_get(BDD bdd)
 {
@@ -2001,23 +2038,74 @@ sylvan_serialize_fromfile(FILE *in)
         exit(-1);
     }
 
+    // the nodes in the file are assigned <base+1> to <base+count>
+    const size_t base = sylvan_ser_done;
+
+    struct bddnode *stored = (struct bddnode*)malloc(sizeof(struct bddnode[count+1]));
+    uint32_t *height = (uint32_t*)malloc(sizeof(uint32_t[count+1]));
+    uint32_t max_height = 0;
+
     for (i=1; i<=count; i++) {
-        struct bddnode node;
-        if (fread(&node, sizeof(struct bddnode), 1, in) != 1) {
+        struct bddnode *node = stored + i;
+        if (fread(node, sizeof(struct bddnode), 1, in) != 1) {
             // TODO FIXME return error
             printf("sylvan_serialize_fromfile: file format error, giving up\n");
             exit(-1);
         }
 
-        BDD low = sylvan_serialize_get_reversed(bddnode_getlow(&node));
-        BDD high = sylvan_serialize_get_reversed(bddnode_gethigh(&node));
+        // the height of a node is 1 + the height of its children in this file
+        uint32_t h = 1;
+        BDD low = BDD_STRIPMARK(bddnode_getlow(node)), high = BDD_STRIPMARK(bddnode_gethigh(node));
+        if (sylvan_isnode(low) && low > base && height[low-base] >= h) h = height[low-base] + 1;
+        if (sylvan_isnode(high) && high > base && height[high-base] >= h) h = height[high-base] + 1;
+        height[i] = h;
+        if (h > max_height) max_height = h;
+    }
+
+    // sort the nodes by height (counting sort), then create the nodes of each height in one batch
+    size_t *end = (size_t*)calloc(max_height+1, sizeof(size_t));
+    for (i=1; i<=count; i++) end[height[i]]++;
+    for (uint32_t h=1; h<=max_height; h++) end[h] += end[h-1];
+
+    size_t *order = (size_t*)malloc(sizeof(size_t[count+1]));
+    uint32_t *vars = (uint32_t*)malloc(sizeof(uint32_t[count+1]));
+    BDD *lows = (BDD*)malloc(sizeof(BDD[count+1]));
+    BDD *highs = (BDD*)malloc(sizeof(BDD[count+1]));
+    BDD *results = (BDD*)malloc(sizeof(BDD[count+1]));
+
+    size_t *next = (size_t*)malloc(sizeof(size_t[max_height+1]));
+    for (uint32_t h=1; h<=max_height; h++) next[h] = end[h-1];
+    for (i=1; i<=count; i++) order[next[height[i]]++] = i;
+
+    for (uint32_t h=1; h<=max_height; h++) {
+        for (size_t k=end[h-1]; k<end[h]; k++) {
+            struct bddnode *node = stored + order[k];
+            vars[k] = bddnode_getvariable(node);
+            lows[k] = sylvan_serialize_get_reversed(bddnode_getlow(node));
+            highs[k] = sylvan_serialize_get_reversed(bddnode_gethigh(node));
+        }
+        sylvan_makenode_batch(end[h]-end[h-1], vars+end[h-1], lows+end[h-1], highs+end[h-1], results+end[h-1]);
+
+        // insert in the serialization, which also keeps the nodes during garbage collection
+        for (size_t k=end[h-1]; k<end[h]; k++) {
+            struct sylvan_ser s;
+            s.bdd = results[k];
+            s.assigned = base + order[k];
+            sylvan_ser_insert(&sylvan_ser_set, &s);
+            sylvan_ser_reversed_insert(&sylvan_ser_reversed_set, &s);
+        }
+    }
 
-        struct sylvan_ser s;
-        s.bdd = sylvan_makenode(bddnode_getvariable(&node), low, high);
-        s.assigned = ++sylvan_ser_done; // starts at 0 but we want 1-based...
+    sylvan_ser_done = base + count;
 
-        sylvan_ser_insert(&sylvan_ser_set, &s);
-        sylvan_ser_reversed_insert(&sylvan_ser_reversed_set, &s);
-    }
+    free(stored);
+    free(height);
+    free(end);
+    free(next);
+    free(order);
+    free(vars);
+    free(lows);
+    free(highs);
+    free(results);
 }
 
@@ -16,13 +16,20 @@
  */
 
 #include <errno.h>  // for errno
+#include <pthread.h> // for pthread_self
 #include <stdio.h>  // for fprintf
 #include <stdint.h> // for uint32_t etc
 #include <stdlib.h> // for exit
 #include <string.h> // for strerror
 #include <sys/mman.h> // for mmap
 
+#if defined(__SSE2__)
+#include <immintrin.h> // for SSE2/AVX2 compares
+#endif
+
 #include <sylvan_cache.h>
+#include <sylvan_mem.h>
+#include <tls.h>
 
 #ifndef MAP_ANONYMOUS
 #define MAP_ANONYMOUS MAP_ANON
@@ -39,9 +46,13 @@
 /**
  * This cache is designed to store a,b,c->res, with a,b,c,res 64-bit integers.
  *
- * Each cache bucket takes 32 bytes, 2 per cache line.
- * Each cache status bucket takes 4 bytes, 16 per cache line.
+ * Each cache entry takes 32 bytes, 2 per cache line.
+ * Each cache status takes 4 bytes, 16 per cache line.
  * Therefore, size 2^N = 36*(2^N) bytes.
+ *
+ * The cache is set-associative: a key can be stored in the CACHE_WAYS entries of its bucket.
+ * The statuses of a bucket are adjacent, so one (SIMD) compare of the statuses with the hash
+ * finds the entries that may hold the key, and only those entries are read.
  */
 
 struct __attribute__((packed)) cache_entry {
@@ -51,6 +62,21 @@ struct __attribute__((packed)) cache_entry {
     uint64_t            res;
 };
 
+/**
+ * The wide cache stores a,b,c,d,e,f->res for operations with more parameters.
+ * Each wide entry takes 64 bytes (one cache line), including its status.
+ * The wide cache has 1/CACHE_WIDE_RATIO as many entries as the cache and is direct-mapped.
+ */
+
+struct cache_wide_entry {
+    uint64_t            key[6];
+    uint64_t            res;
+    volatile uint32_t   status;
+    uint32_t            pad;
+};
+
+typedef struct cache_wide_entry *cache_wide_entry_t;
+
 static size_t             cache_size;         // power of 2
 static size_t             cache_max;          // power of 2
 #if CACHE_MASK
@@ -58,18 +84,203 @@ static size_t             cache_mask;         // cache_size-1
 #endif
 static cache_entry_t      cache_table;
 static uint32_t*          cache_status;
+static cache_wide_entry_t cache_wide_table;
 
 static uint64_t           next_opid;
 
+/* The opid is stored in bits SYLVAN_INDEX_BITS..62 of the first parameter */
+#define CACHE_OPID_MASK (0x7fffffffffffffff >> SYLVAN_INDEX_BITS)
+
+/**
+ * Layouts and priorities of the cache entries, per operation (opid >> SYLVAN_INDEX_BITS).
+ * Operations created with cache_next_opid beyond CACHE_LAYOUT_COUNT have no layout and priority 0.
+ */
+#define CACHE_LAYOUT_COUNT 1024
+static uint8_t            cache_layouts[CACHE_LAYOUT_COUNT];
+static uint8_t            cache_priorities[CACHE_LAYOUT_COUNT];
+
 uint64_t
 cache_next_opid()
 {
-    return __sync_fetch_and_add(&next_opid, 1LL<<40);
+    return __sync_fetch_and_add(&next_opid, 1LL<<SYLVAN_INDEX_BITS);
+}
+
+void
+cache_set_layout(uint64_t opid, int layout)
+{
+    const uint64_t id = opid >> SYLVAN_INDEX_BITS;
+    if (id < CACHE_LAYOUT_COUNT) cache_layouts[id] = (uint8_t)layout;
+}
+
+void
+cache_set_priority(uint64_t opid, int priority)
+{
+    const uint64_t id = opid >> SYLVAN_INDEX_BITS;
+    if (priority < 0) priority = 0;
+    if (priority > CACHE_PRIORITY_MAX) priority = CACHE_PRIORITY_MAX;
+    if (id < CACHE_LAYOUT_COUNT) cache_priorities[id] = (uint8_t)priority;
+}
+
+int
+cache_get_priority(uint64_t opid)
+{
+    const uint64_t id = opid >> SYLVAN_INDEX_BITS;
+    return id < CACHE_LAYOUT_COUNT ? cache_priorities[id] : 0;
+}
+
+/**
+ * Sampled statistics of the operation cache, per thread and per operation.
+ * Every thread records one in CACHE_STATS_SAMPLE events (chosen at random), and adds
+ * CACHE_STATS_SAMPLE to the counter. The counters of all threads are in a list,
+ * so cache_stats_snapshot can add them up while the threads continue.
+ * Every context has its own list. The generation tells threads that the list changed, because
+ * the list was freed by cache_stats_free or the context was switched.
+ */
+
+#if CACHE_STATS_SAMPLE
+
+typedef struct cache_stats_local
+{
+    struct cache_stats_local *next;
+    pthread_t owner;
+    uint64_t rng;
+    cache_stats_t ops[CACHE_LAYOUT_COUNT+1]; // the last for operations beyond CACHE_LAYOUT_COUNT
+} *cache_stats_local_t;
+
+static cache_stats_local_t cache_stats_all = NULL;
+static size_t cache_stats_generation = 1;
+
+DECLARE_THREAD_LOCAL(cache_stats_key, cache_stats_local_t);
+DECLARE_THREAD_LOCAL(cache_stats_generation_key, size_t);
+
+static cache_stats_local_t __attribute__((noinline))
+cache_stats_create_local()
+{
+    // after a context switch, the list of the context may already have the counters of this thread
+    const pthread_t self = pthread_self();
+    cache_stats_local_t local = cache_stats_all;
+    while (local != NULL && !pthread_equal(local->owner, self)) local = local->next;
+
+    if (local == NULL) {
+        local = (cache_stats_local_t)mmap(0, sizeof(struct cache_stats_local), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (local == (cache_stats_local_t)-1) {
+            fprintf(stderr, "cache_stats: Unable to allocate memory: %s!\n", strerror(errno));
+            exit(1);
+        }
+        local->owner = self;
+        local->rng = ((uint64_t)(size_t)local) | 1;
+        for (;;) {
+            cache_stats_local_t next = cache_stats_all;
+            local->next = next;
+            if (cas(&cache_stats_all, next, local)) break;
+        }
+    }
+    SET_THREAD_LOCAL(cache_stats_key, local);
+    SET_THREAD_LOCAL(cache_stats_generation_key, cache_stats_generation);
+    return local;
+}
+
+static inline void
+cache_stats_record(uint64_t a, int event)
+{
+    LOCALIZE_THREAD_LOCAL(cache_stats_key, cache_stats_local_t);
+    LOCALIZE_THREAD_LOCAL(cache_stats_generation_key, size_t);
+    cache_stats_local_t local = cache_stats_key;
+    if (__builtin_expect(cache_stats_generation_key != cache_stats_generation, 0)) local = cache_stats_create_local();
+
+    // xorshift
+    uint64_t x = local->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    local->rng = x;
+    if (x & (CACHE_STATS_SAMPLE-1)) return;
+
+    // the opid is stored in the bits of a above the node index (except the complement mark)
+    uint64_t id = (a >> SYLVAN_INDEX_BITS) & CACHE_OPID_MASK;
+    if (id > CACHE_LAYOUT_COUNT) id = CACHE_LAYOUT_COUNT;
+    local->ops[id].counters[event] += CACHE_STATS_SAMPLE;
+}
+
+#else
+
+static inline void
+cache_stats_record(uint64_t a, int event)
+{
+    (void)a;
+    (void)event;
+}
+
+#endif
+
+static inline void
+cache_stats_record_put(uint64_t a, int stored)
+{
+    if (stored == 0) cache_stats_record(a, CACHE_STATS_PUT_ABORT);
+    else if (stored == 1) cache_stats_record(a, CACHE_STATS_PUT);
+    else cache_stats_record(a, CACHE_STATS_OVERWRITE);
+}
+
+/**
+ * Add the counters of operation <id> of all threads to <stats>
+ */
+static void
+cache_stats_add(uint64_t id, cache_stats_t *stats)
+{
+#if CACHE_STATS_SAMPLE
+    for (cache_stats_local_t local = cache_stats_all; local != NULL; local = local->next) {
+        for (int i=0; i<CACHE_STATS_COUNTERS; i++) stats->counters[i] += local->ops[id].counters[i];
+    }
+#else
+    (void)id;
+    (void)stats;
+#endif
+}
+
+void
+cache_stats_snapshot(cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(cache_stats_t));
+    for (uint64_t id=0; id<=CACHE_LAYOUT_COUNT; id++) cache_stats_add(id, stats);
+}
+
+void
+cache_stats_snapshot_op(uint64_t opid, cache_stats_t *stats)
+{
+    uint64_t id = (opid >> SYLVAN_INDEX_BITS) & CACHE_OPID_MASK;
+    if (id > CACHE_LAYOUT_COUNT) id = CACHE_LAYOUT_COUNT;
+    memset(stats, 0, sizeof(cache_stats_t));
+    cache_stats_add(id, stats);
+}
+
+void
+cache_stats_reset()
+{
+#if CACHE_STATS_SAMPLE
+    for (cache_stats_local_t local = cache_stats_all; local != NULL; local = local->next) {
+        memset(local->ops, 0, sizeof(local->ops));
+    }
+#endif
+}
+
+void
+cache_stats_free()
+{
+#if CACHE_STATS_SAMPLE
+    while (cache_stats_all != NULL) {
+        cache_stats_local_t local = cache_stats_all;
+        cache_stats_all = local->next;
+        munmap(local, sizeof(struct cache_stats_local));
+    }
+    // threads that still refer to their old counters create new ones
+    cache_stats_generation++;
+#endif
 }
 
 // status: 0x80000000 - bitlock
-//         0x7fff0000 - hash (part of the 64-bit hash not used to position)
-//         0x0000ffff - tag (every put increases tag field)
+//         0x60000000 - priority of the operation
+//         0x1fff0000 - hash (part of the 64-bit hash not used to position)
+//         0x0000ffff - tag (every put in the bucket increases the tag, never 0)
 
 /* Rotating 64-bit FNV-1a hash */
 static uint64_t
@@ -84,76 +295,248 @@ cache_hash(uint64_t a, uint64_t b, uint64_t c)
     return hash;
 }
 
+/**
+ * Get the first entry of the bucket of <hash>.
+ * The low bits of the hash only depend on the low bits of the key, so mix in higher bits.
+ */
+static inline size_t
+cache_first(uint64_t hash)
+{
+#if CACHE_MASK
+    return (hash ^ (hash >> 24)) & cache_mask & ~(size_t)(CACHE_WAYS-1);
+#else
+    return ((hash ^ (hash >> 24)) % (cache_size / CACHE_WAYS)) * CACHE_WAYS;
+#endif
+}
+
+/**
+ * Get a bitmask of the entries of the bucket that are not locked and have hash <h>
+ */
+static inline unsigned
+cache_match(volatile uint32_t *s_bucket, uint32_t h)
+{
+#if CACHE_WAYS == 4 && defined(__SSE2__)
+    __m128i s = _mm_load_si128((const __m128i*)s_bucket);
+    s = _mm_and_si128(s, _mm_set1_epi32(0x9fff0000));
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(s, _mm_set1_epi32(h))));
+#elif CACHE_WAYS == 8 && defined(__AVX2__)
+    __m256i s = _mm256_load_si256((const __m256i*)s_bucket);
+    s = _mm256_and_si256(s, _mm256_set1_epi32(0x9fff0000));
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(s, _mm256_set1_epi32(h))));
+#else
+    unsigned match = 0;
+    for (int i=0; i<CACHE_WAYS; i++) {
+        if ((s_bucket[i] & 0x9fff0000) == h) match |= 1U<<i;
+    }
+    return match;
+#endif
+}
+
+static inline int
+cache_get_entry(uint64_t a, uint64_t b, uint64_t c, uint64_t *res)
+{
+    const uint64_t hash = cache_hash(a, b, c);
+    const size_t first = cache_first(hash);
+    volatile uint32_t *s_bucket = cache_status + first;
+    cache_entry_t bucket = cache_table + first;
+    const uint32_t h = (hash>>32) & 0x1fff0000;
+
+    unsigned match = cache_match(s_bucket, h);
+    compiler_barrier();
+    while (match) {
+        const int i = __builtin_ctz(match);
+        match &= match - 1;
+        const uint32_t s = s_bucket[i];
+        compiler_barrier();
+        // skip if locked or different hash (changed after cache_match)
+        if ((s & 0x9fff0000) != h) continue;
+        // skip if key different
+        cache_entry_t entry = bucket + i;
+        if (entry->a != a || entry->b != b || entry->c != c) continue;
+        *res = entry->res;
+        compiler_barrier();
+        // abort if status field changed after compiler_barrier()
+        return s_bucket[i] == s ? 1 : 0;
+    }
+    return 0;
+}
+
+/**
+ * Returns 0 if aborted, 1 if stored, 2 if stored by replacing an entry with a different key
+ */
+static inline int
+cache_put_entry(uint64_t a, uint64_t b, uint64_t c, uint64_t res)
+{
+    const uint64_t hash = cache_hash(a, b, c);
+    const size_t first = cache_first(hash);
+    volatile uint32_t *s_bucket = cache_status + first;
+    cache_entry_t bucket = cache_table + first;
+    const uint32_t h = (hash>>32) & 0x1fff0000;
+
+    // the opid is stored in the bits of a above the node index (except the complement mark)
+    const uint64_t id = (a >> SYLVAN_INDEX_BITS) & CACHE_OPID_MASK;
+    const uint32_t priority = id < CACHE_LAYOUT_COUNT ? cache_priorities[id] : 0;
+
+    uint32_t s[CACHE_WAYS];
+    for (int i=0; i<CACHE_WAYS; i++) s[i] = s_bucket[i];
+
+    /**
+     * Replace the entry with the same hash (probably the same key), or else an empty entry,
+     * or else the entry with the highest age, where entries with priority p age 2^p times slower.
+     * The tags of a bucket are consecutive (every put takes the newest tag plus one),
+     * so the age of an entry is the difference between the newest tag and its tag.
+     */
+    int victim = -1;
+    int16_t newest_age = INT16_MIN, rel[CACHE_WAYS];
+    uint16_t ref = 0;
+    for (int i=0; i<CACHE_WAYS; i++) {
+        if (s[i] == 0) continue;
+        if (ref == 0) ref = (uint16_t)s[i];
+        rel[i] = (int16_t)((uint16_t)s[i] - ref);
+        if (rel[i] > newest_age) newest_age = rel[i];
+        if (victim == -1 && (s[i] & 0x1fff0000) == h) victim = i;
+    }
+    if (victim == -1) {
+        int victim_age = -1;
+        for (int i=0; i<CACHE_WAYS; i++) {
+            if (s[i] == 0) { victim = i; break; }
+            const int age = (newest_age - rel[i]) >> ((s[i] >> 29) & 3);
+            if (age > victim_age) { victim_age = age; victim = i; }
+        }
+    }
+
+    // abort if locked
+    if (s[victim] & 0x80000000) return 0;
+    uint16_t tag = ref == 0 ? 1 : (uint16_t)(ref + newest_age + 1);
+    if (tag == 0) tag = 1;
+    const uint32_t new_s = tag | h | (priority << 29);
+    // use cas to claim bucket
+    if (!cas(s_bucket + victim, s[victim], new_s | 0x80000000)) return 0;
+    // cas succesful: write data
+    cache_entry_t entry = bucket + victim;
+    entry->a = a;
+    entry->b = b;
+    entry->c = c;
+    entry->res = res;
+    compiler_barrier();
+    // after compiler_barrier(), unlock status field
+    s_bucket[victim] = new_s;
+    return (s[victim] != 0 && (s[victim] & 0x1fff0000) != h) ? 2 : 1;
+}
+
 int
 cache_get(uint64_t a, uint64_t b, uint64_t c, uint64_t *res)
 {
-    const uint64_t hash = cache_hash(a, b, c);
+    const int found = cache_get_entry(a, b, c, res);
+    cache_stats_record(a, found ? CACHE_STATS_HIT : CACHE_STATS_MISS);
+    return found;
+}
+
+int
+cache_put(uint64_t a, uint64_t b, uint64_t c, uint64_t res)
+{
+    const int stored = cache_put_entry(a, b, c, res);
+    cache_stats_record_put(a, stored);
+    return stored ? 1 : 0;
+}
+
+/* Rotating 64-bit FNV-1a hash of the key of a wide entry */
+static uint64_t
+cache_wide_hash(const uint64_t *key)
+{
+    const uint64_t prime = 1099511628211;
+    uint64_t hash = 14695981039346656037LLU;
+    hash = (hash ^ (key[0]>>32));
+    for (int i=0; i<6; i++) hash = (hash ^ key[i]) * prime;
+    return hash;
+}
+
+static inline cache_wide_entry_t
+cache_wide_bucket(uint64_t hash)
+{
+    const size_t size = cache_size / CACHE_WIDE_RATIO;
 #if CACHE_MASK
-    volatile uint32_t *s_bucket = cache_status + (hash & cache_mask);
-    cache_entry_t bucket = cache_table + (hash & cache_mask);
+    return cache_wide_table + ((hash ^ (hash >> 24)) & (size - 1));
 #else
-    volatile uint32_t *s_bucket = cache_status + (hash % cache_size);
-    cache_entry_t bucket = cache_table + (hash % cache_size);
+    return cache_wide_table + ((hash ^ (hash >> 24)) % size);
 #endif
-    const uint32_t s = *s_bucket;
+}
+
+static inline int
+cache_get_wide_entry(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t *res)
+{
+    const uint64_t key[6] = {a, b, c, d, e, f};
+    const uint64_t hash = cache_wide_hash(key);
+    cache_wide_entry_t bucket = cache_wide_bucket(hash);
+    const uint32_t s = bucket->status;
     compiler_barrier();
     // abort if locked
     if (s & 0x80000000) return 0;
     // abort if different hash
     if ((s ^ (hash>>32)) & 0x7fff0000) return 0;
     // abort if key different
-    if (bucket->a != a || bucket->b != b || bucket->c != c) return 0;
+    for (int i=0; i<6; i++) if (bucket->key[i] != key[i]) return 0;
     *res = bucket->res;
     compiler_barrier();
     // abort if status field changed after compiler_barrier()
-    return *s_bucket == s ? 1 : 0;
+    return bucket->status == s ? 1 : 0;
 }
 
-int
-cache_put(uint64_t a, uint64_t b, uint64_t c, uint64_t res)
+/**
+ * Returns 0 if aborted, 1 if stored, 2 if stored by replacing an entry with a different key
+ */
+static inline int
+cache_put_wide_entry(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t res)
 {
-    const uint64_t hash = cache_hash(a, b, c);
-#if CACHE_MASK
-    volatile uint32_t *s_bucket = cache_status + (hash & cache_mask);
-    cache_entry_t bucket = cache_table + (hash & cache_mask);
-#else
-    volatile uint32_t *s_bucket = cache_status + (hash % cache_size);
-    cache_entry_t bucket = cache_table + (hash % cache_size);
-#endif
-    const uint32_t s = *s_bucket;
+    const uint64_t key[6] = {a, b, c, d, e, f};
+    const uint64_t hash = cache_wide_hash(key);
+    cache_wide_entry_t bucket = cache_wide_bucket(hash);
+    const uint32_t s = bucket->status;
     // abort if locked
     if (s & 0x80000000) return 0;
-    // abort if hash identical -> no: in iscasmc this occasionally causes timeouts?!
     const uint32_t hash_mask = (hash>>32) & 0x7fff0000;
-    // if ((s & 0x7fff0000) == hash_mask) return 0;
-    // use cas to claim bucket
-    const uint32_t new_s = ((s+1) & 0x0000ffff) | hash_mask;
-    if (!cas(s_bucket, s, new_s | 0x80000000)) return 0;
+    // use cas to claim bucket (the tag is never 0)
+    uint32_t tag = (s+1) & 0x0000ffff;
+    if (tag == 0) tag = 1;
+    const uint32_t new_s = tag | hash_mask;
+    if (!cas(&bucket->status, s, new_s | 0x80000000)) return 0;
     // cas succesful: write data
-    bucket->a = a;
-    bucket->b = b;
-    bucket->c = c;
+    for (int i=0; i<6; i++) bucket->key[i] = key[i];
     bucket->res = res;
     compiler_barrier();
     // after compiler_barrier(), unlock status field
-    *s_bucket = new_s;
-    return 1;
+    bucket->status = new_s;
+    return (s != 0 && (s & 0x7fff0000) != hash_mask) ? 2 : 1;
 }
 
-void
-cache_create(size_t _cache_size, size_t _max_size)
+int
+cache_get_wide(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t *res)
+{
+    const int found = cache_get_wide_entry(a, b, c, d, e, f, res);
+    cache_stats_record(a, found ? CACHE_STATS_HIT : CACHE_STATS_MISS);
+    return found;
+}
+
+int
+cache_put_wide(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t res)
+{
+    const int stored = cache_put_wide_entry(a, b, c, d, e, f, res);
+    cache_stats_record_put(a, stored);
+    return stored ? 1 : 0;
+}
+
+/**
+ * Allocate the (cleared) tables for the current size
+ */
+static void
+cache_alloc()
 {
 #if CACHE_MASK
     // Cache size must be a power of 2
-    if (__builtin_popcountll(_cache_size) != 1 || __builtin_popcountll(_max_size) != 1) {
+    if (__builtin_popcountll(cache_size) != 1 || __builtin_popcountll(cache_max) != 1) {
         fprintf(stderr, "cache_create: Table size must be a power of 2!\n");
         exit(1);
     }
-#endif
-
-    cache_size = _cache_size;
-    cache_max  = _max_size;
-#if CACHE_MASK
     cache_mask = cache_size - 1;
 #endif
 
@@ -162,22 +545,101 @@ cache_create(size_t _cache_size, size_t _max_size)
         exit(1);
     }
 
-    cache_table = (cache_entry_t)mmap(0, cache_max * sizeof(struct cache_entry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    cache_status = (uint32_t*)mmap(0, cache_max * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    const size_t multiple = CACHE_WAYS > CACHE_WIDE_RATIO ? CACHE_WAYS : CACHE_WIDE_RATIO;
+    if (cache_size < multiple || cache_size % multiple != 0 || cache_max % multiple != 0) {
+        fprintf(stderr, "cache_create: Table size must be a multiple of %zu!\n", multiple);
+        exit(1);
+    }
+
+    cache_table = (cache_entry_t)sylvan_mem_alloc(cache_max * sizeof(struct cache_entry));
+    cache_status = (uint32_t*)sylvan_mem_alloc(cache_max * sizeof(uint32_t));
+    cache_wide_table = (cache_wide_entry_t)sylvan_mem_alloc(cache_max / CACHE_WIDE_RATIO * sizeof(struct cache_wide_entry));
 
-    if (cache_table == (cache_entry_t)-1 || cache_status == (uint32_t*)-1) {
+    if (cache_table == (cache_entry_t)-1 || cache_status == (uint32_t*)-1 || cache_wide_table == (cache_wide_entry_t)-1) {
         fprintf(stderr, "cache_create: Unable to allocate memory: %s!\n", strerror(errno));
         exit(1);
     }
+}
+
+void
+cache_create(size_t _cache_size, size_t _max_size)
+{
+#if CACHE_STATS_SAMPLE
+    static int cache_stats_initialized = 0;
+    if (!cache_stats_initialized) {
+        cache_stats_initialized = 1;
+        INIT_THREAD_LOCAL(cache_stats_key);
+        INIT_THREAD_LOCAL(cache_stats_generation_key);
+    }
+#endif
 
-    next_opid = 512LL << 40;
+    cache_size = _cache_size;
+    cache_max  = _max_size;
+    cache_alloc();
+
+    // operation identifiers stay unique over all contexts (see sylvan_context_detach)
+    if (next_opid == 0) next_opid = 512LL << SYLVAN_INDEX_BITS;
 }
 
 void
 cache_free()
 {
-    munmap(cache_table, cache_max * sizeof(struct cache_entry));
-    munmap(cache_status, cache_max * sizeof(uint32_t));
+    sylvan_mem_free(cache_table, cache_max * sizeof(struct cache_entry));
+    sylvan_mem_free(cache_status, cache_max * sizeof(uint32_t));
+    sylvan_mem_free(cache_wide_table, cache_max / CACHE_WIDE_RATIO * sizeof(struct cache_wide_entry));
+}
+
+/**
+ * The tables and statistics of a detached context
+ */
+struct cache_context
+{
+    size_t size;
+    size_t max;
+    cache_entry_t table;
+    uint32_t *status;
+    cache_wide_entry_t wide_table;
+    void *stats;
+};
+
+void*
+cache_context_detach()
+{
+    struct cache_context *c = (struct cache_context*)malloc(sizeof(struct cache_context));
+    c->size = cache_size;
+    c->max = cache_max;
+    c->table = cache_table;
+    c->status = cache_status;
+    c->wide_table = cache_wide_table;
+    cache_size = cache_max = 0;
+    cache_table = NULL;
+    cache_status = NULL;
+    cache_wide_table = NULL;
+#if CACHE_STATS_SAMPLE
+    c->stats = cache_stats_all;
+    cache_stats_all = NULL;
+    cache_stats_generation++;
+#endif
+    return c;
+}
+
+void
+cache_context_attach(void *context)
+{
+    struct cache_context *c = (struct cache_context*)context;
+    cache_size = c->size;
+    cache_max = c->max;
+#if CACHE_MASK
+    cache_mask = cache_size - 1;
+#endif
+    cache_table = c->table;
+    cache_status = c->status;
+    cache_wide_table = c->wide_table;
+#if CACHE_STATS_SAMPLE
+    cache_stats_all = (cache_stats_local_t)c->stats;
+    cache_stats_generation++;
+#endif
+    free(c);
 }
 
 void
@@ -185,7 +647,7 @@ cache_clear()
 {
     // a bit silly, but this works just fine, and does not require writing 0 everywhere...
     cache_free();
-    cache_create(cache_size, cache_max);
+    cache_alloc();
 }
 
 void
@@ -193,7 +655,67 @@ cache_setsize(size_t size)
 {
     // easy solution
     cache_free();
-    cache_create(size, cache_max);
+    cache_size = size;
+    cache_alloc();
+}
+
+/**
+ * Check if the entry with key <key> and result <res> of an operation with <layout> must be kept
+ */
+static inline int
+cache_keep(const uint64_t *key, int count, uint64_t res, int layout, cache_alive_cb alive)
+{
+    static const int flags[6] = {CACHE_NODE_A, CACHE_NODE_B, CACHE_NODE_C, CACHE_NODE_D, CACHE_NODE_E, CACHE_NODE_F};
+    if (layout == 0) return 0;
+    for (int i=0; i<count; i++) {
+        if ((layout & flags[i]) && !alive(key[i] & SYLVAN_INDEX_MASK)) return 0;
+    }
+    if ((layout & CACHE_NODE_RES) && !alive(res & SYLVAN_INDEX_MASK)) return 0;
+    return 1;
+}
+
+static inline int
+cache_layout(uint64_t a)
+{
+    // the opid is stored in the bits of a above the node index (except the complement mark)
+    const uint64_t id = (a >> SYLVAN_INDEX_BITS) & CACHE_OPID_MASK;
+    return id < CACHE_LAYOUT_COUNT ? cache_layouts[id] : 0;
+}
+
+void
+cache_clear_dead(size_t first, size_t count, cache_alive_cb alive)
+{
+    if (first >= cache_size) return;
+    if (count > cache_size - first) count = cache_size - first;
+
+    for (size_t i=first; i<first+count; i++) {
+        if (cache_status[i] == 0) continue;
+        cache_entry_t bucket = cache_table + i;
+
+        // the fourth parameter (CACHE_NODE_D) is only in wide entries
+        const uint64_t key[3] = {bucket->a, bucket->b, bucket->c};
+        if (!cache_keep(key, 3, bucket->res, cache_layout(bucket->a), alive)) {
+            // same as a cleared bucket
+            bucket->a = 0;
+            bucket->b = 0;
+            bucket->c = 0;
+            bucket->res = 0;
+            cache_status[i] = 0;
+        }
+    }
+
+    // the wide entries that correspond to the buckets <first> to <first+count>
+    const size_t wide_first = first / CACHE_WIDE_RATIO;
+    const size_t wide_last = (first + count) / CACHE_WIDE_RATIO;
+    for (size_t i=wide_first; i<wide_last; i++) {
+        cache_wide_entry_t bucket = cache_wide_table + i;
+        if (bucket->status == 0) continue;
+
+        if (!cache_keep(bucket->key, 6, bucket->res, cache_layout(bucket->key[0]), alive)) {
+            // same as a cleared bucket
+            memset(bucket, 0, sizeof(struct cache_wide_entry));
+        }
+    }
 }
 
 size_t
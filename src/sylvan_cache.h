@@ -42,11 +42,20 @@ extern "C" {
  *   int success = cache_put3(opid, dd1, value2, value3, result);
  * - cache_get4/cache_put4 for any operation with 4 BDDs
  *   int success = cache_get4(opid, dd1, dd2, dd3, dd4, &result);
- *   int success = cache_get4(opid, dd1, dd2, dd3, dd4, result);
+ *   int success = cache_put4(opid, dd1, dd2, dd3, dd4, result);
+ * - cache_get6/cache_put6 for any operation with 1 BDD and up to 5 other values (that can be BDDs)
+ *   int success = cache_get6(opid, dd1, value2, value3, value4, value5, value6, &result);
+ *   int success = cache_put6(opid, dd1, value2, value3, value4, value5, value6, result);
  *
  * Notes:
  * - The "result" is any 64-bit value
  * - Use "0" for unused parameters
+ * - Operations with more than 3 parameters use a separate cache of wide entries (64 bytes),
+ *   which has 1/CACHE_WIDE_RATIO as many entries as the normal cache
+ *
+ * By default, the operation cache is cleared during garbage collection. To keep cache entries
+ * of an operation when its nodes survive garbage collection, use cache_set_layout() at
+ * initialization time to tell which of the values of the operation are nodes.
  */
 
 typedef struct cache_entry *cache_entry_t;
@@ -56,12 +65,92 @@ typedef struct cache_entry *cache_entry_t;
  */
 int cache_get(uint64_t a, uint64_t b, uint64_t c, uint64_t *res);
 int cache_put(uint64_t a, uint64_t b, uint64_t c, uint64_t res);
+int cache_get_wide(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t *res);
+int cache_put_wide(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t res);
 
 /**
  * Helper function to get next 'operation id' (during initialization of modules)
  */
 uint64_t cache_next_opid(void);
 
+/**
+ * Flags for cache_set_layout: which values of a cache entry are nodes.
+ * - CACHE_NODE_A: the first parameter (dd)
+ * - CACHE_NODE_B: the second parameter (d2 or dd2)
+ * - CACHE_NODE_C: the third parameter (d3 or dd3)
+ * - CACHE_NODE_D: the fourth parameter of cache_get4/cache_put4 (dd4) or cache_get6/cache_put6
+ * - CACHE_NODE_E: the fifth parameter of cache_get6/cache_put6
+ * - CACHE_NODE_F: the sixth parameter of cache_get6/cache_put6
+ * - CACHE_NODE_RES: the result
+ * Only the node index (the lower SYLVAN_INDEX_BITS bits) is used, i.e., the complement mark is ignored.
+ */
+#define CACHE_NODE_A   0x01
+#define CACHE_NODE_B   0x02
+#define CACHE_NODE_C   0x04
+#define CACHE_NODE_D   0x08
+#define CACHE_NODE_RES 0x10
+#define CACHE_NODE_E   0x20
+#define CACHE_NODE_F   0x40
+
+/**
+ * Set the layout of the cache entries of operation <opid>, as a combination of CACHE_NODE_* flags.
+ * Entries of operations without a layout are always removed by cache_clear_dead.
+ * All values that are nodes must be in the layout; values that are not nodes should not be.
+ */
+void cache_set_layout(uint64_t opid, int layout);
+
+/**
+ * Set the priority (0 to CACHE_PRIORITY_MAX) of the cache entries of operation <opid>.
+ * When a bucket of the cache is full, entries with priority p age 2^p times slower than
+ * entries with priority 0, so results of expensive operations are evicted less often by
+ * results of cheap operations. The default priority is 0.
+ */
+#define CACHE_PRIORITY_MAX 3
+void cache_set_priority(uint64_t opid, int priority);
+int cache_get_priority(uint64_t opid);
+
+/**
+ * Statistics of the operation cache, per operation:
+ * - CACHE_STATS_HIT: cache_get found the key
+ * - CACHE_STATS_MISS: cache_get did not find the key (also when the entry was locked)
+ * - CACHE_STATS_PUT: cache_put stored the result in an empty entry or the entry of the same key
+ * - CACHE_STATS_PUT_ABORT: cache_put did not store the result, because the entry was locked
+ * - CACHE_STATS_OVERWRITE: cache_put stored the result by replacing the entry of a different key
+ * The statistics are always collected, by sampling one in CACHE_STATS_SAMPLE events per thread,
+ * so the counters are estimates. Set CACHE_STATS_SAMPLE to 0 to disable the statistics.
+ */
+#define CACHE_STATS_HIT        0
+#define CACHE_STATS_MISS       1
+#define CACHE_STATS_PUT        2
+#define CACHE_STATS_PUT_ABORT  3
+#define CACHE_STATS_OVERWRITE  4
+#define CACHE_STATS_COUNTERS   5
+
+typedef struct cache_stats {
+    uint64_t counters[CACHE_STATS_COUNTERS];
+} cache_stats_t;
+
+/**
+ * Get the statistics of all operations, or of operation <opid>, added over all threads,
+ * in the current context.
+ * Operations created with cache_next_opid beyond the first 512 custom operations share their statistics.
+ */
+void cache_stats_snapshot(cache_stats_t *stats);
+void cache_stats_snapshot_op(uint64_t opid, cache_stats_t *stats);
+
+/**
+ * Reset the statistics of the operation cache (of the current context).
+ */
+void cache_stats_reset(void);
+
+/**
+ * Remove all entries in the buckets <first> to <first+count> that refer to a node for which
+ * <alive> returns 0, and all entries of operations without a layout.
+ * Only call this when the operation cache is not in use.
+ */
+typedef int (*cache_alive_cb)(uint64_t index);
+void cache_clear_dead(size_t first, size_t count, cache_alive_cb alive);
+
 /**
  * dd must be MTBDD, d2/d3 can be anything
  */
@@ -77,11 +166,16 @@ cache_get3(uint64_t opid, uint64_t dd, uint64_t d2, uint64_t d3, uint64_t *res)
 static inline int __attribute__((unused))
 cache_get4(uint64_t opid, uint64_t dd, uint64_t dd2, uint64_t dd3, uint64_t dd4, uint64_t *res)
 {
-    uint64_t p2 = dd2 | ((dd4 & 0x00000000000fffff) << 40); // 20 bits and complement bit
-    if (dd4 & 0x8000000000000000) p2 |= 0x4000000000000000;
-    uint64_t p3 = dd3 | ((dd4 & 0x000000fffff00000) << 20); // 20 bits
+    return cache_get_wide(dd | opid, dd2, dd3, dd4, 0, 0, res);
+}
 
-    return cache_get3(opid, dd, p2, p3, res);
+/**
+ * dd must be MTBDD, d2/d3/d4/d5/d6 can be anything
+ */
+static inline int __attribute__((unused))
+cache_get6(uint64_t opid, uint64_t dd, uint64_t d2, uint64_t d3, uint64_t d4, uint64_t d5, uint64_t d6, uint64_t *res)
+{
+    return cache_get_wide(dd | opid, d2, d3, d4, d5, d6, res);
 }
 
 /**
@@ -99,12 +193,18 @@ cache_put3(uint64_t opid, uint64_t dd, uint64_t d2, uint64_t d3, uint64_t res)
 static inline int __attribute__((unused))
 cache_put4(uint64_t opid, uint64_t dd, uint64_t dd2, uint64_t dd3, uint64_t dd4, uint64_t res)
 {
-    uint64_t p2 = dd2 | ((dd4 & 0x00000000000fffff) << 40); // 20 bits and complement bit
-    if (dd4 & 0x8000000000000000) p2 |= 0x4000000000000000;
-    uint64_t p3 = dd3 | ((dd4 & 0x000000fffff00000) << 20); // 20 bits
+    return cache_put_wide(dd | opid, dd2, dd3, dd4, 0, 0, res);
+}
 
-    return cache_put3(opid, dd, p2, p3, res);
+/**
+ * dd must be MTBDD, d2/d3/d4/d5/d6 can be anything
+ */
+static inline int __attribute__((unused))
+cache_put6(uint64_t opid, uint64_t dd, uint64_t d2, uint64_t d3, uint64_t d4, uint64_t d5, uint64_t d6, uint64_t res)
+{
+    return cache_put_wide(dd | opid, d2, d3, d4, d5, d6, res);
 }
+
 /**
  * Functions for Sylvan for cache management
  */
@@ -113,6 +213,11 @@ void cache_create(size_t _cache_size, size_t _max_size);
 
 void cache_free(void);
 
+/**
+ * Free the statistics of all threads in the current context (when Sylvan quits).
+ */
+void cache_stats_free(void);
+
 void cache_clear(void);
 
 void cache_setsize(size_t size);
@@ -123,6 +228,14 @@ size_t cache_getsize(void);
 
 size_t cache_getmaxsize(void);
 
+/**
+ * Move the tables and statistics to a snapshot and leave the cache as after cache_free, or restore a snapshot.
+ * Operation identifiers, layouts and priorities are shared by all contexts.
+ */
+void *cache_context_detach(void);
+
+void cache_context_attach(void *context);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
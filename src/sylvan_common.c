@@ -17,6 +17,9 @@
 
 #include <sylvan_int.h>
 
+#include <string.h> // for memset
+#include <time.h> // for clock_gettime
+
 #ifndef cas
 #define cas(ptr, old, new) (__sync_bool_compare_and_swap((ptr),(old),(new)))
 #endif
@@ -30,6 +33,12 @@
  */
 static int gc_enabled = 1;
 
+int
+sylvan_gc_is_enabled()
+{
+    return gc_enabled;
+}
+
 /**
  * Enable garbage collection (both automatic and manual).
  */
@@ -48,6 +57,24 @@ sylvan_gc_disable()
     gc_enabled = 0;
 }
 
+/**
+ * Enable or disable online resizing of the nodes table.
+ */
+void
+sylvan_set_online_resize(int enabled)
+{
+    llmsset_set_online_resize(nodes, enabled);
+}
+
+/**
+ * Enable or disable overflow probing in the nodes table.
+ */
+void
+sylvan_set_overflow_probe(int enabled)
+{
+    llmsset_set_overflow_probe(nodes, enabled);
+}
+
 /**
  * This variable is used for a cas flag so only one gc runs at one time
  */
@@ -65,6 +92,7 @@ typedef struct gc_hook_entry
 static gc_hook_entry_t mark_list;
 static gc_hook_entry_t pregc_list;
 static gc_hook_entry_t postgc_list;
+static gc_hook_entry_t relocate_list;
 static gc_hook_cb main_hook;
 
 void
@@ -94,12 +122,356 @@ sylvan_gc_add_mark(gc_hook_cb callback)
     mark_list = e;
 }
 
+void
+sylvan_gc_add_relocate(gc_hook_cb callback)
+{
+    gc_hook_entry_t e = (gc_hook_entry_t)malloc(sizeof(struct gc_hook_entry));
+    e->cb = callback;
+    e->next = relocate_list;
+    relocate_list = e;
+}
+
 void
 sylvan_gc_hook_main(gc_hook_cb callback)
 {
     main_hook = callback;
 }
 
+/**
+ * Incremental garbage collection
+ */
+
+int sylvan_gc_incremental = 0;
+volatile int sylvan_gc_marking = 0;
+
+void
+sylvan_gc_set_incremental(int enabled)
+{
+    sylvan_gc_incremental = enabled ? 1 : 0;
+}
+
+/**
+ * Grey nodes are stored in chunks. Every worker pushes and pops grey nodes on its own chunk.
+ * Full chunks are moved to a shared pool, from which workers take chunks when they run out.
+ */
+#define GREY_CHUNK_SIZE 510
+
+typedef struct gc_grey_chunk
+{
+    struct gc_grey_chunk *next;
+    size_t count;
+    uint64_t entries[GREY_CHUNK_SIZE]; // 8 bits for the type, 56 bits for the index
+} * gc_grey_chunk_t;
+
+typedef struct gc_worker
+{
+    gc_grey_chunk_t grey;       // current chunk of this worker
+    size_t created;             // created nodes not yet added to gc_created
+    uint64_t *mark_queue;       // queue of nodes to mark (batched marking)
+    size_t mark_head;           // first entry of the queue
+    size_t mark_count;          // number of entries in the queue
+    uint64_t seq_next;          // next sequence number of a marked node (compaction in depth-first order)
+    uint64_t seq_end;           // end of the block of sequence numbers of this worker
+    char pad[LINE_SIZE-sizeof(gc_grey_chunk_t)-sizeof(uint64_t*)-3*sizeof(size_t)-2*sizeof(uint64_t)];
+} * gc_worker_t;
+
+static gc_worker_t gc_workers;
+static gc_grey_chunk_t grey_pool;
+static gc_grey_chunk_t mark_pool;
+static volatile int grey_pool_lock;
+
+static gc_grey_cb *grey_types;
+static gc_grey_cb *relocate_types;
+static int grey_types_count;
+
+static size_t gc_live;              // number of marked nodes after the last garbage collection
+static volatile size_t gc_created;  // approximate number of nodes created since
+
+int
+sylvan_gc_register_grey(gc_grey_cb cb)
+{
+    grey_types = (gc_grey_cb*)realloc(grey_types, sizeof(gc_grey_cb) * (grey_types_count+1));
+    relocate_types = (gc_grey_cb*)realloc(relocate_types, sizeof(gc_grey_cb) * (grey_types_count+1));
+    grey_types[grey_types_count] = cb;
+    relocate_types[grey_types_count] = NULL;
+    return grey_types_count++;
+}
+
+void
+sylvan_gc_register_relocate(int type, gc_grey_cb cb)
+{
+    relocate_types[type] = cb;
+}
+
+static void
+gc_pool_publish(gc_grey_chunk_t *pool, gc_grey_chunk_t c)
+{
+    while (!cas(&grey_pool_lock, 0, 1)) continue;
+    c->next = *pool;
+    *pool = c;
+    grey_pool_lock = 0;
+}
+
+static gc_grey_chunk_t
+gc_pool_take(gc_grey_chunk_t *pool)
+{
+    if (*(gc_grey_chunk_t volatile*)pool == NULL) return NULL;
+    while (!cas(&grey_pool_lock, 0, 1)) continue;
+    gc_grey_chunk_t c = *pool;
+    if (c != NULL) *pool = c->next;
+    grey_pool_lock = 0;
+    return c;
+}
+
+#define gc_grey_publish(c) gc_pool_publish(&grey_pool, c)
+#define gc_grey_take() gc_pool_take(&grey_pool)
+
+void
+sylvan_gc_push_grey(int type, uint64_t index)
+{
+    gc_worker_t w = gc_workers + lace_get_worker()->worker;
+    gc_grey_chunk_t c = w->grey;
+    if (c == NULL || c->count == GREY_CHUNK_SIZE) {
+        if (c != NULL) gc_grey_publish(c);
+        c = (gc_grey_chunk_t)malloc(sizeof(struct gc_grey_chunk));
+        if (c == NULL) {
+            fprintf(stderr, "sylvan_gc_push_grey: Unable to allocate memory!\n");
+            exit(1);
+        }
+        c->count = 0;
+        w->grey = c;
+    }
+    c->entries[c->count++] = ((uint64_t)type << 56) | index;
+}
+
+/**
+ * Process at most <count> grey nodes, from the chunk of this worker or from the shared pool.
+ * Returns the number of processed grey nodes.
+ */
+TASK_1(size_t, sylvan_gc_grey_step, size_t, count)
+{
+    gc_worker_t w = gc_workers + __lace_worker->worker;
+    size_t done = 0;
+    while (done < count) {
+        gc_grey_chunk_t c = w->grey;
+        if (c == NULL || c->count == 0) {
+            gc_grey_chunk_t next = gc_grey_take();
+            if (next == NULL) break;
+            if (c != NULL) free(c);
+            w->grey = next;
+            continue;
+        }
+        uint64_t e = c->entries[--c->count];
+        // this may push new grey nodes, after which w->grey may be a different chunk
+        WRAP(grey_types[e >> 56], e & 0x00ffffffffffffff);
+        done++;
+    }
+    return done;
+}
+
+/**
+ * Process all grey nodes (during the final pause).
+ */
+VOID_TASK_0(sylvan_gc_grey_drain)
+{
+    CALL(sylvan_gc_grey_step, (size_t)-1);
+    gc_worker_t w = gc_workers + __lace_worker->worker;
+    if (w->grey != NULL) {
+        free(w->grey);
+        w->grey = NULL;
+    }
+}
+
+/**
+ * Batched marking (when not marking incrementally).
+ *
+ * Instead of recursively marking the children of a node with a task for every node,
+ * the marking functions push nodes on the queue of the worker with sylvan_gc_mark_push,
+ * which prefetches the node and its mark bit. The queue is processed first-in first-out,
+ * so the node is usually in the cache when it is marked and its children are pushed.
+ * (During compaction in depth-first order, the queue is processed last-in first-out.)
+ * Workers with a long queue move chunks of their queue to a shared pool, from which
+ * workers with an empty queue take chunks (see sylvan_gc_mark_drain).
+ */
+#define MARK_QUEUE_SIZE 2048 // power of 2
+#define MARK_SHARE_SIZE 256
+
+static volatile int mark_active;    // number of workers that process nodes in sylvan_gc_mark_drain
+static uint8_t *gc_types;           // 1 + the type of every marked node (compacting garbage collection)
+static uint64_t *gc_forward;        // sequence number of every marked node (compaction in depth-first order)
+static volatile uint64_t gc_seq_blocks; // number of blocks of sequence numbers given to workers
+
+static void
+gc_mark_share(gc_worker_t w, size_t count)
+{
+    gc_grey_chunk_t c = (gc_grey_chunk_t)malloc(sizeof(struct gc_grey_chunk));
+    if (c == NULL) {
+        fprintf(stderr, "sylvan_gc_mark_push: Unable to allocate memory!\n");
+        exit(1);
+    }
+    if (gc_forward == NULL) {
+        // move the newest entries of the queue to the chunk
+        for (size_t i=0; i<count; i++) {
+            c->entries[i] = w->mark_queue[(w->mark_head + --w->mark_count) & (MARK_QUEUE_SIZE-1)];
+        }
+    } else {
+        // the queue is a stack: move the oldest entries, which are the largest subgraphs
+        for (size_t i=0; i<count; i++) {
+            c->entries[i] = w->mark_queue[w->mark_head];
+            w->mark_head = (w->mark_head + 1) & (MARK_QUEUE_SIZE-1);
+            w->mark_count--;
+        }
+    }
+    c->count = count;
+    gc_pool_publish(&mark_pool, c);
+}
+
+void
+sylvan_gc_mark_push(int type, uint64_t index)
+{
+    gc_worker_t w = gc_workers + lace_get_worker()->worker;
+    if (w->mark_count == MARK_QUEUE_SIZE) {
+        gc_mark_share(w, GREY_CHUNK_SIZE);
+    } else if (w->mark_count > MARK_SHARE_SIZE && (w->mark_count & 63) == 0 &&
+               mark_active < (int)lace_workers() && *(gc_grey_chunk_t volatile*)&mark_pool == NULL) {
+        // some workers are idle: share half of the queue, at most one chunk
+        gc_mark_share(w, w->mark_count / 2 < GREY_CHUNK_SIZE ? w->mark_count / 2 : GREY_CHUNK_SIZE);
+    }
+    __builtin_prefetch(llmsset_index_to_ptr(nodes, index));
+    __builtin_prefetch(nodes->bitmapm + index/64, 1);
+    w->mark_queue[(w->mark_head + w->mark_count++) & (MARK_QUEUE_SIZE-1)] = ((uint64_t)type << 56) | index;
+}
+
+/**
+ * Mark all nodes in the queues of all workers (and their descendants).
+ * Every worker runs this task (with TOGETHER), after setting mark_active to the number of workers.
+ */
+VOID_TASK_0(sylvan_gc_mark_drain)
+{
+    gc_worker_t w = gc_workers + __lace_worker->worker;
+    for (;;) {
+        while (w->mark_count != 0) {
+            uint64_t e;
+            if (gc_forward == NULL) {
+                e = w->mark_queue[w->mark_head];
+                w->mark_head = (w->mark_head + 1) & (MARK_QUEUE_SIZE-1);
+                w->mark_count--;
+            } else {
+                // depth-first: the newest entry first
+                e = w->mark_queue[(w->mark_head + --w->mark_count) & (MARK_QUEUE_SIZE-1)];
+            }
+            const uint64_t index = e & 0x00ffffffffffffff;
+            // this may push new nodes on the queue
+            if (llmsset_mark(nodes, index)) {
+                if (gc_types != NULL) gc_types[index] = (uint8_t)(e >> 56) + 1;
+                if (gc_forward != NULL) {
+                    if (w->seq_next == w->seq_end) {
+                        w->seq_next = __sync_fetch_and_add(&gc_seq_blocks, 1) * 512;
+                        w->seq_end = w->seq_next + 512;
+                    }
+                    gc_forward[index] = w->seq_next++;
+                }
+                WRAP(grey_types[e >> 56], index);
+            }
+        }
+
+        gc_grey_chunk_t c = gc_pool_take(&mark_pool);
+        if (c != NULL) {
+            for (size_t i=0; i<c->count; i++) {
+                const uint64_t e = c->entries[i];
+                sylvan_gc_mark_push((int)(e >> 56), e & 0x00ffffffffffffff);
+            }
+            free(c);
+            continue;
+        }
+
+        // no work: wait until another worker shares nodes, or all workers are done
+        __sync_fetch_and_sub(&mark_active, 1);
+        for (;;) {
+            if (*(gc_grey_chunk_t volatile*)&mark_pool != NULL) {
+                __sync_fetch_and_add(&mark_active, 1);
+                break;
+            }
+            if (mark_active == 0) return;
+        }
+    }
+}
+
+/**
+ * Mark the roots with the marking callbacks, then mark all queued nodes.
+ */
+VOID_TASK_0(sylvan_gc_mark_roots)
+{
+    mark_active = lace_workers();
+    for (gc_hook_entry_t e = mark_list; e != NULL; e = e->next) {
+        WRAP(e->cb);
+    }
+
+    TOGETHER(sylvan_gc_mark_drain);
+}
+
+static int gc_marking_pending = 0;
+
+/**
+ * Start incremental marking: mark the roots grey.
+ */
+VOID_TASK_0(sylvan_gc_marking_start)
+{
+    // a garbage collection may have happened before this frame started
+    if (sylvan_gc_marking != 0) return;
+    if ((gc_live + gc_created) * 100 < llmsset_get_size(nodes) * SYLVAN_GC_INCREMENTAL_START) return;
+
+    llmsset_marking_start(nodes);
+    sylvan_gc_marking = 1;
+
+    for (gc_hook_entry_t e = mark_list; e != NULL; e = e->next) {
+        WRAP(e->cb);
+    }
+}
+
+/**
+ * Finish incremental marking (during garbage collection)
+ * Afterwards, the marked nodes are the used nodes, as after sylvan_clear_and_mark,
+ * except that llmsset_destroy_unmarked is not yet called.
+ */
+VOID_TASK_0(sylvan_gc_marking_finish)
+{
+    // from now on, the marking functions mark the children of marked nodes immediately
+    sylvan_gc_marking = 2;
+    TOGETHER(sylvan_gc_grey_drain);
+
+    // mark nodes that became reachable from the roots since the roots were marked.
+    // This visits every reachable node created during marking, so the pause grows with the
+    // number of created nodes. Marking new nodes when they are created (allocate-black) is not
+    // enough: a lookup in the nodes table or the operation cache can return a node that was
+    // unreachable when marking started, and neither knows the type of the node to mark its children.
+    CALL(sylvan_gc_mark_roots);
+
+    llmsset_marking_finish(nodes);
+    sylvan_gc_marking = 0;
+}
+
+void
+sylvan_gc_step(int created)
+{
+    if (sylvan_gc_marking == 1) {
+        LACE_ME;
+        CALL(sylvan_gc_grey_step, SYLVAN_GC_INCREMENTAL_STEP);
+    } else if (created && sylvan_gc_marking == 0 && gc_enabled) {
+        gc_worker_t w = gc_workers + lace_get_worker()->worker;
+        if (++w->created < 1024) return;
+        w->created = 0;
+        size_t used = gc_live + __sync_add_and_fetch(&gc_created, 1024);
+        if (used * 100 < llmsset_get_size(nodes) * SYLVAN_GC_INCREMENTAL_START) return;
+        if (cas(&gc_marking_pending, 0, 1)) {
+            LACE_ME;
+            // the roots are only marked grey, so this pause is short
+            NEWFRAME(sylvan_gc_marking_start);
+            gc_marking_pending = 0;
+        }
+    }
+}
+
 /**
  * Clear the operation cache.
  */
@@ -108,6 +480,44 @@ VOID_TASK_IMPL_0(sylvan_clear_cache)
    cache_clear();
 }
 
+/**
+ * Keep cache entries whose nodes survive garbage collection
+ */
+
+static int gc_preserve_cache = 0;
+
+void
+sylvan_gc_set_preserve_cache(int enabled)
+{
+    gc_preserve_cache = enabled ? 1 : 0;
+}
+
+static int
+sylvan_cache_node_alive(uint64_t index)
+{
+    return index < llmsset_get_size(nodes) && llmsset_is_marked(nodes, index);
+}
+
+VOID_TASK_2(sylvan_clear_cache_dead_par, size_t, first, size_t, count)
+{
+    if (count > 4096) {
+        size_t split = count/2;
+        SPAWN(sylvan_clear_cache_dead_par, first, split);
+        CALL(sylvan_clear_cache_dead_par, first + split, count - split);
+        SYNC(sylvan_clear_cache_dead_par);
+    } else {
+        cache_clear_dead(first, count, sylvan_cache_node_alive);
+    }
+}
+
+/**
+ * Remove cache entries that refer to unmarked nodes.
+ */
+VOID_TASK_IMPL_0(sylvan_clear_cache_dead)
+{
+    CALL(sylvan_clear_cache_dead_par, 0, cache_getsize());
+}
+
 /**
  * Clear the nodes table and mark all referenced nodes.
  *
@@ -119,9 +529,7 @@ VOID_TASK_IMPL_0(sylvan_clear_and_mark)
 {
     llmsset_clear_data(nodes);
 
-    for (gc_hook_entry_t e = mark_list; e != NULL; e = e->next) {
-        WRAP(e->cb);
-    }
+    CALL(sylvan_gc_mark_roots);
 
     llmsset_destroy_unmarked(nodes);
 }
@@ -213,38 +621,446 @@ VOID_TASK_IMPL_0(sylvan_gc_normal_resize)
     }
 }
 
+/**
+ * Measurements of garbage collection for the adaptive resizing heuristic
+ */
+static int gc_target_overhead = SYLVAN_GC_TARGET_OVERHEAD;
+static uint64_t gc_time_start;      // start of the current garbage collection (ns)
+static uint64_t gc_time_end;        // end of the previous garbage collection (ns), or 0
+static double gc_pause_per_bucket;  // average pause per bucket of the nodes table (ns)
+static size_t gc_used_start;        // used buckets at the start of the current garbage collection
+static size_t gc_live_end;          // live nodes after the previous garbage collection
+static size_t gc_min_nodes;         // the adaptive heuristic does not shrink below the initial sizes
+static size_t gc_min_cache;
+
+void
+sylvan_gc_set_target_overhead(int percentage)
+{
+    gc_target_overhead = percentage;
+}
+
+static uint64_t
+gc_abstime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Estimated percentage of the time spent in garbage collection with a nodes table of <size> buckets,
+ * when <live> nodes survive and the program creates <rate> nodes per ns.
+ */
+static double
+gc_overhead(size_t size, size_t live, double rate)
+{
+    if (size <= live) return 100.0;
+    if (rate <= 0) return 0.0;
+    double pause = gc_pause_per_bucket * size;
+    double interval = (size - live) / rate;
+    return 100.0 * pause / (pause + interval);
+}
+
+/**
+ * Resizing heuristic that sizes the nodes table for a target garbage collection overhead.
+ * It measures the pause of garbage collection (per bucket of the nodes table) and the rate
+ * at which nodes are created between garbage collections, and picks the smallest size with
+ * at most 50% live nodes and at most the target overhead (see sylvan_gc_set_target_overhead).
+ * When half the size would also meet half the target, the table is shrunk (not below the
+ * initial size, and only if no live node is in the upper half).
+ * The operation cache is grown and shrunk with the nodes table.
+ */
+VOID_TASK_IMPL_0(sylvan_gc_adaptive_resize)
+{
+    size_t nodes_size = llmsset_get_size(nodes);
+    size_t nodes_max = llmsset_get_max_size(nodes);
+    size_t live = llmsset_count_marked(nodes);
+
+    int grow = 0, shrink = 0;
+    if (gc_time_end == 0 || gc_pause_per_bucket == 0) {
+        // no measurements yet
+        if (live*2 > nodes_size && nodes_size < nodes_max) grow = 1;
+    } else {
+        // nodes created per ns since the previous garbage collection
+        size_t created = gc_used_start > gc_live_end ? gc_used_start - gc_live_end : 0;
+        double rate = (double)created / (double)(gc_time_start - gc_time_end + 1);
+
+        size_t new_size = nodes_size;
+        while (new_size < nodes_max && (live*2 > new_size || gc_overhead(new_size, live, rate) > gc_target_overhead)) {
+            new_size = next_size(new_size);
+            grow++;
+        }
+
+        size_t half = nodes_size/2;
+        if (grow == 0 && half >= gc_min_nodes && live*2 <= half &&
+                gc_overhead(half, live, rate)*2 <= gc_target_overhead && llmsset_marked_bound(nodes) <= half) {
+            shrink = 1;
+        }
+    }
+    gc_live_end = live;
+
+    if (grow) {
+        size_t new_size = nodes_size;
+        for (int i=0; i<grow; i++) new_size = next_size(new_size);
+        if (new_size > nodes_max) new_size = nodes_max;
+        llmsset_set_size(nodes, new_size);
+
+        size_t cache_size = cache_getsize();
+        size_t cache_max = cache_getmaxsize();
+        if (cache_size < cache_max) {
+            size_t new_cache = cache_size;
+            for (int i=0; i<grow; i++) new_cache = next_size(new_cache);
+            if (new_cache > cache_max) new_cache = cache_max;
+            cache_setsize(new_cache);
+        }
+    } else if (shrink) {
+        llmsset_set_size(nodes, nodes_size/2);
+
+        size_t cache_size = cache_getsize();
+        if (cache_size/2 >= gc_min_cache) cache_setsize(cache_size/2);
+    }
+}
+
+/**
+ * Compacting garbage collection
+ *
+ * After marking, the marked nodes move to the start of the nodes table, in their current order:
+ * the new index of a node is the number of marked buckets before it. The number of marked
+ * buckets before every region of 512 buckets is stored in gc_rank, so sylvan_gc_relocated
+ * only counts the marked buckets in the region of the node.
+ *
+ * With SYLVAN_COMPACT_DFS, the nodes are numbered in depth-first order instead, so the children
+ * of a node are usually close to the node. The marking queues are then processed as stacks and
+ * every worker numbers the nodes that it marks with sequence numbers from its own block of 512
+ * (stored in gc_forward). Afterwards, the gaps at the end of partially used blocks are removed:
+ * gc_block_offset stores the number of nodes in the blocks before every block.
+ *
+ * Nodes that are referenced by value (e.g. mtbdd_ref) are pinned while marking: they keep their
+ * index, and the other nodes skip the pinned positions. The pins are sorted and deduplicated
+ * before the nodes move, so the k-th unpinned node is found with a binary search.
+ */
+static int gc_compact_requested = 0;
+static int gc_compact_order = SYLVAN_COMPACT_DFS;
+static uint64_t *gc_rank;           // number of marked buckets before every region (during compaction)
+static uint64_t *gc_block_offset;   // number of nodes before every block of sequence numbers (depth-first order)
+static uint64_t *gc_pins_dense;     // the sorted gap-free sequence numbers of the pinned nodes (depth-first order)
+static uint64_t *gc_pins;           // nodes that keep their index (during compaction)
+static size_t gc_pins_count = 0;
+static size_t gc_pins_size = 0;
+static volatile int gc_pins_lock = 0;
+
+void
+sylvan_gc_pin(uint64_t index)
+{
+    if (gc_types == NULL || index < 2) return;
+    while (__sync_lock_test_and_set(&gc_pins_lock, 1)) {}
+    if (gc_pins_count == gc_pins_size) {
+        gc_pins_size = gc_pins_size == 0 ? 64 : gc_pins_size * 2;
+        gc_pins = (uint64_t*)realloc(gc_pins, sizeof(uint64_t) * gc_pins_size);
+        if (gc_pins == NULL) {
+            fprintf(stderr, "sylvan_gc_pin: Unable to allocate memory!\n");
+            exit(1);
+        }
+    }
+    gc_pins[gc_pins_count++] = index;
+    __sync_lock_release(&gc_pins_lock);
+}
+
+void
+sylvan_gc_set_compact_order(int order)
+{
+    gc_compact_order = order;
+}
+
+/**
+ * Returns the number of values in the sorted array <arr> that are smaller than <value>.
+ */
+static size_t
+gc_count_below(const uint64_t *arr, size_t count, uint64_t value)
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo+hi)/2;
+        if (arr[mid] < value) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Returns the sequence number of a node without the gaps of partially used blocks.
+ */
+static inline uint64_t
+gc_dense(uint64_t seq)
+{
+    return gc_block_offset[seq/512] + (seq&511);
+}
+
+uint64_t
+sylvan_gc_relocated(uint64_t index)
+{
+    if ((gc_rank == NULL && gc_block_offset == NULL) || index < 2 || index >= llmsset_get_size(nodes)) return index;
+    const uint64_t *words = nodes->bitmap2 + (index/512)*8;
+    const size_t word = (index/64)&7, bit = index&63;
+    if ((words[word] & (0x8000000000000000LL >> bit)) == 0) return index; // not marked
+
+    const size_t t = gc_count_below(gc_pins, gc_pins_count, index);
+    if (t < gc_pins_count && gc_pins[t] == index) return index; // pinned
+
+    // k is the position of the node among the unpinned nodes
+    uint64_t k;
+    if (gc_rank != NULL) {
+        uint64_t rank = gc_rank[index/512];
+        for (size_t i=0; i<word; i++) rank += __builtin_popcountll(words[i]);
+        if (bit != 0) rank += __builtin_popcountll(words[word] >> (64-bit));
+        k = rank - 2 - t;
+    } else {
+        const uint64_t d = gc_dense(gc_forward[index]);
+        k = d - gc_count_below(gc_pins_dense, gc_pins_count, d);
+    }
+
+    // skip the pinned positions: the k-th unpinned node goes to position 2+k+j, with j the
+    // number of pins at or before that position, i.e., the number of pins p_t with p_t-t-2 <= k
+    size_t lo = 0, hi = gc_pins_count;
+    while (lo < hi) {
+        size_t mid = (lo+hi)/2;
+        if (gc_pins[mid] - mid - 2 <= k) lo = mid+1;
+        else hi = mid;
+    }
+    return 2 + k + lo;
+}
+
+static int
+gc_compare_pins(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+VOID_TASK_2(sylvan_gc_rank_par, size_t, first, size_t, count)
+{
+    if (count > 64) {
+        SPAWN(sylvan_gc_rank_par, first, count/2);
+        CALL(sylvan_gc_rank_par, first+count/2, count-count/2);
+        SYNC(sylvan_gc_rank_par);
+        return;
+    }
+    // the number of marked buckets in every region (the prefix sums are computed afterwards)
+    for (size_t r=first; r<first+count; r++) {
+        const uint64_t *words = nodes->bitmap2 + r*8;
+        uint64_t n = 0;
+        for (int i=0; i<8; i++) n += __builtin_popcountll(words[i]);
+        gc_rank[r] = n;
+    }
+}
+
+VOID_TASK_2(sylvan_gc_relocate_par, size_t, first, size_t, count)
+{
+    if (count > 4096) {
+        SPAWN(sylvan_gc_relocate_par, first, count/2);
+        CALL(sylvan_gc_relocate_par, first+count/2, count-count/2);
+        SYNC(sylvan_gc_relocate_par);
+        return;
+    }
+    // update the children of the marked nodes (before they move)
+    for (size_t i=first; i<first+count; i++) {
+        const uint8_t type = gc_types[i];
+        if (type != 0) WRAP(relocate_types[type-1], i);
+    }
+}
+
+/**
+ * Move the marked nodes to the start of the nodes table (during garbage collection, after marking)
+ */
+VOID_TASK_0(sylvan_gc_compact_go)
+{
+    // sort and deduplicate the pinned nodes
+    if (gc_pins_count != 0) {
+        qsort(gc_pins, gc_pins_count, sizeof(uint64_t), gc_compare_pins);
+        size_t n = 1;
+        for (size_t i=1; i<gc_pins_count; i++) {
+            if (gc_pins[i] != gc_pins[n-1]) gc_pins[n++] = gc_pins[i];
+        }
+        gc_pins_count = n;
+    }
+
+    if (gc_forward == NULL) {
+        const size_t regions = (llmsset_get_size(nodes) + 511) / 512;
+        gc_rank = (uint64_t*)malloc(sizeof(uint64_t) * regions);
+        if (gc_rank == NULL) {
+            fprintf(stderr, "sylvan_gc_compact: Unable to allocate memory!\n");
+            exit(1);
+        }
+        CALL(sylvan_gc_rank_par, 0, regions);
+        uint64_t sum = 0;
+        for (size_t r=0; r<regions; r++) {
+            uint64_t n = gc_rank[r];
+            gc_rank[r] = sum;
+            sum += n;
+        }
+    } else {
+        // all blocks are full, except the last block of every worker
+        const size_t blocks = gc_seq_blocks;
+        gc_block_offset = (uint64_t*)malloc(sizeof(uint64_t) * (blocks+1));
+        gc_pins_dense = (uint64_t*)malloc(sizeof(uint64_t) * (gc_pins_count+1));
+        if (gc_block_offset == NULL || gc_pins_dense == NULL) {
+            fprintf(stderr, "sylvan_gc_compact: Unable to allocate memory!\n");
+            exit(1);
+        }
+        for (size_t b=0; b<blocks; b++) gc_block_offset[b] = 512;
+        for (unsigned int i=0; i<lace_workers(); i++) {
+            gc_worker_t w = gc_workers + i;
+            if (w->seq_end != 0) gc_block_offset[w->seq_end/512-1] = w->seq_next - (w->seq_end-512);
+            w->seq_next = w->seq_end = 0;
+        }
+        gc_seq_blocks = 0;
+        uint64_t sum = 0;
+        for (size_t b=0; b<blocks; b++) {
+            uint64_t n = gc_block_offset[b];
+            gc_block_offset[b] = sum;
+            sum += n;
+        }
+        for (size_t t=0; t<gc_pins_count; t++) gc_pins_dense[t] = gc_dense(gc_forward[gc_pins[t]]);
+        qsort(gc_pins_dense, gc_pins_count, sizeof(uint64_t), gc_compare_pins);
+    }
+
+    // update the children of all nodes and the external references, then move the nodes
+    CALL(sylvan_gc_relocate_par, 0, llmsset_get_size(nodes));
+    for (gc_hook_entry_t e = relocate_list; e != NULL; e = e->next) {
+        WRAP(e->cb);
+    }
+    llmsset_relocate(nodes, sylvan_gc_relocated);
+
+    free(gc_rank);
+    gc_rank = NULL;
+    free(gc_block_offset);
+    gc_block_offset = NULL;
+    free(gc_pins_dense);
+    gc_pins_dense = NULL;
+    free(gc_pins);
+    gc_pins = NULL;
+    gc_pins_count = gc_pins_size = 0;
+
+    // the operation cache refers to the old indices
+    cache_clear();
+}
+
+/**
+ * Shrink the nodes table and the operation cache after compaction, such that at most
+ * half the nodes table is used, but not below their initial sizes or the pinned nodes.
+ */
+VOID_TASK_0(sylvan_gc_compact_shrink)
+{
+    size_t nodes_size = llmsset_get_size(nodes);
+    size_t live = llmsset_count_marked(nodes);
+    size_t bound = llmsset_marked_bound(nodes);
+    size_t cache_size = cache_getsize();
+    while (nodes_size/2 >= gc_min_nodes && live*2 <= nodes_size/2 && bound <= nodes_size/2) {
+        nodes_size /= 2;
+        if (cache_size/2 >= gc_min_cache) cache_size /= 2;
+    }
+    if (nodes_size != llmsset_get_size(nodes)) llmsset_set_size(nodes, nodes_size);
+    if (cache_size != cache_getsize()) cache_setsize(cache_size);
+}
+
+VOID_TASK_IMPL_0(sylvan_gc_compact)
+{
+    // all node types must support relocation
+    for (int i=0; i<grey_types_count; i++) {
+        if (relocate_types[i] == NULL) {
+            CALL(sylvan_gc);
+            return;
+        }
+    }
+    gc_compact_requested = 1;
+    CALL(sylvan_gc);
+    gc_compact_requested = 0;
+}
+
 /**
  * Actual implementation of garbage collection
  */
-VOID_TASK_0(sylvan_gc_go)
+VOID_TASK_IMPL_0(sylvan_gc_go)
 {
     sylvan_stats_count(SYLVAN_GC_COUNT);
     sylvan_timer_start(SYLVAN_GC);
 
+    gc_time_start = gc_abstime();
+    if (main_hook == TASK(sylvan_gc_adaptive_resize)) gc_used_start = llmsset_count_marked(nodes);
+
     // call pre gc hooks
     for (gc_hook_entry_t e = pregc_list; e != NULL; e = e->next) {
         WRAP(e->cb);
     }
 
     /*
-     * This simply clears the cache.
-     * Alternatively, we could implement for example some strategy
-     * where part of the cache is cleared and part is marked
+     * This simply clears the cache, unless entries with surviving nodes are preserved;
+     * then only the dead entries are removed after marking.
      */
-    CALL(sylvan_clear_cache);
+    if (!gc_preserve_cache) CALL(sylvan_clear_cache);
+
+    const int compact = gc_compact_requested;
+    if (compact) {
+        // the type of every node is recorded when it is marked, so mark everything again
+        if (sylvan_gc_marking) CALL(sylvan_gc_marking_finish);
+        gc_types = (uint8_t*)sylvan_mem_alloc(llmsset_get_size(nodes));
+        if (gc_types == (uint8_t*)-1) {
+            fprintf(stderr, "sylvan_gc_compact: Unable to allocate memory!\n");
+            exit(1);
+        }
+        if (gc_compact_order == SYLVAN_COMPACT_DFS) {
+            gc_forward = (uint64_t*)sylvan_mem_alloc(llmsset_get_size(nodes) * sizeof(uint64_t));
+            if (gc_forward == (uint64_t*)-1) {
+                fprintf(stderr, "sylvan_gc_compact: Unable to allocate memory!\n");
+                exit(1);
+            }
+        }
+        CALL(sylvan_clear_and_mark);
+        CALL(sylvan_gc_compact_go);
+        if (gc_forward != NULL) {
+            sylvan_mem_free(gc_forward, llmsset_get_size(nodes) * sizeof(uint64_t));
+            gc_forward = NULL;
+        }
+        sylvan_mem_free(gc_types, llmsset_get_size(nodes));
+        gc_types = NULL;
+    } else if (sylvan_gc_marking) {
+        CALL(sylvan_gc_marking_finish);
+        // if too many nodes died during incremental marking, mark everything again
+        if (llmsset_count_marked(nodes) * 100 >= llmsset_get_size(nodes) * SYLVAN_GC_INCREMENTAL_START) {
+            CALL(sylvan_clear_and_mark);
+        } else {
+            llmsset_destroy_unmarked(nodes);
+        }
+    } else {
+        CALL(sylvan_clear_and_mark);
+    }
 
-    CALL(sylvan_clear_and_mark);
+    if (gc_preserve_cache && !compact) CALL(sylvan_clear_cache_dead);
 
     // call hooks for resizing and all that
     WRAP(main_hook);
 
+    if (compact) CALL(sylvan_gc_compact_shrink);
+
     CALL(sylvan_rehash_all);
 
+    if (sylvan_gc_incremental) {
+        // reference point for starting the next incremental marking
+        gc_live = llmsset_count_marked(nodes);
+        gc_created = 0;
+    }
+
     // call post gc hooks
     for (gc_hook_entry_t e = postgc_list; e != NULL; e = e->next) {
         WRAP(e->cb);
     }
 
+    // measure the pause for the adaptive resizing heuristic
+    gc_time_end = gc_abstime();
+    double pause_per_bucket = (double)(gc_time_end - gc_time_start) / llmsset_get_size(nodes);
+    if (gc_pause_per_bucket == 0) gc_pause_per_bucket = pause_per_bucket;
+    else gc_pause_per_bucket = (gc_pause_per_bucket + pause_per_bucket) / 2;
+
     sylvan_timer_stop(SYLVAN_GC);
 }
 
@@ -258,9 +1074,10 @@ VOID_TASK_IMPL_0(sylvan_gc)
             NEWFRAME(sylvan_gc_go);
             gc = 0;
         } else {
-            /* wait for new frame to appear */
-            while (*(Task* volatile*)&(lace_newframe.t) == 0) {}
-            lace_yield(__lace_worker, __lace_dq_head);
+            /* wait for the garbage collection to finish (another frame may come first) */
+            while (gc) {
+                if (*(Task* volatile*)&(lace_newframe.t) != 0) lace_yield(__lace_worker, __lace_dq_head);
+            }
         }
     }
 }
@@ -281,8 +1098,8 @@ sylvan_init_package(size_t tablesize, size_t maxsize, size_t cachesize, size_t m
     if (tablesize > maxsize) tablesize = maxsize;
     if (cachesize > max_cachesize) cachesize = max_cachesize;
 
-    if (maxsize > 0x000003ffffffffff) {
-        fprintf(stderr, "sylvan_init_package error: tablesize must be <= 42 bits!\n");
+    if (maxsize > SYLVAN_INDEX_MASK + 1) {
+        fprintf(stderr, "sylvan_init_package error: tablesize must be <= %d bits!\n", SYLVAN_INDEX_BITS);
         exit(1);
     }
 
@@ -292,6 +1109,27 @@ sylvan_init_package(size_t tablesize, size_t maxsize, size_t cachesize, size_t m
 
     /* Initialize garbage collection */
     gc = 0;
+    sylvan_gc_marking = 0;
+    gc_marking_pending = 0;
+    gc_live = 0;
+    gc_created = 0;
+    gc_time_end = 0;
+    gc_pause_per_bucket = 0;
+    gc_live_end = 0;
+    gc_min_nodes = tablesize;
+    gc_min_cache = cachesize;
+    if (posix_memalign((void**)&gc_workers, LINE_SIZE, sizeof(struct gc_worker) * lace_workers()) != 0) {
+        fprintf(stderr, "sylvan_init_package: Unable to allocate memory!\n");
+        exit(1);
+    }
+    memset(gc_workers, 0, sizeof(struct gc_worker) * lace_workers());
+    for (unsigned int i=0; i<lace_workers(); i++) {
+        gc_workers[i].mark_queue = (uint64_t*)malloc(sizeof(uint64_t) * MARK_QUEUE_SIZE);
+        if (gc_workers[i].mark_queue == NULL) {
+            fprintf(stderr, "sylvan_init_package: Unable to allocate memory!\n");
+            exit(1);
+        }
+    }
 #if SYLVAN_AGGRESSIVE_RESIZE
     main_hook = TASK(sylvan_gc_aggressive_resize);
 #else
@@ -347,8 +1185,188 @@ sylvan_quit()
         free(e);
     }
 
+    while (relocate_list != NULL) {
+        gc_hook_entry_t e = relocate_list;
+        relocate_list = e->next;
+        free(e);
+    }
+
+    for (unsigned int i=0; i<lace_workers(); i++) {
+        if (gc_workers[i].grey != NULL) free(gc_workers[i].grey);
+        free(gc_workers[i].mark_queue);
+    }
+    free(gc_workers);
+    while (grey_pool != NULL) {
+        gc_grey_chunk_t c = grey_pool;
+        grey_pool = c->next;
+        free(c);
+    }
+    free(grey_types);
+    free(relocate_types);
+    grey_types = NULL;
+    relocate_types = NULL;
+    grey_types_count = 0;
+
     cache_free();
+    cache_stats_free();
     llmsset_free(nodes);
+    nodes = NULL;
+}
+
+/**
+ * Contexts
+ */
+struct sylvan_context
+{
+    llmsset_t nodes;
+    void *cache;
+    void *stats;
+    void *mtbdd;
+    void *lddmc;
+    void *serialize;
+    void *level_index;
+    void *reorder;
+    struct reg_quit_entry *quit_register;
+    gc_hook_entry_t mark_list;
+    gc_hook_entry_t pregc_list;
+    gc_hook_entry_t postgc_list;
+    gc_hook_entry_t relocate_list;
+    gc_hook_cb main_hook;
+    gc_worker_t gc_workers;
+    gc_grey_cb *grey_types;
+    gc_grey_cb *relocate_types;
+    int grey_types_count;
+    int gc_enabled;
+    int gc_incremental;
+    int gc_preserve_cache;
+    int gc_target_overhead;
+    int gc_compact_requested;
+    int gc_compact_order;
+    size_t gc_live;
+    size_t gc_created;
+    uint64_t gc_time_end;
+    double gc_pause_per_bucket;
+    size_t gc_live_end;
+    size_t gc_min_nodes;
+    size_t gc_min_cache;
+};
+
+sylvan_context_t
+sylvan_context_detach()
+{
+    if (nodes == NULL) {
+        fprintf(stderr, "sylvan_context_detach: Sylvan is not initialized!\n");
+        exit(1);
+    }
+
+    LACE_ME;
+    if (sylvan_gc_marking != 0) {
+        // the grey nodes of incremental marking are in the shared pool; finish the garbage collection
+        CALL(sylvan_gc);
+        if (sylvan_gc_marking != 0) {
+            fprintf(stderr, "sylvan_context_detach: incremental marking in progress while garbage collection is disabled!\n");
+            exit(1);
+        }
+    }
+
+    sylvan_context_t c = (sylvan_context_t)malloc(sizeof(struct sylvan_context));
+    c->nodes = nodes;
+    c->cache = cache_context_detach();
+    c->stats = sylvan_stats_context_detach();
+    c->mtbdd = mtbdd_context_detach();
+    c->lddmc = lddmc_context_detach();
+    c->serialize = sylvan_serialize_context_detach();
+    c->level_index = sylvan_level_index_context_detach();
+    c->reorder = sylvan_reorder_context_detach();
+    c->quit_register = quit_register;
+    c->mark_list = mark_list;
+    c->pregc_list = pregc_list;
+    c->postgc_list = postgc_list;
+    c->relocate_list = relocate_list;
+    c->main_hook = main_hook;
+    c->gc_workers = gc_workers;
+    c->grey_types = grey_types;
+    c->relocate_types = relocate_types;
+    c->grey_types_count = grey_types_count;
+    c->gc_enabled = gc_enabled;
+    c->gc_incremental = sylvan_gc_incremental;
+    c->gc_preserve_cache = gc_preserve_cache;
+    c->gc_target_overhead = gc_target_overhead;
+    c->gc_compact_requested = gc_compact_requested;
+    c->gc_compact_order = gc_compact_order;
+    c->gc_live = gc_live;
+    c->gc_created = gc_created;
+    c->gc_time_end = gc_time_end;
+    c->gc_pause_per_bucket = gc_pause_per_bucket;
+    c->gc_live_end = gc_live_end;
+    c->gc_min_nodes = gc_min_nodes;
+    c->gc_min_cache = gc_min_cache;
+
+    // as before sylvan_init_package
+    nodes = NULL;
+    quit_register = NULL;
+    mark_list = pregc_list = postgc_list = relocate_list = NULL;
+    main_hook = NULL;
+    gc_workers = NULL;
+    grey_types = relocate_types = NULL;
+    grey_types_count = 0;
+    gc_enabled = 1;
+    sylvan_gc_incremental = 0;
+    gc_preserve_cache = 0;
+    gc_target_overhead = SYLVAN_GC_TARGET_OVERHEAD;
+    gc_compact_requested = 0;
+    gc_compact_order = SYLVAN_COMPACT_DFS;
+    return c;
+}
+
+void
+sylvan_context_attach(sylvan_context_t c)
+{
+    if (nodes != NULL) {
+        fprintf(stderr, "sylvan_context_attach: detach the current context first!\n");
+        exit(1);
+    }
+
+    nodes = c->nodes;
+    cache_context_attach(c->cache);
+    sylvan_stats_context_attach(c->stats);
+    mtbdd_context_attach(c->mtbdd);
+    lddmc_context_attach(c->lddmc);
+    sylvan_serialize_context_attach(c->serialize);
+    sylvan_level_index_context_attach(c->level_index);
+    sylvan_reorder_context_attach(c->reorder);
+    quit_register = c->quit_register;
+    mark_list = c->mark_list;
+    pregc_list = c->pregc_list;
+    postgc_list = c->postgc_list;
+    relocate_list = c->relocate_list;
+    main_hook = c->main_hook;
+    gc_workers = c->gc_workers;
+    grey_types = c->grey_types;
+    relocate_types = c->relocate_types;
+    grey_types_count = c->grey_types_count;
+    gc_enabled = c->gc_enabled;
+    sylvan_gc_incremental = c->gc_incremental;
+    gc_preserve_cache = c->gc_preserve_cache;
+    gc_target_overhead = c->gc_target_overhead;
+    gc_compact_requested = c->gc_compact_requested;
+    gc_compact_order = c->gc_compact_order;
+    gc_live = c->gc_live;
+    gc_created = c->gc_created;
+    gc_time_end = c->gc_time_end;
+    gc_pause_per_bucket = c->gc_pause_per_bucket;
+    gc_live_end = c->gc_live_end;
+    gc_min_nodes = c->gc_min_nodes;
+    gc_min_cache = c->gc_min_cache;
+    free(c);
+}
+
+sylvan_context_t
+sylvan_context_switch(sylvan_context_t c)
+{
+    sylvan_context_t current = sylvan_context_detach();
+    sylvan_context_attach(c);
+    return current;
 }
 
 /**
@@ -36,9 +36,11 @@ extern "C" {
  * 
  * Memory usage:
  * Every node requires 24 bytes memory. (16 bytes data + 8 bytes overhead)
+ * With SYLVAN_COMPACT_NODES, every node requires 20 bytes memory. (12 bytes data + 8 bytes overhead)
  * Every operation cache entry requires 36 bytes memory. (32 bytes data + 4 bytes overhead)
+ * Every 8 (CACHE_WIDE_RATIO) cache entries have one wide entry of 64 bytes, so 44 bytes per entry in total.
  *
- * Reasonable defaults: datasize of 1L<<26 (2048 MB), cachesize of 1L<<25 (1152 MB)
+ * Reasonable defaults: datasize of 1L<<26 (2048 MB), cachesize of 1L<<25 (1408 MB)
  */
 void sylvan_init_package(size_t initial_tablesize, size_t max_tablesize, size_t initial_cachesize, size_t max_cachesize);
 
@@ -53,12 +55,57 @@ void sylvan_quit(void);
 typedef void (*quit_cb)(void);
 void sylvan_register_quit(quit_cb cb);
 
+/**
+ * Contexts: independent instances of Sylvan in one process.
+ *
+ * A context has its own nodes table, operation cache, references, garbage collection hooks,
+ * variable order and statistics. Decision diagrams of one context are meaningless in another.
+ *
+ * sylvan_context_detach moves the current instance into a context and leaves Sylvan as before
+ * sylvan_init_package, without freeing anything. Call sylvan_init_package (and sylvan_init_mtbdd,
+ * sylvan_init_ldd, ...) to start another instance. sylvan_context_attach makes a detached context
+ * the current instance again, after the current instance is detached (or freed with sylvan_quit).
+ * sylvan_context_switch detaches the current instance, attaches <context> and returns the detached one.
+ * To free a detached context, attach it and call sylvan_quit.
+ *
+ * All contexts share the Lace workers: only the current context runs operations, and contexts are
+ * switched between operations, not from inside a Lace task. Garbage collection of one context does
+ * not touch the nodes and operation cache of another context.
+ * Operation identifiers (cache_next_opid), cache layouts and the memory policy are shared.
+ * Register custom leaf types in the same order in every context, as modules such as
+ * sylvan_gmp store their type in a global variable.
+ */
+typedef struct sylvan_context *sylvan_context_t;
+sylvan_context_t sylvan_context_detach(void);
+void sylvan_context_attach(sylvan_context_t context);
+sylvan_context_t sylvan_context_switch(sylvan_context_t context);
+
 /**
  * Return number of occupied buckets in nodes table and total number of buckets.
  */
 VOID_TASK_DECL_2(sylvan_table_usage, size_t*, size_t*);
 #define sylvan_table_usage(filled, total) (CALL(sylvan_table_usage, filled, total))
 
+/**
+ * Enable or disable online resizing of the nodes table (disabled by default).
+ *
+ * When enabled, the nodes table is doubled (until the maximum size) when no new nodes can be
+ * added, instead of triggering garbage collection. The hash array is then migrated incrementally
+ * by all workers while they keep adding nodes, without interrupting ongoing work.
+ * Garbage collection is only triggered when the table is full at its maximum size.
+ */
+void sylvan_set_online_resize(int enabled);
+
+/**
+ * Enable or disable overflow probing in the nodes table (disabled by default).
+ *
+ * When enabled, a new node that finds no empty bucket on the cache lines of its probe sequence
+ * also tries the next LLMSSET_OVERFLOW_LINES consecutive cache lines. The nodes table then
+ * reaches a higher load (about 97% instead of 90%) before garbage collection or online resizing
+ * is triggered, while lookups in a table that is not almost full are not affected.
+ */
+void sylvan_set_overflow_probe(int enabled);
+
 /**
  * GARBAGE COLLECTION
  *
@@ -87,8 +134,18 @@ VOID_TASK_DECL_2(sylvan_table_usage, size_t*, size_t*);
  *
  * For parts of the garbage collection process, specific methods exist.
  * - sylvan_clear_cache() clears the operation cache (step 2)
+ * - sylvan_clear_cache_dead() only removes cache entries that refer to dead nodes (after step 4)
  * - sylvan_clear_and_mark() performs steps 3 and 4.
  * - sylvan_rehash_all() performs steps 5 and 6.
+ *
+ * With incremental garbage collection (see sylvan_gc_set_incremental), most of the marking
+ * (step 4) is done while workers continue their work. When the nodes table is filled for
+ * SYLVAN_GC_INCREMENTAL_START percent, a short pause marks the roots "grey", i.e., marked but
+ * their children not yet. Grey nodes are then processed a few at a time by every worker that
+ * creates nodes. When no new nodes can be added, the garbage collection procedure above only
+ * finishes the marking: remaining grey nodes are processed and the roots are marked again,
+ * which stops at nodes that are already marked. Nodes that became unreachable during marking
+ * survive until the next garbage collection; if these fill the table, all nodes are marked again.
  */
 
 /**
@@ -101,6 +158,34 @@ VOID_TASK_DECL_2(sylvan_table_usage, size_t*, size_t*);
 VOID_TASK_DECL_0(sylvan_gc);
 #define sylvan_gc() (CALL(sylvan_gc))
 
+/**
+ * Compacting garbage collection: perform garbage collection, move all live nodes to the start
+ * of the nodes table, and shrink the nodes table and the operation cache (not below their
+ * initial sizes) such that at most half the table is used. The memory of the unused part is
+ * returned to the operating system.
+ *
+ * Nodes get a new index, so all nodes used later must be referenced, and this must not be
+ * called during an operation, since running operations keep nodes in local variables.
+ * Variables protected with mtbdd_protect are updated. Nodes referenced by value (mtbdd_ref,
+ * lddmc_ref, the refs stacks) keep their index, so they may prevent some shrinking.
+ * Node indices stored by other code must be updated by a callback added with
+ * sylvan_gc_add_relocate, using sylvan_gc_relocated, or pinned with sylvan_gc_pin.
+ * If a node type does not support relocation, this is the same as sylvan_gc().
+ */
+VOID_TASK_DECL_0(sylvan_gc_compact);
+#define sylvan_gc_compact() (CALL(sylvan_gc_compact))
+
+/**
+ * Set the order of the nodes after compacting garbage collection:
+ * - SYLVAN_COMPACT_DFS (default): number the nodes in depth-first order from the roots, so the
+ *   children of a node are usually close to the node, which improves the locality of traversals.
+ *   This uses 8 bytes of temporary memory per bucket during compaction.
+ * - SYLVAN_COMPACT_INDEX: keep the current order of the nodes.
+ */
+#define SYLVAN_COMPACT_INDEX        0
+#define SYLVAN_COMPACT_DFS          1
+void sylvan_gc_set_compact_order(int order);
+
 /**
  * Enable or disable garbage collection.
  *
@@ -111,6 +196,20 @@ VOID_TASK_DECL_0(sylvan_gc);
 void sylvan_gc_enable(void);
 void sylvan_gc_disable(void);
 
+/**
+ * Enable or disable incremental garbage collection (disabled by default).
+ * Nodes that die during incremental marking are only reclaimed by the next garbage collection.
+ */
+void sylvan_gc_set_incremental(int enabled);
+
+/**
+ * Enable or disable preserving the operation cache during garbage collection (disabled by default).
+ * If enabled, the cache is not cleared, but after marking, only entries that refer to dead nodes
+ * are removed, and entries of operations without a layout (see cache_set_layout).
+ * Resizing the operation cache still clears it.
+ */
+void sylvan_gc_set_preserve_cache(int enabled);
+
 /**
  * Test if garbage collection must happen now.
  * This is just a call to the Lace framework to see if NEWFRAME has been used.
@@ -124,6 +223,13 @@ void sylvan_gc_disable(void);
 VOID_TASK_DECL_0(sylvan_clear_cache);
 #define sylvan_clear_cache() CALL(sylvan_clear_cache)
 
+/**
+ * Remove all entries from the operation cache that refer to unmarked nodes.
+ * Only call this during garbage collection, after marking.
+ */
+VOID_TASK_DECL_0(sylvan_clear_cache_dead);
+#define sylvan_clear_cache_dead() CALL(sylvan_clear_cache_dead)
+
 /**
  * Clear the nodes table (data part) and mark all nodes with the marking mechanisms.
  */
@@ -169,6 +275,57 @@ void sylvan_gc_hook_main(gc_hook_cb callback);
  */
 void sylvan_gc_add_mark(gc_hook_cb mark_cb);
 
+/**
+ * Add a relocation mechanism (for compacting garbage collection, see sylvan_gc_compact).
+ *
+ * The relocate_cb callback is called after marking, before the nodes move, and should replace
+ * every stored node index by its new index, i.e., sylvan_gc_relocated(index).
+ * For indices of nodes that are not marked, sylvan_gc_relocated returns the index itself.
+ */
+void sylvan_gc_add_relocate(gc_hook_cb relocate_cb);
+uint64_t sylvan_gc_relocated(uint64_t index);
+
+/**
+ * Keep the index of a node during compacting garbage collection.
+ * Call this in a marking callback (see sylvan_gc_add_mark) for node indices that cannot be updated,
+ * e.g. references by value. Outside compacting garbage collection, this does nothing.
+ */
+void sylvan_gc_pin(uint64_t index);
+
+/**
+ * Support for incremental marking, for the implementations of decision diagram nodes.
+ *
+ * Every node type registers a gc_grey_cb callback, which marks the children of a grey node
+ * with the normal marking function (e.g. mtbdd_gc_mark_rec), and obtains a type number.
+ * The marking function must check sylvan_gc_marking: if it is 1 (incremental marking), then
+ * a newly marked node is pushed with sylvan_gc_push_grey instead of marking its children.
+ * Functions that return nodes (e.g. mtbdd_makenode) call sylvan_gc_incremental_step, which
+ * starts incremental marking when needed, and otherwise processes a few grey nodes.
+ */
+LACE_TYPEDEF_CB(void, gc_grey_cb, uint64_t);
+int sylvan_gc_register_grey(gc_grey_cb cb);
+void sylvan_gc_push_grey(int type, uint64_t index);
+
+/**
+ * For compacting garbage collection, every node type also registers a gc_grey_cb callback that
+ * replaces the children of a node by their new index (sylvan_gc_relocated).
+ */
+void sylvan_gc_register_relocate(int type, gc_grey_cb cb);
+void sylvan_gc_step(int created);
+
+extern int sylvan_gc_incremental; // incremental garbage collection is enabled
+extern volatile int sylvan_gc_marking; // 0: not marking, 1: incremental marking, 2: finishing marking
+
+#define sylvan_gc_incremental_step(created) { if (sylvan_gc_incremental) sylvan_gc_step(created); }
+
+/**
+ * Batched marking: when not marking incrementally, the marking function pushes nodes with
+ * sylvan_gc_mark_push instead of marking them recursively. The nodes are marked later by the
+ * workers, which call the gc_grey_cb callback of every node that they mark.
+ * Nodes are queued per worker and prefetched; workers without nodes take chunks from other workers.
+ */
+void sylvan_gc_mark_push(int type, uint64_t index);
+
 /**
  * One of the hooks for resizing behavior.
  * Default if SYLVAN_AGGRESSIVE_RESIZE is set.
@@ -185,6 +342,16 @@ VOID_TASK_DECL_0(sylvan_gc_aggressive_resize);
  */
 VOID_TASK_DECL_0(sylvan_gc_normal_resize);
 
+/**
+ * One of the hooks for resizing behavior.
+ * Grows or shrinks the nodes table and the operation cache, using the measured garbage collection
+ * pause and node creation rate, such that garbage collection takes about the target percentage
+ * of the time (default SYLVAN_GC_TARGET_OVERHEAD) while at most 50% of the table is live.
+ * Use sylvan_gc_hook_main() to set this heuristic, and sylvan_gc_set_target_overhead() to set the target.
+ */
+VOID_TASK_DECL_0(sylvan_gc_adaptive_resize);
+void sylvan_gc_set_target_overhead(int percentage);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -3,11 +3,59 @@
 #define CACHE_MASK 1
 #endif
 
+/* Operation cache: number of entries per bucket (1, 2, 4 or 8) */
+#ifndef CACHE_WAYS
+#define CACHE_WAYS 4
+#endif
+
+/* Operation cache: the cache of wide entries (more than 3 parameters) has 1/CACHE_WIDE_RATIO as many entries */
+#ifndef CACHE_WIDE_RATIO
+#define CACHE_WIDE_RATIO 8
+#endif
+
+/* Operation cache: record statistics of one in CACHE_STATS_SAMPLE events (power of 2, 0 to disable) */
+#ifndef CACHE_STATS_SAMPLE
+#define CACHE_STATS_SAMPLE 64
+#endif
+
 /* Nodes table: use bitmasks for module (size must be power of 2!) */
 #ifndef LLMSSET_MASK
 #define LLMSSET_MASK 1
 #endif
 
+/* Nodes table: number of consecutive cache lines probed after the rehashed cache lines (with overflow probing) */
+#ifndef LLMSSET_OVERFLOW_LINES
+#define LLMSSET_OVERFLOW_LINES 64
+#endif
+
+/* Nodes table: hash keys with AVX2/AVX-512 when the CPU supports it (x86-64 only, detected at runtime) */
+#ifndef LLMSSET_HASH_SIMD
+#define LLMSSET_HASH_SIMD 1
+#endif
+
+/* Nodes table: use 48-bit node indices instead of 40-bit node indices, for more than 2^40 nodes */
+#ifndef SYLVAN_WIDE_INDEX
+#define SYLVAN_WIDE_INDEX 0
+#endif
+
+/* Nodes table: use 12-byte nodes instead of 16-byte nodes, with 32-bit node indices (at most 2^32 nodes) */
+#ifndef SYLVAN_COMPACT_NODES
+#define SYLVAN_COMPACT_NODES 0
+#endif
+
+#if SYLVAN_WIDE_INDEX && SYLVAN_COMPACT_NODES
+#error "SYLVAN_WIDE_INDEX and SYLVAN_COMPACT_NODES cannot be combined"
+#endif
+
+#if SYLVAN_WIDE_INDEX
+#define SYLVAN_INDEX_BITS 48
+#elif SYLVAN_COMPACT_NODES
+#define SYLVAN_INDEX_BITS 32
+#else
+#define SYLVAN_INDEX_BITS 40
+#endif
+#define SYLVAN_INDEX_MASK ((((uint64_t)1) << SYLVAN_INDEX_BITS) - 1)
+
 /**
  * Use Fibonacci sequence as resizing strategy.
  * This MAY result in more conservative memory consumption, but is not
@@ -24,6 +72,26 @@
 #define SYLVAN_STATS 0
 #endif
 
+/* Incremental garbage collection: start marking when this percentage of the nodes table is used */
+#ifndef SYLVAN_GC_INCREMENTAL_START
+#define SYLVAN_GC_INCREMENTAL_START 70
+#endif
+
+/* Incremental garbage collection: number of grey nodes processed for every created node */
+#ifndef SYLVAN_GC_INCREMENTAL_STEP
+#define SYLVAN_GC_INCREMENTAL_STEP 8
+#endif
+
+/* Variable reordering: stop moving a variable when the number of nodes exceeds this percentage of the best size */
+#ifndef SYLVAN_REORDER_MAXGROWTH
+#define SYLVAN_REORDER_MAXGROWTH 120
+#endif
+
+/* Adaptive resizing strategy: target percentage of the time spent in garbage collection */
+#ifndef SYLVAN_GC_TARGET_OVERHEAD
+#define SYLVAN_GC_TARGET_OVERHEAD 5
+#endif
+
 /* Aggressive or conservative resizing strategy */
 #ifndef SYLVAN_AGGRESSIVE_RESIZE
 #define SYLVAN_AGGRESSIVE_RESIZE 1
@@ -37,58 +37,96 @@ extern "C" {
  */
 extern llmsset_t nodes;
 
+/**
+ * Garbage collection, for stop-the-world procedures that run it in their own frame (e.g. reordering).
+ * Unlike sylvan_gc, this does not check if garbage collection is enabled.
+ */
+VOID_TASK_DECL_0(sylvan_gc_go);
+int sylvan_gc_is_enabled(void);
+
+/**
+ * Reordering collects the referenced MTBDDs while marking (see mtbdd_gc_mark_rec).
+ */
+extern int sylvan_reorder_collecting;
+void sylvan_reorder_add_root(uint64_t dd);
+
+/**
+ * Per-level node index (see sylvan_levels.h).
+ * Functions that create MTBDD nodes call sylvan_level_index_created for every new internal node.
+ */
+extern int sylvan_level_index_enabled;
+void sylvan_level_index_add(uint32_t level, uint64_t index);
+void sylvan_level_index_reset(void);
+
+#define sylvan_level_index_created(level, index) { if (sylvan_level_index_enabled) sylvan_level_index_add(level, index); }
+
+/**
+ * Contexts (see sylvan_context_detach).
+ * Every module moves its state to a snapshot and resets it as after sylvan_quit, or restores a snapshot.
+ */
+void *mtbdd_context_detach(void);
+void mtbdd_context_attach(void *context);
+void *lddmc_context_detach(void);
+void lddmc_context_attach(void *context);
+void *sylvan_serialize_context_detach(void);
+void sylvan_serialize_context_attach(void *context);
+void *sylvan_level_index_context_detach(void);
+void sylvan_level_index_context_attach(void *context);
+void *sylvan_reorder_context_detach(void);
+void sylvan_reorder_context_attach(void *context);
+
 /**
  * Macros for all operation identifiers for the operation cache
  */
 
 // BDD operations
-#define CACHE_BDD_ITE                   (0LL<<40)
-#define CACHE_BDD_AND                   (1LL<<40)
-#define CACHE_BDD_XOR                   (2LL<<40)
-#define CACHE_BDD_EXISTS                (3LL<<40)
-#define CACHE_BDD_AND_EXISTS            (4LL<<40)
-#define CACHE_BDD_RELNEXT               (5LL<<40)
-#define CACHE_BDD_RELPREV               (6LL<<40)
-#define CACHE_BDD_SATCOUNT              (7LL<<40)
-#define CACHE_BDD_COMPOSE               (8LL<<40)
-#define CACHE_BDD_RESTRICT              (9LL<<40)
-#define CACHE_BDD_CONSTRAIN             (10LL<<40)
-#define CACHE_BDD_CLOSURE               (11LL<<40)
-#define CACHE_BDD_ISBDD                 (12LL<<40)
-#define CACHE_BDD_SUPPORT               (13LL<<40)
-#define CACHE_BDD_PATHCOUNT             (14LL<<40)
+#define CACHE_BDD_ITE                   (0LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_AND                   (1LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_XOR                   (2LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_EXISTS                (3LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_AND_EXISTS            (4LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_RELNEXT               (5LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_RELPREV               (6LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_SATCOUNT              (7LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_COMPOSE               (8LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_RESTRICT              (9LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_CONSTRAIN             (10LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_CLOSURE               (11LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_ISBDD                 (12LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_SUPPORT               (13LL<<SYLVAN_INDEX_BITS)
+#define CACHE_BDD_PATHCOUNT             (14LL<<SYLVAN_INDEX_BITS)
 
 // MDD operations
-#define CACHE_MDD_RELPROD               (20LL<<40)
-#define CACHE_MDD_MINUS                 (21LL<<40)
-#define CACHE_MDD_UNION                 (22LL<<40)
-#define CACHE_MDD_INTERSECT             (23LL<<40)
-#define CACHE_MDD_PROJECT               (24LL<<40)
-#define CACHE_MDD_JOIN                  (25LL<<40)
-#define CACHE_MDD_MATCH                 (26LL<<40)
-#define CACHE_MDD_RELPREV               (27LL<<40)
-#define CACHE_MDD_SATCOUNT              (28LL<<40)
-#define CACHE_MDD_SATCOUNTL1            (29LL<<40)
-#define CACHE_MDD_SATCOUNTL2            (30LL<<40)
+#define CACHE_MDD_RELPROD               (20LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_MINUS                 (21LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_UNION                 (22LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_INTERSECT             (23LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_PROJECT               (24LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_JOIN                  (25LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_MATCH                 (26LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_RELPREV               (27LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_SATCOUNT              (28LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_SATCOUNTL1            (29LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MDD_SATCOUNTL2            (30LL<<SYLVAN_INDEX_BITS)
 
 // MTBDD operations
-#define CACHE_MTBDD_APPLY               (40LL<<40)
-#define CACHE_MTBDD_UAPPLY              (41LL<<40)
-#define CACHE_MTBDD_ABSTRACT            (42LL<<40)
-#define CACHE_MTBDD_ITE                 (43LL<<40)
-#define CACHE_MTBDD_AND_ABSTRACT_PLUS   (44LL<<40)
-#define CACHE_MTBDD_AND_ABSTRACT_MAX    (45LL<<40)
-#define CACHE_MTBDD_SUPPORT             (46LL<<40)
-#define CACHE_MTBDD_COMPOSE             (47LL<<40)
-#define CACHE_MTBDD_EQUAL_NORM          (48LL<<40)
-#define CACHE_MTBDD_EQUAL_NORM_REL      (49LL<<40)
-#define CACHE_MTBDD_MINIMUM             (50LL<<40)
-#define CACHE_MTBDD_MAXIMUM             (51LL<<40)
-#define CACHE_MTBDD_LEQ                 (52LL<<40)
-#define CACHE_MTBDD_LESS                (53LL<<40)
-#define CACHE_MTBDD_GEQ                 (54LL<<40)
-#define CACHE_MTBDD_GREATER             (55LL<<40)
-#define CACHE_MTBDD_EVAL_COMPOSE        (56LL<<40)
+#define CACHE_MTBDD_APPLY               (40LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_UAPPLY              (41LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_ABSTRACT            (42LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_ITE                 (43LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_AND_ABSTRACT_PLUS   (44LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_AND_ABSTRACT_MAX    (45LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_SUPPORT             (46LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_COMPOSE             (47LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_EQUAL_NORM          (48LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_EQUAL_NORM_REL      (49LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_MINIMUM             (50LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_MAXIMUM             (51LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_LEQ                 (52LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_LESS                (53LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_GEQ                 (54LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_GREATER             (55LL<<SYLVAN_INDEX_BITS)
+#define CACHE_MTBDD_EVAL_COMPOSE        (56LL<<SYLVAN_INDEX_BITS)
 
 #ifdef __cplusplus
 }
@@ -37,19 +37,38 @@
  * Implementation of garbage collection
  */
 
-/* Recursively mark MDD nodes as 'in use' */
+static int lddmc_grey_type;
+
+/* Mark MDD nodes as 'in use' */
 VOID_TASK_IMPL_1(lddmc_gc_mark_rec, MDD, mdd)
 {
     if (mdd <= lddmc_true) return;
 
-    if (llmsset_mark(nodes, mdd)) {
-        mddnode_t n = LDD_GETNODE(mdd);
-        SPAWN(lddmc_gc_mark_rec, mddnode_getright(n));
-        CALL(lddmc_gc_mark_rec, mddnode_getdown(n));
-        SYNC(lddmc_gc_mark_rec);
+    if (sylvan_gc_marking == 1) {
+        // incremental marking: mark the children later
+        if (llmsset_mark(nodes, mdd)) sylvan_gc_push_grey(lddmc_grey_type, mdd);
+    } else {
+        // batched marking: the node is marked by sylvan_gc_mark_drain
+        sylvan_gc_mark_push(lddmc_grey_type, mdd);
     }
 }
 
+/* Mark the children of a marked node */
+VOID_TASK_1(lddmc_gc_mark_grey, uint64_t, index)
+{
+    mddnode_t n = LDD_GETNODE(index);
+    CALL(lddmc_gc_mark_rec, mddnode_getright(n));
+    CALL(lddmc_gc_mark_rec, mddnode_getdown(n));
+}
+
+/* Replace the children of a node by their new index (compacting garbage collection) */
+VOID_TASK_1(lddmc_gc_relocate_node, uint64_t, index)
+{
+    mddnode_t n = LDD_GETNODE(index);
+    mddnode_setright(n, sylvan_gc_relocated(mddnode_getright(n)));
+    mddnode_setdown(n, sylvan_gc_relocated(mddnode_getdown(n)));
+}
+
 /**
  * External references
  */
@@ -84,7 +103,10 @@ VOID_TASK_0(lddmc_gc_mark_external_refs)
     size_t count=0;
     uint64_t *it = refs_iter(&mdd_refs, 0, mdd_refs.refs_size);
     while (it != NULL) {
-        SPAWN(lddmc_gc_mark_rec, refs_next(&mdd_refs, &it, mdd_refs.refs_size));
+        MDD mdd = refs_next(&mdd_refs, &it, mdd_refs.refs_size);
+        // referenced by value, so the node cannot move during compaction
+        sylvan_gc_pin(mdd);
+        SPAWN(lddmc_gc_mark_rec, mdd);
         count++;
     }
     while (count--) {
@@ -104,17 +126,19 @@ VOID_TASK_0(lddmc_refs_mark_task)
             while (j--) SYNC(lddmc_gc_mark_rec);
             j=0;
         }
+        sylvan_gc_pin(lddmc_refs_key->results[i]);
         SPAWN(lddmc_gc_mark_rec, lddmc_refs_key->results[i]);
         j++;
     }
     for (i=0; i<lddmc_refs_key->s_count; i++) {
         Task *t = lddmc_refs_key->spawns[i];
-        if (!TASK_IS_STOLEN(t)) break;
-        if (TASK_IS_COMPLETED(t)) {
+        // a completed stolen task, or a task that was executed by SPAWN (adaptive cutoff)
+        if (TASK_IS_COMPLETED(t) || TASK_IS_INLINED(t)) {
             if (j >= 40) {
                 while (j--) SYNC(lddmc_gc_mark_rec);
                 j=0;
             }
+            sylvan_gc_pin(*(BDD*)TASK_RESULT(t));
             SPAWN(lddmc_gc_mark_rec, *(BDD*)TASK_RESULT(t));
             j++;
         }
@@ -127,6 +151,8 @@ VOID_TASK_0(lddmc_refs_mark)
     TOGETHER(lddmc_refs_mark_task);
 }
 
+VOID_TASK_DECL_0(lddmc_gc_relocate_serialize);
+
 VOID_TASK_0(lddmc_refs_init_task)
 {
     lddmc_refs_internal_t s = (lddmc_refs_internal_t)malloc(sizeof(struct lddmc_refs_internal));
@@ -158,17 +184,122 @@ lddmc_quit()
     refs_free(&mdd_refs);
 }
 
+/**
+ * The state of a detached context (see sylvan_context_detach)
+ */
+struct lddmc_context
+{
+    int grey_type;
+    refs_table_t refs;
+    lddmc_refs_internal_t *refs_key; // the internal references of every worker
+    avl_node_t *ser_set;
+    avl_node_t *ser_reversed_set;
+    size_t ser_counter;
+    size_t ser_done;
+};
+
+// state of the serialization functions (see below)
+static avl_node_t *lddmc_ser_set;
+static avl_node_t *lddmc_ser_reversed_set;
+static volatile size_t lddmc_ser_counter;
+static size_t lddmc_ser_done;
+
+/* Exchange the internal references of every worker with saved[worker] */
+VOID_TASK_1(lddmc_refs_swap_task, lddmc_refs_internal_t*, saved)
+{
+    LOCALIZE_THREAD_LOCAL(lddmc_refs_key, lddmc_refs_internal_t);
+    lddmc_refs_internal_t tmp = lddmc_refs_key;
+    SET_THREAD_LOCAL(lddmc_refs_key, saved[LACE_WORKER_ID]);
+    saved[LACE_WORKER_ID] = tmp;
+}
+
+void*
+lddmc_context_detach()
+{
+    struct lddmc_context *c = (struct lddmc_context*)malloc(sizeof(struct lddmc_context));
+    c->grey_type = lddmc_grey_type;
+    c->refs = mdd_refs;
+    c->refs_key = (lddmc_refs_internal_t*)calloc(lace_workers(), sizeof(lddmc_refs_internal_t));
+    c->ser_set = lddmc_ser_set;
+    c->ser_reversed_set = lddmc_ser_reversed_set;
+    c->ser_counter = lddmc_ser_counter;
+    c->ser_done = lddmc_ser_done;
+
+    LACE_ME;
+    TOGETHER(lddmc_refs_swap_task, c->refs_key);
+
+    // as after lddmc_quit and lddmc_serialize_reset
+    memset(&mdd_refs, 0, sizeof(refs_table_t));
+    lddmc_ser_set = NULL;
+    lddmc_ser_reversed_set = NULL;
+    lddmc_ser_counter = 2;
+    lddmc_ser_done = 0;
+    return c;
+}
+
+void
+lddmc_context_attach(void *context)
+{
+    struct lddmc_context *c = (struct lddmc_context*)context;
+    lddmc_grey_type = c->grey_type;
+    mdd_refs = c->refs;
+    lddmc_ser_set = c->ser_set;
+    lddmc_ser_reversed_set = c->ser_reversed_set;
+    lddmc_ser_counter = c->ser_counter;
+    lddmc_ser_done = c->ser_done;
+
+    LACE_ME;
+    TOGETHER(lddmc_refs_swap_task, c->refs_key);
+    free(c->refs_key);
+    free(c);
+}
+
 void
 sylvan_init_ldd()
 {
+    // LDD nodes store 47-bit indices (31-bit indices with SYLVAN_COMPACT_NODES)
+#if SYLVAN_COMPACT_NODES
+    const int index_bits = 31;
+#else
+    const int index_bits = 47;
+#endif
+    if (llmsset_get_max_size(nodes) > (1ULL << index_bits)) {
+        fprintf(stderr, "sylvan_init_ldd error: tablesize must be <= %d bits!\n", index_bits);
+        exit(1);
+    }
+
     sylvan_register_quit(lddmc_quit);
     sylvan_gc_add_mark(TASK(lddmc_gc_mark_external_refs));
     sylvan_gc_add_mark(TASK(lddmc_gc_mark_serialize));
+    lddmc_grey_type = sylvan_gc_register_grey(TASK(lddmc_gc_mark_grey));
+    sylvan_gc_register_relocate(lddmc_grey_type, TASK(lddmc_gc_relocate_node));
+    sylvan_gc_add_relocate(TASK(lddmc_gc_relocate_serialize));
 
     refs_create(&mdd_refs, 1024);
 
     LACE_ME;
     CALL(lddmc_refs_init);
+
+    // which values in the operation cache are nodes, to keep entries during garbage collection
+    const int nodes2 = CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_RES;
+    const int nodes3 = CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_C | CACHE_NODE_RES;
+    const int nodes4 = CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_C | CACHE_NODE_D | CACHE_NODE_RES;
+    cache_set_layout(CACHE_MDD_RELPROD, nodes4); // both with cache_put3 and cache_put4
+    cache_set_layout(CACHE_MDD_MINUS, nodes2);
+    cache_set_layout(CACHE_MDD_UNION, nodes2);
+    cache_set_layout(CACHE_MDD_INTERSECT, nodes2);
+    cache_set_layout(CACHE_MDD_PROJECT, nodes3);
+    cache_set_layout(CACHE_MDD_JOIN, nodes4);
+    cache_set_layout(CACHE_MDD_MATCH, nodes3);
+    cache_set_layout(CACHE_MDD_RELPREV, nodes4);
+    cache_set_layout(CACHE_MDD_SATCOUNT, CACHE_NODE_A); // result is a double
+    cache_set_layout(CACHE_MDD_SATCOUNTL1, CACHE_NODE_A);
+    cache_set_layout(CACHE_MDD_SATCOUNTL2, CACHE_NODE_A);
+
+    // results of expensive operations are evicted less often from the operation cache
+    cache_set_priority(CACHE_MDD_PROJECT, 1);
+    cache_set_priority(CACHE_MDD_RELPROD, 2);
+    cache_set_priority(CACHE_MDD_RELPREV, 2);
 }
 
 /**
@@ -206,6 +337,8 @@ lddmc_makenode(uint32_t value, MDD ifeq, MDD ifneq)
     if (created) sylvan_stats_count(LDD_NODES_CREATED);
     else sylvan_stats_count(LDD_NODES_REUSED);
 
+    sylvan_gc_incremental_step(created);
+
     return (MDD)index;
 }
 
@@ -234,6 +367,8 @@ lddmc_make_copynode(MDD ifeq, MDD ifneq)
     if (created) sylvan_stats_count(LDD_NODES_CREATED);
     else sylvan_stats_count(LDD_NODES_REUSED);
 
+    sylvan_gc_incremental_step(created);
+
     return (MDD)index;
 }
 
@@ -2454,6 +2589,22 @@ VOID_TASK_IMPL_0(lddmc_gc_mark_serialize)
     }
 }
 
+VOID_TASK_IMPL_0(lddmc_gc_relocate_serialize)
+{
+    struct lddmc_ser *s;
+
+    /* The reversed set is ordered by the assigned numbers, so update the nodes in place */
+    avl_iter_t *it = lddmc_ser_reversed_iter(lddmc_ser_reversed_set);
+    while ((s=lddmc_ser_reversed_iter_next(it))) s->mdd = sylvan_gc_relocated(s->mdd);
+    lddmc_ser_reversed_iter_free(it);
+
+    /* The other set is ordered by the nodes, so rebuild it from the reversed set */
+    lddmc_ser_free(&lddmc_ser_set);
+    it = lddmc_ser_reversed_iter(lddmc_ser_reversed_set);
+    while ((s=lddmc_ser_reversed_iter_next(it))) lddmc_ser_insert(&lddmc_ser_set, s);
+    lddmc_ser_reversed_iter_free(it);
+}
+
 static void
 lddmc_sha2_rec(MDD mdd, SHA256_CTX *ctx)
 {
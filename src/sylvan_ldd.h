@@ -25,7 +25,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 
-typedef uint64_t MDD;       // Note: low 40 bits only
+typedef uint64_t MDD;       // Note: low 40 bits only (47 bits with SYLVAN_WIDE_INDEX, 31 bits with SYLVAN_COMPACT_NODES)
 
 #define lddmc_false         ((MDD)0)
 #define lddmc_true          ((MDD)1)
@@ -41,6 +41,91 @@
 #ifndef SYLVAN_LDD_INT_H
 #define SYLVAN_LDD_INT_H
 
+#if SYLVAN_COMPACT_NODES
+
+/**
+ * LDD node structure
+ *
+ * With SYLVAN_COMPACT_NODES (12 bytes, 31-bit indices):
+ * a = value (32 bits), right (31 bits), m; b = down (31 bits), c
+ */
+typedef struct __attribute__((packed)) mddnode {
+    uint64_t a;
+    uint32_t b;
+} * mddnode_t; // 12 bytes
+
+#define LDD_GETNODE(mdd) ((mddnode_t)llmsset_index_to_ptr(nodes, mdd))
+
+static inline uint32_t __attribute__((unused))
+mddnode_getvalue(mddnode_t n)
+{
+    return (uint32_t)(n->a >> 32);
+}
+
+static inline uint8_t __attribute__((unused))
+mddnode_getmark(mddnode_t n)
+{
+    return n->a & 1;
+}
+
+static inline uint8_t __attribute__((unused))
+mddnode_getcopy(mddnode_t n)
+{
+    return n->b & 1;
+}
+
+static inline uint64_t __attribute__((unused))
+mddnode_getright(mddnode_t n)
+{
+    return (n->a & 0x00000000ffffffff) >> 1;
+}
+
+static inline uint64_t __attribute__((unused))
+mddnode_getdown(mddnode_t n)
+{
+    return n->b >> 1;
+}
+
+static inline void __attribute__((unused))
+mddnode_setvalue(mddnode_t n, uint32_t value)
+{
+    n->a = (n->a & 0x00000000ffffffff) | ((uint64_t)value << 32);
+}
+
+static inline void __attribute__((unused))
+mddnode_setmark(mddnode_t n, uint8_t mark)
+{
+    n->a = (n->a & 0xfffffffffffffffe) | (mark ? 1 : 0);
+}
+
+static inline void __attribute__((unused))
+mddnode_setright(mddnode_t n, uint64_t right)
+{
+    n->a = (n->a & 0xffffffff00000001) | (right << 1);
+}
+
+static inline void __attribute__((unused))
+mddnode_setdown(mddnode_t n, uint64_t down)
+{
+    n->b = (n->b & 1) | (uint32_t)(down << 1);
+}
+
+static inline void __attribute__((unused))
+mddnode_make(mddnode_t n, uint32_t value, uint64_t right, uint64_t down)
+{
+    n->a = ((uint64_t)value << 32) | (right << 1);
+    n->b = (uint32_t)(down << 1);
+}
+
+static inline void __attribute__((unused))
+mddnode_makecopy(mddnode_t n, uint64_t right, uint64_t down)
+{
+    n->a = right << 1;
+    n->b = (uint32_t)(down << 1) | 1;
+}
+
+#else
+
 /**
  * LDD node structure
  *
@@ -123,3 +208,5 @@ mddnode_makecopy(mddnode_t n, uint64_t right, uint64_t down)
 }
 
 #endif
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_config.h>
+
+#include <errno.h>  // for errno
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // for strerror
+#include <sys/mman.h> // for mmap
+
+#include <sylvan.h>
+#include <sylvan_int.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef cas
+#define cas(ptr, old, new) (__sync_bool_compare_and_swap((ptr),(old),(new)))
+#endif
+
+/**
+ * The nodes of every level are in a singly linked list: the level has the first node,
+ * and every node has the next node (in level_next, indexed like the nodes table).
+ * Nodes are added at the front with compare-and-swap, so workers add nodes concurrently.
+ */
+
+#define LEVELS_MAX (1LL<<24) // the variable of an MTBDD node has 24 bits
+
+typedef struct level_entry
+{
+    volatile uint64_t first;
+    volatile uint64_t count;
+} *level_entry_t;
+
+int sylvan_level_index_enabled = 0;
+
+static level_entry_t level_entries = NULL;
+static uint64_t *level_next = NULL;
+static size_t level_next_size = 0;
+static volatile uint32_t level_count = 0;
+
+void
+sylvan_level_index_add(uint32_t level, uint64_t index)
+{
+    level_entry_t e = level_entries + level;
+    for (;;) {
+        uint64_t first = e->first;
+        level_next[index] = first;
+        if (cas(&e->first, first, index)) break;
+    }
+    __sync_fetch_and_add(&e->count, 1);
+
+    for (;;) {
+        uint32_t c = level_count;
+        if (c > level || cas(&level_count, c, level+1)) break;
+    }
+}
+
+void
+sylvan_level_index_reset()
+{
+    if (level_entries == NULL) return;
+    memset(level_entries, 0, sizeof(struct level_entry) * level_count);
+    level_count = 0;
+}
+
+size_t
+sylvan_level_nodecount(uint32_t level)
+{
+    if (level >= level_count) return 0;
+    return level_entries[level].count;
+}
+
+MTBDD
+sylvan_level_first(uint32_t level)
+{
+    if (level >= level_count) return mtbdd_false;
+    return level_entries[level].first;
+}
+
+MTBDD
+sylvan_level_next(MTBDD node)
+{
+    return level_next[node & SYLVAN_INDEX_MASK];
+}
+
+uint32_t
+sylvan_level_count()
+{
+    return level_count;
+}
+
+/**
+ * Remove the nodes that did not survive garbage collection from the lists
+ */
+VOID_TASK_2(sylvan_level_index_filter_par, uint32_t, first, uint32_t, count)
+{
+    if (count > 16) {
+        SPAWN(sylvan_level_index_filter_par, first, count/2);
+        CALL(sylvan_level_index_filter_par, first+count/2, count-count/2);
+        SYNC(sylvan_level_index_filter_par);
+        return;
+    }
+
+    for (uint32_t level=first; level<first+count; level++) {
+        level_entry_t e = level_entries + level;
+        uint64_t head = 0, *tail = &head;
+        size_t n = 0;
+        for (uint64_t index = e->first; index != 0; index = level_next[index]) {
+            if (llmsset_is_marked(nodes, index)) {
+                *tail = index;
+                tail = level_next + index;
+                n++;
+            }
+        }
+        *tail = 0;
+        e->first = head;
+        e->count = n;
+    }
+}
+
+VOID_TASK_0(sylvan_level_index_postgc)
+{
+    if (!sylvan_level_index_enabled) return;
+    CALL(sylvan_level_index_filter_par, 0, level_count);
+}
+
+VOID_TASK_3(sylvan_level_index_relocate_par, uint64_t*, next, uint32_t, first, uint32_t, count)
+{
+    if (count > 16) {
+        SPAWN(sylvan_level_index_relocate_par, next, first, count/2);
+        CALL(sylvan_level_index_relocate_par, next, first+count/2, count-count/2);
+        SYNC(sylvan_level_index_relocate_par);
+        return;
+    }
+
+    for (uint32_t level=first; level<first+count; level++) {
+        level_entry_t e = level_entries + level;
+        uint64_t head = 0, *tail = &head;
+        size_t n = 0;
+        for (uint64_t index = e->first; index != 0; index = level_next[index]) {
+            if (llmsset_is_marked(nodes, index)) {
+                const uint64_t relocated = sylvan_gc_relocated(index);
+                *tail = relocated;
+                tail = next + relocated;
+                n++;
+            }
+        }
+        *tail = 0;
+        e->first = head;
+        e->count = n;
+    }
+}
+
+/* Replace the nodes in the index by their new index (compacting garbage collection) */
+VOID_TASK_0(sylvan_level_index_relocate)
+{
+    if (!sylvan_level_index_enabled) return;
+    uint64_t *next = (uint64_t*)mmap(0, sizeof(uint64_t) * level_next_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (next == (uint64_t*)-1) {
+        fprintf(stderr, "sylvan_level_index_relocate: Unable to allocate memory: %s!\n", strerror(errno));
+        exit(1);
+    }
+    CALL(sylvan_level_index_relocate_par, next, 0, level_count);
+    munmap(level_next, sizeof(uint64_t) * level_next_size);
+    level_next = next;
+}
+
+static int level_index_initialized = 0;
+
+static void
+sylvan_level_index_quit()
+{
+    if (level_entries != NULL) {
+        munmap(level_entries, sizeof(struct level_entry) * LEVELS_MAX);
+        munmap(level_next, sizeof(uint64_t) * level_next_size);
+        level_entries = NULL;
+        level_next = NULL;
+    }
+    sylvan_level_index_enabled = 0;
+    level_count = 0;
+    level_index_initialized = 0;
+}
+
+/**
+ * The level index of a detached context (see sylvan_context_detach)
+ */
+struct level_index_context
+{
+    int initialized;
+    int enabled;
+    level_entry_t entries;
+    uint64_t *next;
+    size_t next_size;
+    uint32_t count;
+};
+
+void*
+sylvan_level_index_context_detach()
+{
+    struct level_index_context *c = (struct level_index_context*)malloc(sizeof(struct level_index_context));
+    c->initialized = level_index_initialized;
+    c->enabled = sylvan_level_index_enabled;
+    c->entries = level_entries;
+    c->next = level_next;
+    c->next_size = level_next_size;
+    c->count = level_count;
+    level_entries = NULL;
+    level_next = NULL;
+    level_next_size = 0;
+    level_count = 0;
+    sylvan_level_index_enabled = 0;
+    level_index_initialized = 0;
+    return c;
+}
+
+void
+sylvan_level_index_context_attach(void *context)
+{
+    struct level_index_context *c = (struct level_index_context*)context;
+    level_index_initialized = c->initialized;
+    sylvan_level_index_enabled = c->enabled;
+    level_entries = c->entries;
+    level_next = c->next;
+    level_next_size = c->next_size;
+    level_count = c->count;
+    free(c);
+}
+
+void
+sylvan_set_level_index(int enabled)
+{
+    if (!level_index_initialized) {
+        level_index_initialized = 1;
+        sylvan_register_quit(sylvan_level_index_quit);
+        sylvan_gc_hook_postgc(TASK(sylvan_level_index_postgc));
+        sylvan_gc_add_relocate(TASK(sylvan_level_index_relocate));
+    }
+
+    if (enabled && level_entries == NULL) {
+        level_next_size = llmsset_get_max_size(nodes);
+        level_entries = (level_entry_t)mmap(0, sizeof(struct level_entry) * LEVELS_MAX, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        level_next = (uint64_t*)mmap(0, sizeof(uint64_t) * level_next_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (level_entries == (level_entry_t)-1 || level_next == (uint64_t*)-1) {
+            fprintf(stderr, "sylvan_set_level_index: Unable to allocate memory: %s!\n", strerror(errno));
+            exit(1);
+        }
+    }
+
+    if (!enabled) sylvan_level_index_reset();
+    sylvan_level_index_enabled = enabled ? 1 : 0;
+}
+
+int
+sylvan_level_index_is_enabled()
+{
+    return sylvan_level_index_enabled;
+}
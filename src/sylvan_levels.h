@@ -0,0 +1,63 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Do not include this file directly. Instead, include sylvan.h */
+
+#ifndef SYLVAN_LEVELS_H
+#define SYLVAN_LEVELS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Per-level node index for BDDs and MTBDDs.
+ *
+ * When enabled, every internal MTBDD node that is created by mtbdd_makenode or mtbdd_makemapnode
+ * is added to the list of its level (the variable of the node, see sylvan_var_to_level),
+ * and counted. Garbage collection removes the nodes that died from the lists.
+ * Between garbage collections, the lists also contain nodes that are no longer referenced.
+ *
+ * Nodes created while the index is disabled are not in the index, so enable the index
+ * before creating MTBDDs. Leaves and LDD nodes are not in the index.
+ */
+void sylvan_set_level_index(int enabled);
+int sylvan_level_index_is_enabled(void);
+
+/**
+ * Number of nodes at <level>.
+ */
+size_t sylvan_level_nodecount(uint32_t level);
+
+/**
+ * Enumerate the nodes at <level>: sylvan_level_first returns the first node,
+ * sylvan_level_next the node after <node>, or mtbdd_false (0) after the last node.
+ * Do not enumerate during garbage collection.
+ */
+MTBDD sylvan_level_first(uint32_t level);
+MTBDD sylvan_level_next(MTBDD node);
+
+/**
+ * Highest level with nodes in the index (plus one).
+ */
+uint32_t sylvan_level_count(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_config.h>
+
+#include <stdint.h> // for uint64_t
+#include <sys/mman.h> // for mmap, madvise
+#include <unistd.h> // for syscall
+
+#ifdef __linux__
+#include <sys/syscall.h> // for SYS_mbind
+#endif
+
+#include <sylvan_mem.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* size of the pages of the huge page pool (MAP_HUGETLB) */
+#define HUGE_PAGE_SIZE ((size_t)2*1024*1024)
+
+/* the NUMA policies of mbind (see linux/mempolicy.h) */
+#define MEMPOLICY_INTERLEAVE    3
+#define MEMPOLICY_LOCAL         4
+#define MEMPOLICY_MEMS_ALLOWED  (1<<2)
+#define MEMPOLICY_MAX_NODES     1024
+
+static int mem_pages = SYLVAN_PAGES_DEFAULT;
+static int mem_numa = SYLVAN_NUMA_DEFAULT;
+
+void
+sylvan_set_memory_policy(int pages, int numa)
+{
+    mem_pages = pages;
+    mem_numa = numa;
+}
+
+/**
+ * Allocations of at least one huge page use the huge page pool (with SYLVAN_PAGES_HUGETLB).
+ * Their size is always rounded up to whole huge pages, whatever the policy, so sylvan_mem_free
+ * and sylvan_mem_clear use the same size even if the policy changed since the allocation.
+ */
+static int
+mem_hugetlb(size_t size)
+{
+#ifdef MAP_HUGETLB
+    return mem_pages == SYLVAN_PAGES_HUGETLB && size >= HUGE_PAGE_SIZE;
+#else
+    (void)size;
+    return 0;
+#endif
+}
+
+static size_t
+mem_size(size_t size)
+{
+    if (size >= HUGE_PAGE_SIZE) return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    return size;
+}
+
+/**
+ * Apply the NUMA policy to new pages, and request transparent huge pages if <transparent>
+ */
+static void
+mem_apply(void *ptr, size_t size, int transparent)
+{
+#ifdef MADV_HUGEPAGE
+    if (transparent) madvise(ptr, size, MADV_HUGEPAGE);
+#else
+    (void)transparent;
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+    if (mem_numa == SYLVAN_NUMA_INTERLEAVE) {
+        uint64_t nodes[MEMPOLICY_MAX_NODES/64] = {0};
+        if (syscall(SYS_get_mempolicy, NULL, nodes, MEMPOLICY_MAX_NODES, NULL, MEMPOLICY_MEMS_ALLOWED) == 0) {
+            syscall(SYS_mbind, ptr, size, MEMPOLICY_INTERLEAVE, nodes, MEMPOLICY_MAX_NODES, 0);
+        }
+    } else if (mem_numa == SYLVAN_NUMA_FIRSTTOUCH) {
+        syscall(SYS_mbind, ptr, size, MEMPOLICY_LOCAL, NULL, 0, 0);
+    }
+#endif
+}
+
+static void *
+mem_map(void *ptr, size_t size)
+{
+    const int fixed = ptr != NULL ? MAP_FIXED : 0;
+#ifdef MAP_HUGETLB
+    if (mem_hugetlb(size)) {
+        void *res = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | fixed, -1, 0);
+        if (res != (void*)-1) {
+            mem_apply(res, size, 0);
+            return res;
+        }
+        // not enough huge pages in the pool: fall back to transparent huge pages
+    }
+#endif
+    void *res = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | fixed, -1, 0);
+    if (res != (void*)-1) mem_apply(res, size, mem_pages != SYLVAN_PAGES_DEFAULT);
+    return res;
+}
+
+void *
+sylvan_mem_alloc(size_t size)
+{
+    return mem_map(NULL, mem_size(size));
+}
+
+void
+sylvan_mem_free(void *ptr, size_t size)
+{
+    munmap(ptr, mem_size(size));
+}
+
+int
+sylvan_mem_clear(void *ptr, size_t size)
+{
+    return mem_map(ptr, mem_size(size)) != (void*)-1;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_config.h>
+
+#include <stddef.h> // for size_t
+
+#ifndef SYLVAN_MEM_H
+#define SYLVAN_MEM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Memory backing of the nodes table and the operation cache.
+ *
+ * The tables are allocated in virtual memory with mmap. The page size and the NUMA placement
+ * of these allocations can be configured with sylvan_set_memory_policy, before calling
+ * sylvan_init_package. Policies that are not supported by the system are silently ignored.
+ *
+ * Page sizes:
+ * - SYLVAN_PAGES_DEFAULT: normal pages (the system may still use transparent huge pages)
+ * - SYLVAN_PAGES_TRANSPARENT: request transparent huge pages (madvise MADV_HUGEPAGE)
+ * - SYLVAN_PAGES_HUGETLB: use pages from the huge page pool (MAP_HUGETLB) for large tables,
+ *   or transparent huge pages if the pool is too small
+ *
+ * NUMA placement:
+ * - SYLVAN_NUMA_DEFAULT: the policy of the process
+ * - SYLVAN_NUMA_INTERLEAVE: pages are interleaved over all allowed NUMA nodes (mbind)
+ * - SYLVAN_NUMA_FIRSTTOUCH: pages are placed on the NUMA node of the thread that first uses them (mbind)
+ */
+#define SYLVAN_PAGES_DEFAULT        0
+#define SYLVAN_PAGES_TRANSPARENT    1
+#define SYLVAN_PAGES_HUGETLB        2
+
+#define SYLVAN_NUMA_DEFAULT         0
+#define SYLVAN_NUMA_INTERLEAVE      1
+#define SYLVAN_NUMA_FIRSTTOUCH      2
+
+void sylvan_set_memory_policy(int pages, int numa);
+
+/**
+ * Allocate <size> bytes of zeroed memory with the memory policy.
+ * Returns (void*)-1 if the memory could not be allocated, like mmap.
+ */
+void *sylvan_mem_alloc(size_t size);
+
+/**
+ * Free memory of <size> bytes allocated with sylvan_mem_alloc.
+ */
+void sylvan_mem_free(void *ptr, size_t size);
+
+/**
+ * Clear memory of <size> bytes allocated with sylvan_mem_alloc, by mapping new pages.
+ * Returns 0 if this failed; the caller must then clear the memory with memset.
+ */
+int sylvan_mem_clear(void *ptr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
@@ -93,22 +93,63 @@ mtbdd_getdouble(MTBDD leaf)
  * Implementation of garbage collection
  */
 
-/* Recursively mark MDD nodes as 'in use' */
-VOID_TASK_IMPL_1(mtbdd_gc_mark_rec, MDD, mtbdd)
+static int mtbdd_grey_type;
+
+/* Mark MDD nodes as 'in use' */
+VOID_TASK_1(mtbdd_gc_mark_node, MDD, mtbdd)
 {
     if (mtbdd == mtbdd_true) return;
     if (mtbdd == mtbdd_false) return;
 
-    if (llmsset_mark(nodes, MTBDD_STRIPMARK(mtbdd))) {
-        mtbddnode_t n = MTBDD_GETNODE(mtbdd);
-        if (!mtbddnode_isleaf(n)) {
-            SPAWN(mtbdd_gc_mark_rec, mtbddnode_getlow(n));
-            CALL(mtbdd_gc_mark_rec, mtbddnode_gethigh(n));
-            SYNC(mtbdd_gc_mark_rec);
+    if (sylvan_gc_marking == 1) {
+        // incremental marking: mark the children later
+        if (llmsset_mark(nodes, MTBDD_STRIPMARK(mtbdd))) {
+            sylvan_gc_push_grey(mtbdd_grey_type, MTBDD_STRIPMARK(mtbdd));
         }
+    } else {
+        // batched marking: the node is marked by sylvan_gc_mark_drain
+        sylvan_gc_mark_push(mtbdd_grey_type, MTBDD_STRIPMARK(mtbdd));
     }
 }
 
+/* Mark a referenced MTBDD (and its nodes) as 'in use' */
+VOID_TASK_IMPL_1(mtbdd_gc_mark_rec, MDD, mtbdd)
+{
+    // reordering needs to know which nodes are referenced
+    if (sylvan_reorder_collecting) sylvan_reorder_add_root(mtbdd);
+    CALL(mtbdd_gc_mark_node, mtbdd);
+}
+
+/* Mark the children of a marked node */
+VOID_TASK_1(mtbdd_gc_mark_grey, uint64_t, index)
+{
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    if (!mtbddnode_isleaf(n)) {
+        CALL(mtbdd_gc_mark_node, mtbddnode_getlow(n));
+        CALL(mtbdd_gc_mark_node, mtbddnode_gethigh(n));
+    }
+}
+
+static inline MTBDD
+mtbdd_gc_relocated(MTBDD dd)
+{
+    return (dd & ~SYLVAN_INDEX_MASK) | sylvan_gc_relocated(dd & SYLVAN_INDEX_MASK);
+}
+
+/* Replace the children of a node by their new index (compacting garbage collection) */
+VOID_TASK_1(mtbdd_gc_relocate_node, uint64_t, index)
+{
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    if (mtbddnode_isleaf(n)) return;
+    const uint32_t var = mtbddnode_getvariable(n);
+    const MTBDD low = mtbdd_gc_relocated(mtbddnode_getlow(n));
+    const MTBDD high = mtbdd_gc_relocated(mtbddnode_gethigh(n));
+    const int mark = mtbddnode_getmark(n);
+    if (mtbddnode_ismapnode(n)) mtbddnode_makemapnode(n, var, low, high);
+    else mtbddnode_makenode(n, var, low, high);
+    if (mark) mtbddnode_setmark(n, 1);
+}
+
 /**
  * External references
  */
@@ -168,7 +209,10 @@ VOID_TASK_0(mtbdd_gc_mark_external_refs)
     size_t count=0;
     uint64_t *it = refs_iter(&mtbdd_refs, 0, mtbdd_refs.refs_size);
     while (it != NULL) {
-        SPAWN(mtbdd_gc_mark_rec, refs_next(&mtbdd_refs, &it, mtbdd_refs.refs_size));
+        MTBDD dd = refs_next(&mtbdd_refs, &it, mtbdd_refs.refs_size);
+        // referenced by value, so the node cannot move during compaction
+        sylvan_gc_pin(MTBDD_STRIPMARK(dd));
+        SPAWN(mtbdd_gc_mark_rec, dd);
         count++;
     }
     while (count--) {
@@ -203,17 +247,19 @@ VOID_TASK_0(mtbdd_refs_mark_task)
             while (j--) SYNC(mtbdd_gc_mark_rec);
             j=0;
         }
+        sylvan_gc_pin(MTBDD_STRIPMARK(mtbdd_refs_key->results[i]));
         SPAWN(mtbdd_gc_mark_rec, mtbdd_refs_key->results[i]);
         j++;
     }
     for (i=0; i<mtbdd_refs_key->s_count; i++) {
         Task *t = mtbdd_refs_key->spawns[i];
-        if (!TASK_IS_STOLEN(t)) break;
-        if (TASK_IS_COMPLETED(t)) {
+        // a completed stolen task, or a task that was executed by SPAWN (adaptive cutoff)
+        if (TASK_IS_COMPLETED(t) || TASK_IS_INLINED(t)) {
             if (j >= 40) {
                 while (j--) SYNC(mtbdd_gc_mark_rec);
                 j=0;
             }
+            sylvan_gc_pin(MTBDD_STRIPMARK(*(BDD*)TASK_RESULT(t)));
             SPAWN(mtbdd_gc_mark_rec, *(BDD*)TASK_RESULT(t));
             j++;
         }
@@ -226,6 +272,36 @@ VOID_TASK_0(mtbdd_refs_mark)
     TOGETHER(mtbdd_refs_mark_task);
 }
 
+static int
+mtbdd_gc_compare_ptr(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Called during compacting garbage collection */
+VOID_TASK_0(mtbdd_gc_relocate_protected)
+{
+    // a pointer can be protected more than once, so update every pointer once
+    size_t count = 0, size = 64;
+    uint64_t *ptrs = (uint64_t*)malloc(sizeof(uint64_t) * size);
+    uint64_t *it = protect_iter(&mtbdd_protected, 0, mtbdd_protected.refs_size);
+    while (it != NULL) {
+        if (count == size) {
+            size *= 2;
+            ptrs = (uint64_t*)realloc(ptrs, sizeof(uint64_t) * size);
+        }
+        ptrs[count++] = protect_next(&mtbdd_protected, &it, mtbdd_protected.refs_size);
+    }
+    qsort(ptrs, count, sizeof(uint64_t), mtbdd_gc_compare_ptr);
+    for (size_t i=0; i<count; i++) {
+        if (i > 0 && ptrs[i] == ptrs[i-1]) continue;
+        MTBDD *p = (MTBDD*)ptrs[i];
+        *p = mtbdd_gc_relocated(*p);
+    }
+    free(ptrs);
+}
+
 VOID_TASK_0(mtbdd_refs_init_task)
 {
     mtbdd_refs_internal_t s = (mtbdd_refs_internal_t)malloc(sizeof(struct mtbdd_refs_internal));
@@ -263,54 +339,69 @@ typedef struct
 static customleaf_t *cl_registry;
 static size_t cl_registry_count;
 
+/**
+ * The callbacks of the nodes table get the two words of a node (see sylvan_mtbdd_int.h).
+ * With SYLVAN_COMPACT_NODES, the value of a leaf is in the first word and the type in the second.
+ */
+#if SYLVAN_COMPACT_NODES
+#define LEAF_ISLEAF(a, b)   ((b) & 0x80000000)
+#define LEAF_TYPE(a, b)     ((uint32_t)((b) & 0x0fffffff))
+#define LEAF_VALUE(a, b)    (a)
+#define LEAF_HEADER(a, b)   (b)
+#else
+#define LEAF_ISLEAF(a, b)   ((a) & 0x4000000000000000)
+#define LEAF_TYPE(a, b)     ((uint32_t)((a) & 0xffffffff))
+#define LEAF_VALUE(a, b)    (b)
+#define LEAF_HEADER(a, b)   (a)
+#endif
+
 static void
 _mtbdd_create_cb(uint64_t *a, uint64_t *b)
 {
     // for leaf
-    if ((*a & 0x4000000000000000) == 0) return; // huh?
-    uint32_t type = *a & 0xffffffff;
+    if (LEAF_ISLEAF(*a, *b) == 0) return; // huh?
+    uint32_t type = LEAF_TYPE(*a, *b);
     if (type >= cl_registry_count) return; // not in registry
     customleaf_t *c = cl_registry + type;
     if (c->create_cb == NULL) return; // not in registry
-    c->create_cb(b);
+    c->create_cb(&LEAF_VALUE(*a, *b));
 }
 
 static void
 _mtbdd_destroy_cb(uint64_t a, uint64_t b)
 {
     // for leaf
-    if ((a & 0x4000000000000000) == 0) return; // huh?
-    uint32_t type = a & 0xffffffff;
+    if (LEAF_ISLEAF(a, b) == 0) return; // huh?
+    uint32_t type = LEAF_TYPE(a, b);
     if (type >= cl_registry_count) return; // not in registry
     customleaf_t *c = cl_registry + type;
     if (c->destroy_cb == NULL) return; // not in registry
-    c->destroy_cb(b);
+    c->destroy_cb(LEAF_VALUE(a, b));
 }
 
 static uint64_t
 _mtbdd_hash_cb(uint64_t a, uint64_t b, uint64_t seed)
 {
     // for leaf
-    if ((a & 0x4000000000000000) == 0) return llmsset_hash(a, b, seed);
-    uint32_t type = a & 0xffffffff;
+    if (LEAF_ISLEAF(a, b) == 0) return llmsset_hash(a, b, seed);
+    uint32_t type = LEAF_TYPE(a, b);
     if (type >= cl_registry_count) return llmsset_hash(a, b, seed);
     customleaf_t *c = cl_registry + type;
     if (c->hash_cb == NULL) return llmsset_hash(a, b, seed);
-    return c->hash_cb(b, seed ^ a);
+    return c->hash_cb(LEAF_VALUE(a, b), seed ^ LEAF_HEADER(a, b));
 }
 
 static int
 _mtbdd_equals_cb(uint64_t a, uint64_t b, uint64_t aa, uint64_t bb)
 {
     // for leaf
-    if (a != aa) return 0;
-    if ((a & 0x4000000000000000) == 0) return b == bb ? 1 : 0;
-    if ((aa & 0x4000000000000000) == 0) return b == bb ? 1 : 0;
-    uint32_t type = a & 0xffffffff;
-    if (type >= cl_registry_count) return b == bb ? 1 : 0;
+    if (LEAF_HEADER(a, b) != LEAF_HEADER(aa, bb)) return 0;
+    if (LEAF_ISLEAF(a, b) == 0) return LEAF_VALUE(a, b) == LEAF_VALUE(aa, bb) ? 1 : 0;
+    uint32_t type = LEAF_TYPE(a, b);
+    if (type >= cl_registry_count) return LEAF_VALUE(a, b) == LEAF_VALUE(aa, bb) ? 1 : 0;
     customleaf_t *c = cl_registry + type;
-    if (c->equals_cb == NULL) return b == bb ? 1 : 0;
-    return c->equals_cb(b, bb);
+    if (c->equals_cb == NULL) return LEAF_VALUE(a, b) == LEAF_VALUE(aa, bb) ? 1 : 0;
+    return c->equals_cb(LEAF_VALUE(a, b), LEAF_VALUE(aa, bb));
 }
 
 uint32_t
@@ -397,6 +488,74 @@ mtbdd_quit()
     mtbdd_initialized = 0;
 }
 
+/**
+ * The state of a detached context (see sylvan_context_detach)
+ */
+struct mtbdd_context
+{
+    int initialized;
+    int grey_type;
+    refs_table_t refs;
+    refs_table_t protected;
+    int protected_created;
+    customleaf_t *cl_registry;
+    size_t cl_registry_count;
+    mtbdd_refs_internal_t *refs_key; // the internal references of every worker
+};
+
+/* Exchange the internal references of every worker with saved[worker] */
+VOID_TASK_1(mtbdd_refs_swap_task, mtbdd_refs_internal_t*, saved)
+{
+    LOCALIZE_THREAD_LOCAL(mtbdd_refs_key, mtbdd_refs_internal_t);
+    mtbdd_refs_internal_t tmp = mtbdd_refs_key;
+    SET_THREAD_LOCAL(mtbdd_refs_key, saved[LACE_WORKER_ID]);
+    saved[LACE_WORKER_ID] = tmp;
+}
+
+void*
+mtbdd_context_detach()
+{
+    struct mtbdd_context *c = (struct mtbdd_context*)malloc(sizeof(struct mtbdd_context));
+    c->initialized = mtbdd_initialized;
+    c->grey_type = mtbdd_grey_type;
+    c->refs = mtbdd_refs;
+    c->protected = mtbdd_protected;
+    c->protected_created = mtbdd_protected_created;
+    c->cl_registry = cl_registry;
+    c->cl_registry_count = cl_registry_count;
+    c->refs_key = (mtbdd_refs_internal_t*)calloc(lace_workers(), sizeof(mtbdd_refs_internal_t));
+
+    LACE_ME;
+    TOGETHER(mtbdd_refs_swap_task, c->refs_key);
+
+    // as after mtbdd_quit
+    memset(&mtbdd_refs, 0, sizeof(refs_table_t));
+    memset(&mtbdd_protected, 0, sizeof(refs_table_t));
+    mtbdd_protected_created = 0;
+    cl_registry = NULL;
+    cl_registry_count = 0;
+    mtbdd_initialized = 0;
+    return c;
+}
+
+void
+mtbdd_context_attach(void *context)
+{
+    struct mtbdd_context *c = (struct mtbdd_context*)context;
+    mtbdd_initialized = c->initialized;
+    mtbdd_grey_type = c->grey_type;
+    mtbdd_refs = c->refs;
+    mtbdd_protected = c->protected;
+    mtbdd_protected_created = c->protected_created;
+    cl_registry = c->cl_registry;
+    cl_registry_count = c->cl_registry_count;
+
+    LACE_ME;
+    TOGETHER(mtbdd_refs_swap_task, c->refs_key);
+    free(c->refs_key);
+    free(c);
+}
+
 void
 sylvan_init_mtbdd()
 {
@@ -406,6 +565,9 @@ sylvan_init_mtbdd()
     sylvan_register_quit(mtbdd_quit);
     sylvan_gc_add_mark(TASK(mtbdd_gc_mark_external_refs));
     sylvan_gc_add_mark(TASK(mtbdd_gc_mark_protected));
+    mtbdd_grey_type = sylvan_gc_register_grey(TASK(mtbdd_gc_mark_grey));
+    sylvan_gc_register_relocate(mtbdd_grey_type, TASK(mtbdd_gc_relocate_node));
+    sylvan_gc_add_relocate(TASK(mtbdd_gc_relocate_protected));
 
     refs_create(&mtbdd_refs, 1024);
     if (!mtbdd_protected_created) {
@@ -416,6 +578,53 @@ sylvan_init_mtbdd()
     LACE_ME;
     CALL(mtbdd_refs_init);
 
+    // which values in the operation cache are nodes, to keep entries during garbage collection
+    const int nodes2 = CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_RES;
+    const int nodes3 = CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_C | CACHE_NODE_RES;
+    cache_set_layout(CACHE_BDD_ITE, nodes3);
+    cache_set_layout(CACHE_BDD_AND, nodes3);
+    cache_set_layout(CACHE_BDD_XOR, nodes3);
+    cache_set_layout(CACHE_BDD_EXISTS, nodes2);
+    cache_set_layout(CACHE_BDD_AND_EXISTS, nodes3);
+    cache_set_layout(CACHE_BDD_RELNEXT, nodes3);
+    cache_set_layout(CACHE_BDD_RELPREV, nodes3);
+    cache_set_layout(CACHE_BDD_SATCOUNT, CACHE_NODE_A | CACHE_NODE_B); // result is a double
+    cache_set_layout(CACHE_BDD_COMPOSE, nodes2);
+    cache_set_layout(CACHE_BDD_RESTRICT, nodes2);
+    cache_set_layout(CACHE_BDD_CONSTRAIN, nodes2);
+    cache_set_layout(CACHE_BDD_CLOSURE, CACHE_NODE_A | CACHE_NODE_RES);
+    cache_set_layout(CACHE_BDD_ISBDD, CACHE_NODE_A);
+    cache_set_layout(CACHE_BDD_SUPPORT, CACHE_NODE_A | CACHE_NODE_RES);
+    cache_set_layout(CACHE_BDD_PATHCOUNT, CACHE_NODE_A); // result is a double
+    cache_set_layout(CACHE_MTBDD_APPLY, nodes2); // c is the operator
+    cache_set_layout(CACHE_MTBDD_ABSTRACT, nodes2); // c is the operator
+    cache_set_layout(CACHE_MTBDD_ITE, nodes3);
+    cache_set_layout(CACHE_MTBDD_AND_ABSTRACT_PLUS, nodes3);
+    cache_set_layout(CACHE_MTBDD_AND_ABSTRACT_MAX, nodes3);
+    cache_set_layout(CACHE_MTBDD_SUPPORT, CACHE_NODE_A | CACHE_NODE_RES);
+    cache_set_layout(CACHE_MTBDD_COMPOSE, nodes2);
+    cache_set_layout(CACHE_MTBDD_EQUAL_NORM, nodes2);
+    cache_set_layout(CACHE_MTBDD_EQUAL_NORM_REL, nodes2);
+    cache_set_layout(CACHE_MTBDD_MINIMUM, CACHE_NODE_A | CACHE_NODE_RES);
+    cache_set_layout(CACHE_MTBDD_MAXIMUM, CACHE_NODE_A | CACHE_NODE_RES);
+    cache_set_layout(CACHE_MTBDD_LEQ, nodes2);
+    cache_set_layout(CACHE_MTBDD_LESS, nodes2);
+    cache_set_layout(CACHE_MTBDD_GEQ, nodes2);
+    cache_set_layout(CACHE_MTBDD_GREATER, nodes2);
+    cache_set_layout(CACHE_MTBDD_EVAL_COMPOSE, nodes2); // c is the callback
+    // not CACHE_MTBDD_UAPPLY, since the parameter may be a node
+
+    // results of expensive operations are evicted less often from the operation cache
+    cache_set_priority(CACHE_BDD_EXISTS, 1);
+    cache_set_priority(CACHE_BDD_COMPOSE, 1);
+    cache_set_priority(CACHE_BDD_AND_EXISTS, 2);
+    cache_set_priority(CACHE_BDD_RELNEXT, 2);
+    cache_set_priority(CACHE_BDD_RELPREV, 2);
+    cache_set_priority(CACHE_MTBDD_ABSTRACT, 1);
+    cache_set_priority(CACHE_MTBDD_COMPOSE, 1);
+    cache_set_priority(CACHE_MTBDD_AND_ABSTRACT_PLUS, 2);
+    cache_set_priority(CACHE_MTBDD_AND_ABSTRACT_MAX, 2);
+
     cl_registry = NULL;
     cl_registry_count = 0;
 }
@@ -448,6 +657,8 @@ mtbdd_makeleaf(uint32_t type, uint64_t value)
     if (created) sylvan_stats_count(BDD_NODES_CREATED);
     else sylvan_stats_count(BDD_NODES_REUSED);
 
+    sylvan_gc_incremental_step(created);
+
     return (MTBDD)index;
 }
 
@@ -487,8 +698,14 @@ _mtbdd_makenode(uint32_t var, MTBDD low, MTBDD high)
         }
     }
 
-    if (created) sylvan_stats_count(BDD_NODES_CREATED);
-    else sylvan_stats_count(BDD_NODES_REUSED);
+    if (created) {
+        sylvan_stats_count(BDD_NODES_CREATED);
+        sylvan_level_index_created(var, index);
+    } else {
+        sylvan_stats_count(BDD_NODES_REUSED);
+    }
+
+    sylvan_gc_incremental_step(created);
 
     result = index;
     return mark ? result | mtbdd_complement : result;
@@ -521,12 +738,94 @@ mtbdd_makemapnode(uint32_t var, MTBDD low, MTBDD high)
         }
     }
 
-    if (created) sylvan_stats_count(BDD_NODES_CREATED);
-    else sylvan_stats_count(BDD_NODES_REUSED);
+    if (created) {
+        sylvan_stats_count(BDD_NODES_CREATED);
+        sylvan_level_index_created(var, index);
+    } else {
+        sylvan_stats_count(BDD_NODES_REUSED);
+    }
+
+    sylvan_gc_incremental_step(created);
 
     return index;
 }
 
+/* number of nodes that mtbdd_makenode_batch looks up in the nodes table at once */
+#define MTBDD_BATCH_SIZE 256
+
+void
+mtbdd_makenode_batch(size_t count, const uint32_t *vars, const MTBDD *lows, const MTBDD *highs, MTBDD *results)
+{
+    uint64_t a[MTBDD_BATCH_SIZE], b[MTBDD_BATCH_SIZE], index[MTBDD_BATCH_SIZE];
+    int created[MTBDD_BATCH_SIZE];
+    size_t pos[MTBDD_BATCH_SIZE];
+
+    size_t i = 0;
+    while (i < count) {
+        // collect the next nodes that are looked up in the nodes table
+        size_t n = 0;
+        for (; i<count && n<MTBDD_BATCH_SIZE; i++) {
+            MTBDD low = lows[i], high = highs[i];
+            if (low == high) {
+                results[i] = low;
+                continue;
+            }
+
+            // Normalization to keep canonicity (see _mtbdd_makenode)
+            int mark = MTBDD_HASMARK(low);
+            if (mark) {
+                low = MTBDD_TOGGLEMARK(low);
+                high = MTBDD_TOGGLEMARK(high);
+            }
+
+            struct mtbddnode node;
+            mtbddnode_makenode(&node, vars[i], low, high);
+            a[n] = node.a;
+            b[n] = node.b;
+            pos[n++] = i;
+            results[i] = mark ? mtbdd_complement : 0;
+        }
+
+        size_t done = 0;
+        int gc_done = 0;
+        while (done < n) {
+            size_t k = done + llmsset_lookup_batch(nodes, n-done, a+done, b+done, index+done, created+done);
+
+            for (; done<k; done++) {
+                results[pos[done]] |= index[done];
+                if (created[done]) {
+                    sylvan_stats_count(BDD_NODES_CREATED);
+                    sylvan_level_index_created(vars[pos[done]], index[done]);
+                } else {
+                    sylvan_stats_count(BDD_NODES_REUSED);
+                }
+                sylvan_gc_incremental_step(created[done]);
+                gc_done = 0;
+            }
+
+            if (done < n) {
+                LACE_ME;
+
+                if (gc_done) {
+                    fprintf(stderr, "BDD Unique table full, %zu of %zu buckets filled!\n", llmsset_count_marked(nodes), llmsset_get_size(nodes));
+                    exit(1);
+                }
+
+                // keep the nodes created so far and the children of the remaining nodes
+                const size_t first = pos[done];
+                for (size_t j=0; j<first; j++) mtbdd_refs_push(results[j]);
+                for (size_t j=first; j<count; j++) {
+                    mtbdd_refs_push(lows[j]);
+                    mtbdd_refs_push(highs[j]);
+                }
+                sylvan_gc();
+                mtbdd_refs_pop(first + 2*(count-first));
+                gc_done = 1;
+            }
+        }
+    }
+}
+
 /* Operations */
 
 /**
@@ -1054,7 +1353,7 @@ TASK_IMPL_3(MTBDD, mtbdd_abstract, MTBDD, a, MTBDD, v, mtbdd_abstract_op, op)
 
         /* Check cache */
         MTBDD result;
-        if (cache_get3(CACHE_MTBDD_ABSTRACT, a, v | (k << 40), (size_t)op, &result)) {
+        if (cache_get3(CACHE_MTBDD_ABSTRACT, a, v | (k << SYLVAN_INDEX_BITS), (size_t)op, &result)) {
             sylvan_stats_count(MTBDD_ABSTRACT_CACHED);
             return result;
         }
@@ -1063,7 +1362,7 @@ TASK_IMPL_3(MTBDD, mtbdd_abstract, MTBDD, a, MTBDD, v, mtbdd_abstract_op, op)
         result = WRAP(op, a, a, k);
 
         /* Store in cache */
-        if (cache_put3(CACHE_MTBDD_ABSTRACT, a, v | (k << 40), (size_t)op, result)) {
+        if (cache_put3(CACHE_MTBDD_ABSTRACT, a, v | (k << SYLVAN_INDEX_BITS), (size_t)op, result)) {
             sylvan_stats_count(MTBDD_ABSTRACT_CACHEDPUT);
         }
 
@@ -1085,7 +1384,7 @@ TASK_IMPL_3(MTBDD, mtbdd_abstract, MTBDD, a, MTBDD, v, mtbdd_abstract_op, op)
 
     /* Check cache */
     MTBDD result;
-    if (cache_get3(CACHE_MTBDD_ABSTRACT, a, v | (k << 40), (size_t)op, &result)) {
+    if (cache_get3(CACHE_MTBDD_ABSTRACT, a, v | (k << SYLVAN_INDEX_BITS), (size_t)op, &result)) {
         sylvan_stats_count(MTBDD_ABSTRACT_CACHED);
         return result;
     }
@@ -1114,7 +1413,7 @@ TASK_IMPL_3(MTBDD, mtbdd_abstract, MTBDD, a, MTBDD, v, mtbdd_abstract_op, op)
     }
 
     /* Store in cache */
-    if (cache_put3(CACHE_MTBDD_ABSTRACT, a, v | (k << 40), (size_t)op, result)) {
+    if (cache_put3(CACHE_MTBDD_ABSTRACT, a, v | (k << SYLVAN_INDEX_BITS), (size_t)op, result)) {
         sylvan_stats_count(MTBDD_ABSTRACT_CACHEDPUT);
     }
 
@@ -3342,6 +3641,10 @@ VOID_TASK_IMPL_3(mtbdd_writer_totext, FILE *, out, MTBDD *, dds, int, count)
  * Returns an array with the conversion from stored identifier to MTBDD
  * This array is allocated with malloc and must be freed afterwards.
  * This method does not support custom leaves.
+ *
+ * The leaves are created while reading. The internal nodes are created afterwards, ordered by
+ * their height (the length of the longest path to a leaf), such that all nodes of the same height
+ * are created with one call to mtbdd_makenode_batch.
  */
 TASK_IMPL_1(uint64_t*, mtbdd_reader_readbinary, FILE*, in)
 {
@@ -3351,35 +3654,89 @@ TASK_IMPL_1(uint64_t*, mtbdd_reader_readbinary, FILE*, in)
     }
 
     uint64_t *arr = malloc(sizeof(uint64_t)*(nodecount+1));
+    struct mtbddnode *stored = malloc(sizeof(struct mtbddnode)*(nodecount+1));
+    uint32_t *height = malloc(sizeof(uint32_t)*(nodecount+1));
+    uint32_t max_height = 0;
+
+    /* the stored identifier 0 is mtbdd_false (see mtbdd_writer_get) */
+    arr[0] = mtbdd_false;
+    height[0] = 0;
+
     for (size_t i=1; i<=nodecount; i++) {
-        struct mtbddnode node;
-        if (fread(&node, sizeof(struct mtbddnode), 1, in) != 1) {
+        struct mtbddnode *node = stored + i;
+        if (fread(node, sizeof(struct mtbddnode), 1, in) != 1) {
             free(arr);
+            free(stored);
+            free(height);
             return NULL;
         }
 
-        if (mtbddnode_isleaf(&node)) {
+        if (mtbddnode_isleaf(node)) {
             /* serialize leaf */
-            uint32_t type = mtbddnode_gettype(&node);
-            uint64_t value = mtbddnode_getvalue(&node);
+            uint32_t type = mtbddnode_gettype(node);
+            uint64_t value = mtbddnode_getvalue(node);
             if (type >= 3 && type < cl_registry_count) {
                 customleaf_t *c = cl_registry + type;
                 if (c->read_binary_cb != NULL) {
-                    if (c->read_binary_cb(in, type, value, &arr[i]) != 0) return NULL;
+                    if (c->read_binary_cb(in, type, value, &arr[i]) != 0) {
+                        free(arr);
+                        free(stored);
+                        free(height);
+                        return NULL;
+                    }
                 } else {
                     arr[i] = mtbdd_makeleaf(type, value);
                 }
             } else {
                 arr[i] = mtbdd_makeleaf(type, value);
             }
+            height[i] = 0;
         } else {
-            MTBDD low = arr[mtbddnode_getlow(&node)];
-            MTBDD high = mtbddnode_gethigh(&node);
-            high = MTBDD_TRANSFERMARK(high, arr[MTBDD_STRIPMARK(high)]);
-            arr[i] = mtbdd_makenode(mtbddnode_getvariable(&node), low, high);
+            uint32_t h_low = height[mtbddnode_getlow(node)];
+            uint32_t h_high = height[MTBDD_STRIPMARK(mtbddnode_gethigh(node))];
+            height[i] = (h_low > h_high ? h_low : h_high) + 1;
+            if (height[i] > max_height) max_height = height[i];
         }
     }
 
+    /* sort the internal nodes by height (counting sort), then create the nodes of each height in one batch */
+    size_t *end = calloc(max_height+1, sizeof(size_t));
+    for (size_t i=1; i<=nodecount; i++) if (height[i] != 0) end[height[i]]++;
+    for (uint32_t h=1; h<=max_height; h++) end[h] += end[h-1];
+    const size_t internal = end[max_height];
+
+    size_t *order = malloc(sizeof(size_t)*(internal+1));
+    uint32_t *vars = malloc(sizeof(uint32_t)*(internal+1));
+    MTBDD *lows = malloc(sizeof(MTBDD)*(internal+1));
+    MTBDD *highs = malloc(sizeof(MTBDD)*(internal+1));
+    MTBDD *results = malloc(sizeof(MTBDD)*(internal+1));
+
+    size_t *next = malloc(sizeof(size_t)*(max_height+1));
+    for (uint32_t h=1; h<=max_height; h++) next[h] = end[h-1];
+    for (size_t i=1; i<=nodecount; i++) if (height[i] != 0) order[next[height[i]]++] = i;
+
+    for (uint32_t h=1; h<=max_height; h++) {
+        for (size_t k=end[h-1]; k<end[h]; k++) {
+            struct mtbddnode *node = stored + order[k];
+            MTBDD high = mtbddnode_gethigh(node);
+            vars[k] = mtbddnode_getvariable(node);
+            lows[k] = arr[mtbddnode_getlow(node)];
+            highs[k] = MTBDD_TRANSFERMARK(high, arr[MTBDD_STRIPMARK(high)]);
+        }
+        mtbdd_makenode_batch(end[h]-end[h-1], vars+end[h-1], lows+end[h-1], highs+end[h-1], results+end[h-1]);
+        for (size_t k=end[h-1]; k<end[h]; k++) arr[order[k]] = results[k];
+    }
+
+    free(stored);
+    free(height);
+    free(end);
+    free(next);
+    free(order);
+    free(vars);
+    free(lows);
+    free(highs);
+    free(results);
+
     return arr;
 }
 
@@ -44,7 +44,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 /**
- * An MTBDD is a 64-bit value. The low 40 bits are an index into the unique table.
+ * An MTBDD is a 64-bit value. The low 40 bits (48 bits with SYLVAN_WIDE_INDEX) are an index into the unique table.
  * The highest 1 bit is the complement edge, indicating negation.
  * For Boolean MTBDDs, this means "not X", for Integer and Real MTBDDs, this means "-X".
  */
@@ -109,6 +109,7 @@ typedef MTBDD MTBDDMAP;
 #define sylvan_low              mtbdd_getlow
 #define sylvan_high             mtbdd_gethigh
 #define sylvan_makenode         mtbdd_makenode
+#define sylvan_makenode_batch   mtbdd_makenode_batch
 #define sylvan_makemapnode      mtbdd_makemapnode
 #define sylvan_support          mtbdd_support
 #define sylvan_test_isbdd       mtbdd_test_isvalid
@@ -143,6 +144,14 @@ static inline MTBDD mtbdd_makenode(uint32_t var, MTBDD low, MTBDD high)
     return low == high ? low : _mtbdd_makenode(var, low, high);
 }
 
+/**
+ * Create the <count> internal MTBDD nodes <vars[i], lows[i], highs[i]> and store them in <results>,
+ * i.e., results[i] = mtbdd_makenode(vars[i], lows[i], highs[i]).
+ * The nodes are looked up in the nodes table in batches (llmsset_lookup_batch), so the cache misses
+ * of different nodes overlap. The nodes must not depend on each other.
+ */
+void mtbdd_makenode_batch(size_t count, const uint32_t *vars, const MTBDD *lows, const MTBDD *highs, MTBDD *results);
+
 /**
  * Returns 1 is the MTBDD is a terminal, or 0 otherwise.
  */
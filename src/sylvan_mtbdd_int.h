@@ -25,11 +25,18 @@
 /**
  * BDD/MTBDD node structure
  */
+#if SYLVAN_COMPACT_NODES
+typedef struct __attribute__((packed)) mtbddnode {
+    uint64_t a;
+    uint32_t b;
+} * mtbddnode_t; // 12 bytes
+#else
 typedef struct __attribute__((packed)) mtbddnode {
     uint64_t a, b;
 } * mtbddnode_t; // 16 bytes
+#endif
 
-#define MTBDD_GETNODE(mtbdd) ((mtbddnode_t)llmsset_index_to_ptr(nodes, mtbdd&0x000000ffffffffff))
+#define MTBDD_GETNODE(mtbdd) ((mtbddnode_t)llmsset_index_to_ptr(nodes, mtbdd&SYLVAN_INDEX_MASK))
 
 /**
  * Complement handling macros
@@ -41,9 +48,110 @@ typedef struct __attribute__((packed)) mtbddnode {
 // Equal under mark
 #define MTBDD_EQUALM(a, b)            ((((a)^(b))&(~mtbdd_complement))==0)
 
+#if SYLVAN_COMPACT_NODES
+
+// Leaf: a = value; b = L=1, -, M, -, type (28 bits)
+// Node: a = high, low (32 bits each); b = L=0, C, M, P (map node), variable (24 bits)
+// Only complement edge on "high"
+
+static inline int __attribute__((unused))
+mtbddnode_isleaf(mtbddnode_t n)
+{
+    return n->b & 0x80000000 ? 1 : 0;
+}
+
+static inline uint32_t __attribute__((unused))
+mtbddnode_gettype(mtbddnode_t n)
+{
+    return n->b & 0x0fffffff;
+}
+
+static inline uint64_t __attribute__((unused))
+mtbddnode_getvalue(mtbddnode_t n)
+{
+    return n->a;
+}
+
+static inline int __attribute__((unused))
+mtbddnode_getcomp(mtbddnode_t n)
+{
+    return n->b & 0x40000000 ? 1 : 0;
+}
+
+static inline uint64_t __attribute__((unused))
+mtbddnode_getlow(mtbddnode_t n)
+{
+    return n->a & 0x00000000ffffffff;
+}
+
+static inline uint64_t __attribute__((unused))
+mtbddnode_gethigh(mtbddnode_t n)
+{
+    return (n->a >> 32) | ((uint64_t)(n->b & 0x40000000) << 33);
+}
+
+static inline uint32_t __attribute__((unused))
+mtbddnode_getvariable(mtbddnode_t n)
+{
+    return n->b & 0x00ffffff;
+}
+
+/**
+ * Change the variable of a node (only for nodes that are not hashed, e.g. during reordering)
+ */
+static inline void __attribute__((unused))
+mtbddnode_setvariable(mtbddnode_t n, uint32_t var)
+{
+    n->b = (n->b & 0xff000000) | var;
+}
+
+static inline int __attribute__((unused))
+mtbddnode_getmark(mtbddnode_t n)
+{
+    return n->b & 0x20000000 ? 1 : 0;
+}
+
+static inline void __attribute__((unused))
+mtbddnode_setmark(mtbddnode_t n, int mark)
+{
+    if (mark) n->b |= 0x20000000;
+    else n->b &= 0xdfffffff;
+}
+
+static inline void __attribute__((unused))
+mtbddnode_makeleaf(mtbddnode_t n, uint32_t type, uint64_t value)
+{
+    n->a = value;
+    n->b = 0x80000000 | type;
+}
+
+static inline void __attribute__((unused))
+mtbddnode_makenode(mtbddnode_t n, uint32_t var, uint64_t low, uint64_t high)
+{
+    n->a = (high << 32) | low;
+    n->b = var | (uint32_t)((high >> 33) & 0x40000000);
+}
+
+static inline void __attribute__((unused))
+mtbddnode_makemapnode(mtbddnode_t n, uint32_t var, uint64_t low, uint64_t high)
+{
+    mtbddnode_makenode(n, var, low, high);
+    n->b |= 0x10000000;
+}
+
+static inline int __attribute__((unused))
+mtbddnode_ismapnode(mtbddnode_t n)
+{
+    return n->b & 0x10000000 ? 1 : 0;
+}
+
+#else
+
 // Leaf: a = L=1, M, type; b = value
 // Node: a = L=0, C, M, high; b = variable, low
 // Only complement edge on "high"
+// The indices high and low have SYLVAN_INDEX_BITS bits. With 48-bit indices, the variable
+// (24 bits) is split: the low 16 bits are in b, the high 8 bits are in bits 48..55 of a.
 
 static inline int __attribute__((unused))
 mtbddnode_isleaf(mtbddnode_t n)
@@ -72,19 +180,37 @@ mtbddnode_getcomp(mtbddnode_t n)
 static inline uint64_t __attribute__((unused))
 mtbddnode_getlow(mtbddnode_t n)
 {
-    return n->b & 0x000000ffffffffff; // 40 bits
+    return n->b & SYLVAN_INDEX_MASK;
 }
 
 static inline uint64_t __attribute__((unused))
 mtbddnode_gethigh(mtbddnode_t n)
 {
-    return n->a & 0x800000ffffffffff; // 40 bits plus high bit of first
+    return n->a & (0x8000000000000000 | SYLVAN_INDEX_MASK); // index plus high bit of first
 }
 
 static inline uint32_t __attribute__((unused))
 mtbddnode_getvariable(mtbddnode_t n)
 {
+#if SYLVAN_WIDE_INDEX
+    return (uint32_t)(n->b >> 48) | (uint32_t)((n->a >> 32) & 0x00ff0000);
+#else
     return (uint32_t)(n->b >> 40);
+#endif
+}
+
+/**
+ * Change the variable of a node (only for nodes that are not hashed, e.g. during reordering)
+ */
+static inline void __attribute__((unused))
+mtbddnode_setvariable(mtbddnode_t n, uint32_t var)
+{
+#if SYLVAN_WIDE_INDEX
+    n->a = (n->a & 0xff00ffffffffffff) | ((uint64_t)(var & 0x00ff0000) << 32);
+    n->b = (n->b & SYLVAN_INDEX_MASK) | ((uint64_t)var << 48);
+#else
+    n->b = (n->b & SYLVAN_INDEX_MASK) | ((uint64_t)var << 40);
+#endif
 }
 
 static inline int __attribute__((unused))
@@ -110,15 +236,20 @@ mtbddnode_makeleaf(mtbddnode_t n, uint32_t type, uint64_t value)
 static inline void __attribute__((unused))
 mtbddnode_makenode(mtbddnode_t n, uint32_t var, uint64_t low, uint64_t high)
 {
+#if SYLVAN_WIDE_INDEX
+    n->a = high | ((uint64_t)(var & 0x00ff0000) << 32);
+    n->b = ((uint64_t)var)<<48 | low;
+#else
     n->a = high;
     n->b = ((uint64_t)var)<<40 | low;
+#endif
 }
 
 static inline void __attribute__((unused))
 mtbddnode_makemapnode(mtbddnode_t n, uint32_t var, uint64_t low, uint64_t high)
 {
-    n->a = high | 0x1000000000000000;
-    n->b = ((uint64_t)var)<<40 | low;
+    mtbddnode_makenode(n, var, low, high);
+    n->a |= 0x1000000000000000;
 }
 
 static inline int __attribute__((unused))
@@ -127,6 +258,8 @@ mtbddnode_ismapnode(mtbddnode_t n)
     return n->a & 0x1000000000000000 ? 1 : 0;
 }
 
+#endif
+
 static MTBDD __attribute__((unused))
 mtbddnode_followlow(MTBDD mtbdd, mtbddnode_t node)
 {
@@ -37,11 +37,13 @@
 
 /**
  * Implementation of external references
- * Based on a hash table for 40-bit non-null values, linear probing
+ * Based on a hash table for non-null node indices (SYLVAN_INDEX_BITS bits), linear probing
  * Use tombstones for deleting, higher bits for reference count
  */
 static const uint64_t refs_ts = 0x7fffffffffffffff; // tombstone
 
+#define REFS_COUNT_MAX (0x7fffffffffffffff >> SYLVAN_INDEX_BITS) // the count sticks at this value
+
 /* FNV-1a 64-bit hash */
 static inline uint64_t
 fnv_hash(uint64_t a)
@@ -73,7 +75,7 @@ refs_rehash(refs_table_t *tbl, uint64_t v)
     if (v == 0) return; // do not rehash empty value
     if (v == refs_ts) return; // do not rehash tombstone
 
-    volatile uint64_t *bucket = tbl->refs_table + (fnv_hash(v & 0x000000ffffffffff) % tbl->refs_size);
+    volatile uint64_t *bucket = tbl->refs_table + (fnv_hash(v & SYLVAN_INDEX_MASK) % tbl->refs_size);
     uint64_t * const end = tbl->refs_table + tbl->refs_size;
 
     int i = 128; // try 128 times linear probing
@@ -213,16 +215,16 @@ ref_restart:
                 ts_bucket = NULL;
                 v = refs_ts;
             }
-            new_v = a | (1ULL << 40);
+            new_v = a | (1ULL << SYLVAN_INDEX_BITS);
             goto ref_mod;
-        } else if ((v & 0x000000ffffffffff) == a) {
+        } else if ((v & SYLVAN_INDEX_MASK) == a) {
             // found
             res = 1;
-            uint64_t count = v >> 40;
-            if (count == 0x7fffff) goto ref_exit;
+            uint64_t count = v >> SYLVAN_INDEX_BITS;
+            if (count == REFS_COUNT_MAX) goto ref_exit;
             count += dir;
             if (count == 0) new_v = refs_ts;
-            else new_v = a | (count << 40);
+            else new_v = a | (count << SYLVAN_INDEX_BITS);
             goto ref_mod;
         }
 
@@ -237,7 +239,7 @@ ref_restart:
         bucket = ts_bucket;
         ts_bucket = NULL;
         v = refs_ts;
-        new_v = a | (1ULL << 40);
+        new_v = a | (1ULL << SYLVAN_INDEX_BITS);
         if (!cas(bucket, v, new_v)) goto ref_retry;
         res = 1;
         goto ref_exit;
@@ -293,7 +295,7 @@ refs_next(refs_table_t *tbl, uint64_t **_bucket, size_t end)
     uint64_t *bucket = *_bucket;
     // assert(bucket != NULL);
     // assert(end <= tbl->refs_size);
-    uint64_t result = *bucket & 0x000000ffffffffff;
+    uint64_t result = *bucket & SYLVAN_INDEX_MASK;
     bucket++;
     while (bucket != tbl->refs_table + end) {
         if (*bucket != 0 && *bucket != refs_ts) {
@@ -27,7 +27,7 @@ extern "C" {
 
 /**
  * Implementation of external references
- * Based on a hash table for 40-bit non-null values, linear probing
+ * Based on a hash table for non-null node indices (SYLVAN_INDEX_BITS bits), linear probing
  * Use tombstones for deleting, higher bits for reference count
  */
 typedef struct
@@ -46,7 +46,7 @@ typedef struct
 // Count number of unique entries (not number of references)
 size_t refs_count(refs_table_t *tbl);
 
-// Increase or decrease reference to 40-bit value a
+// Increase or decrease reference to node index a
 // Will fail (assertion) if more down than up are called for a
 void refs_up(refs_table_t *tbl, uint64_t a);
 void refs_down(refs_table_t *tbl, uint64_t a);
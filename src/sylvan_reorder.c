@@ -0,0 +1,831 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_config.h>
+
+#include <errno.h>  // for errno
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // for strerror
+#include <sys/mman.h> // for mmap
+
+#include <sylvan.h>
+#include <sylvan_int.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/**
+ * Variable reordering swaps adjacent levels in place, as follows.
+ *
+ * First, the referenced MTBDDs are collected during garbage collection: every node that is
+ * reachable from a reference is tracked, with the number of edges from tracked nodes to it.
+ * Then, to swap level i (variable x) and level i+1 (variable y):
+ * - nodes at level i that do not have children at level i+1 simply move to level i+1;
+ * - nodes at level i+1 move to level i;
+ * - the other nodes F at level i are rewritten in place: with F = x ? (y ? f11 : f10) : (y ? f01 : f00),
+ *   F becomes y ? (x ? f11 : f01) : (x ? f10 : f00), creating the new nodes at level i+1 in the table;
+ * - nodes that are no longer reachable are removed from the table.
+ * A node that moves or is rewritten is first removed from the hash array (llmsset_unhash)
+ * and then hashed again (llmsset_rehash_bucket). Node indices and functions do not change.
+ */
+
+int sylvan_reorder_collecting = 0;
+
+/**
+ * Mapping between variables and levels (identity beyond levels_size)
+ */
+static uint32_t *level_to_var = NULL;
+static uint32_t *var_to_level = NULL;
+static size_t levels_size = 0;
+
+/**
+ * For every node: tracked (REF_NODE), referenced (REF_ROOT) and the number of edges to it.
+ * A tracked node dies when it is not referenced and has no edges to it.
+ */
+#define REF_NODE  ((uint32_t)0x80000000)
+#define REF_ROOT  ((uint32_t)0x40000000)
+#define REF_COUNT ((uint32_t)0x3fffffff)
+
+static uint32_t *node_refs = NULL;
+static size_t node_refs_size = 0;
+
+/**
+ * The tracked nodes of every level (may contain nodes that died since).
+ */
+typedef struct level_nodes
+{
+    uint64_t *nodes;
+    size_t count;
+    size_t capacity;
+} level_nodes_t;
+
+static level_nodes_t *levels = NULL;
+static uint32_t nlevels = 0;
+static uint32_t levels_capacity = 0;
+
+static volatile size_t reorder_size;        // number of tracked nodes
+static volatile size_t reorder_used;        // number of used buckets in the nodes table
+static volatile size_t reorder_tombstones;  // number of removed hashes since garbage collection
+
+/**
+ * Automatic reordering
+ */
+static size_t reorder_threshold = 0;
+static volatile int reorder_requested = 0;
+static int reordering = 0;
+
+uint32_t
+sylvan_var_to_level(uint32_t var)
+{
+    return var < levels_size ? var_to_level[var] : var;
+}
+
+uint32_t
+sylvan_level_to_var(uint32_t level)
+{
+    return level < levels_size ? level_to_var[level] : level;
+}
+
+void
+sylvan_set_reorder_threshold(size_t threshold)
+{
+    reorder_threshold = threshold;
+}
+
+int
+sylvan_reorder_requested()
+{
+    return reorder_requested;
+}
+
+/**
+ * Extend the variable mapping (identity) to <count> levels
+ */
+static void
+reorder_extend_map(size_t count)
+{
+    if (count <= levels_size) return;
+    level_to_var = (uint32_t*)realloc(level_to_var, sizeof(uint32_t) * count);
+    var_to_level = (uint32_t*)realloc(var_to_level, sizeof(uint32_t) * count);
+    if (level_to_var == NULL || var_to_level == NULL) {
+        fprintf(stderr, "sylvan_reorder: Unable to allocate memory!\n");
+        exit(1);
+    }
+    for (size_t i=levels_size; i<count; i++) level_to_var[i] = var_to_level[i] = i;
+    levels_size = count;
+}
+
+/**
+ * Extend the level lists to <count> levels
+ */
+static void
+reorder_extend_levels(uint32_t count)
+{
+    reorder_extend_map(count);
+    if (count > levels_capacity) {
+        levels = (level_nodes_t*)realloc(levels, sizeof(level_nodes_t) * count);
+        if (levels == NULL) {
+            fprintf(stderr, "sylvan_reorder: Unable to allocate memory!\n");
+            exit(1);
+        }
+        memset(levels + levels_capacity, 0, sizeof(level_nodes_t) * (count - levels_capacity));
+        levels_capacity = count;
+    }
+    if (count > nlevels) nlevels = count;
+}
+
+static void
+level_push(level_nodes_t *l, uint64_t index)
+{
+    if (l->count == l->capacity) {
+        l->capacity = l->capacity == 0 ? 64 : l->capacity * 2;
+        l->nodes = (uint64_t*)realloc(l->nodes, sizeof(uint64_t) * l->capacity);
+        if (l->nodes == NULL) {
+            fprintf(stderr, "sylvan_reorder: Unable to allocate memory!\n");
+            exit(1);
+        }
+    }
+    l->nodes[l->count++] = index;
+}
+
+/**
+ * Remove the nodes that died from a level list
+ */
+static void
+level_filter(level_nodes_t *l)
+{
+    size_t j = 0;
+    for (size_t k=0; k<l->count; k++) {
+        if (node_refs[l->nodes[k]] & REF_NODE) l->nodes[j++] = l->nodes[k];
+    }
+    l->count = j;
+}
+
+/**
+ * Returns 1 if <index> is an internal MTBDD node (not a leaf)
+ */
+static inline int
+reorder_isnode(uint64_t index)
+{
+    return index >= 2 && !mtbddnode_isleaf(MTBDD_GETNODE(index));
+}
+
+void
+sylvan_reorder_add_root(uint64_t dd)
+{
+    const uint64_t index = dd & SYLVAN_INDEX_MASK;
+    if (index < 2) return;
+    if (!(node_refs[index] & REF_ROOT)) __sync_fetch_and_or(node_refs + index, REF_ROOT);
+}
+
+static inline void
+reorder_ref(uint64_t dd)
+{
+    const uint64_t index = dd & SYLVAN_INDEX_MASK;
+    if (reorder_isnode(index)) __sync_fetch_and_add(node_refs + index, 1);
+}
+
+/**
+ * Remove an edge to <dd>; if the node dies, it is removed from the hash array
+ * (the data bucket is freed by the next garbage collection).
+ */
+static void
+reorder_deref(uint64_t dd)
+{
+    const uint64_t index = dd & SYLVAN_INDEX_MASK;
+    if (!reorder_isnode(index)) return;
+    if ((__sync_sub_and_fetch(node_refs + index, 1) & (REF_ROOT | REF_COUNT)) != 0) return;
+
+    node_refs[index] = 0;
+    if (llmsset_unhash(nodes, index)) __sync_fetch_and_add(&reorder_tombstones, 1);
+    __sync_fetch_and_sub(&reorder_size, 1);
+
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    reorder_deref(mtbddnode_getlow(n));
+    reorder_deref(mtbddnode_gethigh(n));
+}
+
+/**
+ * Track all nodes reachable from <index>
+ */
+VOID_TASK_1(reorder_visit, uint64_t, index)
+{
+    if (!reorder_isnode(index)) return;
+    if (__sync_fetch_and_or(node_refs + index, REF_NODE) & REF_NODE) return;
+
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    const uint64_t low = mtbddnode_getlow(n);
+    const uint64_t high = mtbddnode_gethigh(n) & SYLVAN_INDEX_MASK;
+    reorder_ref(low);
+    reorder_ref(high);
+    SPAWN(reorder_visit, low);
+    CALL(reorder_visit, high);
+    SYNC(reorder_visit);
+}
+
+VOID_TASK_2(reorder_visit_roots, size_t, first, size_t, count)
+{
+    if (count > 4096) {
+        SPAWN(reorder_visit_roots, first, count/2);
+        CALL(reorder_visit_roots, first+count/2, count-count/2);
+        SYNC(reorder_visit_roots);
+    } else {
+        for (size_t k=first; k<first+count; k++) {
+            if (node_refs[k] & REF_ROOT) CALL(reorder_visit, k);
+        }
+    }
+}
+
+/**
+ * Collect the referenced nodes with garbage collection and build the level lists
+ */
+VOID_TASK_0(reorder_collect)
+{
+    // clear node_refs
+    if (mmap(node_refs, node_refs_size * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == (void*)-1) {
+        memset(node_refs, 0, node_refs_size * sizeof(uint32_t));
+    }
+
+    // with incremental marking, nodes that died during marking are also marked: collect twice
+    const int twice = sylvan_gc_marking != 0;
+    sylvan_reorder_collecting = 1;
+    CALL(sylvan_gc_go);
+    if (twice) CALL(sylvan_gc_go);
+    sylvan_reorder_collecting = 0;
+
+    const size_t size = llmsset_get_size(nodes);
+    CALL(reorder_visit_roots, 2, size-2);
+
+    for (uint32_t i=0; i<nlevels; i++) levels[i].count = 0;
+    size_t count = 0;
+    for (size_t k=2; k<size; k++) {
+        if (node_refs[k] & REF_NODE) {
+            const uint32_t level = mtbddnode_getvariable(MTBDD_GETNODE(k));
+            if (level >= nlevels) reorder_extend_levels(level+1);
+            level_push(levels + level, k);
+            count++;
+        }
+    }
+
+    reorder_size = count;
+    reorder_used = llmsset_count_marked(nodes);
+    reorder_tombstones = 0;
+}
+
+/**
+ * Change the level of node <index> (which is not hashed) and hash it again
+ */
+static inline void
+reorder_relabel(uint64_t index, uint32_t level)
+{
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    mtbddnode_setvariable(n, level);
+    if (llmsset_rehash_bucket(nodes, index) == 2) __sync_fetch_and_sub(&reorder_tombstones, 1);
+}
+
+static inline void
+reorder_unhash(uint64_t index)
+{
+    if (llmsset_unhash(nodes, index)) __sync_fetch_and_add(&reorder_tombstones, 1);
+}
+
+/**
+ * Returns 1 if <dd> is a (map) node at <level>
+ */
+static inline int
+reorder_at_level(uint64_t dd, uint32_t level, int map)
+{
+    const uint64_t index = dd & SYLVAN_INDEX_MASK;
+    if (!reorder_isnode(index)) return 0;
+    mtbddnode_t n = MTBDD_GETNODE(index);
+    return mtbddnode_getvariable(n) == level && mtbddnode_ismapnode(n) == map;
+}
+
+/**
+ * The state of a swap, shared by the workers
+ */
+typedef struct reorder_swap
+{
+    uint32_t level;         // swap level and level+1
+    uint64_t *x;            // nodes at level
+    uint8_t *kind;          // for every x: bit 0 if low is at level+1, bit 1 if high is at level+1
+    uint64_t *g;            // for every x: the two new children
+    uint64_t *created;      // tracked nodes created at level+1
+    volatile size_t created_count;
+} reorder_swap_t;
+
+/**
+ * Find or create the node (level, low, high) at level+1 and add an edge to it
+ */
+static uint64_t
+reorder_make(reorder_swap_t *s, int map, uint64_t low, uint64_t high)
+{
+    if (!map && low == high) {
+        reorder_ref(low);
+        return low;
+    }
+
+    int mark = 0;
+    if (MTBDD_HASMARK(low)) {
+        mark = 1;
+        low = MTBDD_TOGGLEMARK(low);
+        high = MTBDD_TOGGLEMARK(high);
+    }
+
+    struct mtbddnode n;
+    if (map) mtbddnode_makemapnode(&n, s->level+1, low, high);
+    else mtbddnode_makenode(&n, s->level+1, low, high);
+
+    int created;
+    uint64_t index = llmsset_lookup(nodes, n.a, n.b, &created);
+    if (index == 0) {
+        fprintf(stderr, "sylvan_reorder: Unique table full, %zu of %zu buckets filled!\n", reorder_used, llmsset_get_size(nodes));
+        exit(1);
+    }
+    if (created) __sync_fetch_and_add(&reorder_used, 1);
+
+    __sync_fetch_and_add(node_refs + index, 1);
+    if (!(__sync_fetch_and_or(node_refs + index, REF_NODE) & REF_NODE)) {
+        // a new tracked node
+        s->created[__sync_fetch_and_add(&s->created_count, 1)] = index;
+        __sync_fetch_and_add(&reorder_size, 1);
+        reorder_ref(low);
+        reorder_ref(high);
+    }
+
+    return mark ? index | mtbdd_complement : index;
+}
+
+/**
+ * Phase 1: classify the nodes at level, unhash them, and move the nodes without children
+ * at level+1 to level+1.
+ */
+VOID_TASK_3(reorder_swap_classify, reorder_swap_t*, s, size_t, first, size_t, count)
+{
+    if (count > 256) {
+        SPAWN(reorder_swap_classify, s, first, count/2);
+        CALL(reorder_swap_classify, s, first+count/2, count-count/2);
+        SYNC(reorder_swap_classify);
+        return;
+    }
+
+    const uint32_t level = s->level;
+    for (size_t k=first; k<first+count; k++) {
+        const uint64_t index = s->x[k];
+        mtbddnode_t n = MTBDD_GETNODE(index);
+        uint8_t kind = 0;
+        if (mtbddnode_ismapnode(n)) {
+            // only the rest of the map (low) is at the next level
+            if (reorder_at_level(mtbddnode_getlow(n), level+1, 1)) kind = 1;
+        } else {
+            if (reorder_at_level(mtbddnode_getlow(n), level+1, 0)) kind |= 1;
+            if (reorder_at_level(mtbddnode_gethigh(n), level+1, 0)) kind |= 2;
+        }
+        s->kind[k] = kind;
+        reorder_unhash(index);
+        if (kind == 0) reorder_relabel(index, level+1);
+    }
+}
+
+/**
+ * Phase 2: move the nodes at level+1 to level.
+ */
+VOID_TASK_4(reorder_swap_lift, uint64_t*, y, uint32_t, level, size_t, first, size_t, count)
+{
+    if (count > 256) {
+        SPAWN(reorder_swap_lift, y, level, first, count/2);
+        CALL(reorder_swap_lift, y, level, first+count/2, count-count/2);
+        SYNC(reorder_swap_lift);
+        return;
+    }
+
+    for (size_t k=first; k<first+count; k++) {
+        reorder_unhash(y[k]);
+        reorder_relabel(y[k], level);
+    }
+}
+
+/**
+ * Phase 3: create the new children of the nodes at level that depend on level+1.
+ */
+VOID_TASK_3(reorder_swap_create, reorder_swap_t*, s, size_t, first, size_t, count)
+{
+    if (count > 256) {
+        SPAWN(reorder_swap_create, s, first, count/2);
+        CALL(reorder_swap_create, s, first+count/2, count-count/2);
+        SYNC(reorder_swap_create);
+        return;
+    }
+
+    for (size_t k=first; k<first+count; k++) {
+        const uint8_t kind = s->kind[k];
+        if (kind == 0) continue;
+        mtbddnode_t n = MTBDD_GETNODE(s->x[k]);
+        const uint64_t f0 = mtbddnode_getlow(n);
+        const uint64_t f1 = mtbddnode_gethigh(n);
+        if (mtbddnode_ismapnode(n)) {
+            // x->f1, y->b, rest becomes y->b, x->f1, rest
+            mtbddnode_t rest = MTBDD_GETNODE(f0);
+            s->g[2*k] = reorder_make(s, 1, mtbddnode_getlow(rest), f1);
+            s->g[2*k+1] = mtbddnode_gethigh(rest);
+            reorder_ref(s->g[2*k+1]);
+        } else {
+            uint64_t f00 = f0, f01 = f0, f10 = f1, f11 = f1;
+            if (kind & 1) {
+                mtbddnode_t n0 = MTBDD_GETNODE(f0);
+                f00 = mtbddnode_followlow(f0, n0);
+                f01 = mtbddnode_followhigh(f0, n0);
+            }
+            if (kind & 2) {
+                mtbddnode_t n1 = MTBDD_GETNODE(f1);
+                f10 = mtbddnode_followlow(f1, n1);
+                f11 = mtbddnode_followhigh(f1, n1);
+            }
+            s->g[2*k] = reorder_make(s, 0, f00, f10);
+            s->g[2*k+1] = reorder_make(s, 0, f01, f11);
+        }
+    }
+}
+
+/**
+ * Phase 4: rewrite the nodes at level that depend on level+1, and remove the old edges.
+ */
+VOID_TASK_3(reorder_swap_rewrite, reorder_swap_t*, s, size_t, first, size_t, count)
+{
+    if (count > 256) {
+        SPAWN(reorder_swap_rewrite, s, first, count/2);
+        CALL(reorder_swap_rewrite, s, first+count/2, count-count/2);
+        SYNC(reorder_swap_rewrite);
+        return;
+    }
+
+    for (size_t k=first; k<first+count; k++) {
+        if (s->kind[k] == 0) continue;
+        const uint64_t index = s->x[k];
+        mtbddnode_t n = MTBDD_GETNODE(index);
+        const uint64_t f0 = mtbddnode_getlow(n);
+        const uint64_t f1 = mtbddnode_gethigh(n);
+        // the new low child has no mark, as f0 has no mark
+        if (mtbddnode_ismapnode(n)) mtbddnode_makemapnode(n, s->level, s->g[2*k], s->g[2*k+1]);
+        else mtbddnode_makenode(n, s->level, s->g[2*k], s->g[2*k+1]);
+        if (llmsset_rehash_bucket(nodes, index) == 2) __sync_fetch_and_sub(&reorder_tombstones, 1);
+        reorder_deref(f0);
+        reorder_deref(f1);
+    }
+}
+
+/**
+ * Swap the variables at <level> and <level+1>.
+ * Returns 0 if there is not enough space in the nodes table.
+ */
+TASK_1(int, reorder_swap, uint32_t, level)
+{
+    level_nodes_t *lx = levels + level;
+    level_nodes_t *ly = levels + level + 1;
+
+    // make sure that the new nodes fit (at most 2 for every node at level)
+    const size_t size = llmsset_get_size(nodes);
+    level_filter(lx);
+    if (reorder_used + 2*lx->count > size/4*3 || reorder_tombstones > size/8) {
+        CALL(reorder_collect);
+        lx = levels + level;
+        ly = levels + level + 1;
+        if (reorder_used + 2*lx->count > llmsset_get_size(nodes)/4*3) return 0;
+    }
+    level_filter(ly);
+
+    reorder_swap_t s;
+    s.level = level;
+    s.x = lx->nodes;
+    s.kind = (uint8_t*)malloc(lx->count + 1);
+    s.g = (uint64_t*)malloc(sizeof(uint64_t) * (2*lx->count + 1));
+    s.created = (uint64_t*)malloc(sizeof(uint64_t) * (2*lx->count + 1));
+    s.created_count = 0;
+    if (s.kind == NULL || s.g == NULL || s.created == NULL) {
+        fprintf(stderr, "sylvan_reorder: Unable to allocate memory!\n");
+        exit(1);
+    }
+
+    CALL(reorder_swap_classify, &s, 0, lx->count);
+    CALL(reorder_swap_lift, ly->nodes, level, 0, ly->count);
+    CALL(reorder_swap_create, &s, 0, lx->count);
+    CALL(reorder_swap_rewrite, &s, 0, lx->count);
+
+    // the new level: the nodes from level+1 (that are still alive) and the rewritten nodes
+    level_nodes_t new_x = {NULL, 0, 0}, new_y = {NULL, 0, 0};
+    for (size_t k=0; k<ly->count; k++) {
+        if (node_refs[ly->nodes[k]] & REF_NODE) level_push(&new_x, ly->nodes[k]);
+    }
+    for (size_t k=0; k<lx->count; k++) {
+        if (s.kind[k] != 0) level_push(&new_x, lx->nodes[k]);
+        else level_push(&new_y, lx->nodes[k]);
+    }
+    for (size_t k=0; k<s.created_count; k++) level_push(&new_y, s.created[k]);
+
+    free(lx->nodes);
+    free(ly->nodes);
+    *lx = new_x;
+    *ly = new_y;
+
+    free(s.kind);
+    free(s.g);
+    free(s.created);
+
+    // update the variable mapping
+    const uint32_t var_x = level_to_var[level];
+    const uint32_t var_y = level_to_var[level+1];
+    level_to_var[level] = var_y;
+    level_to_var[level+1] = var_x;
+    var_to_level[var_y] = level;
+    var_to_level[var_x] = level+1;
+
+    return 1;
+}
+
+/**
+ * Start and finish a reordering (inside the stop-the-world frame)
+ */
+VOID_TASK_0(reorder_start)
+{
+    sylvan_stats_count(SYLVAN_REORDER_COUNT);
+    sylvan_timer_start(SYLVAN_REORDER);
+
+    reordering = 1;
+
+    node_refs_size = llmsset_get_max_size(nodes);
+    node_refs = (uint32_t*)mmap(0, node_refs_size * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (node_refs == (uint32_t*)-1) {
+        fprintf(stderr, "sylvan_reorder: Unable to allocate memory: %s!\n", strerror(errno));
+        exit(1);
+    }
+
+    CALL(reorder_collect);
+}
+
+VOID_TASK_1(reorder_finish, int, online_resize)
+{
+    // remove the dead nodes and the removed hashes; results in the operation cache may depend on the order
+    CALL(sylvan_gc_go);
+    CALL(sylvan_clear_cache);
+
+    // the levels of the nodes changed, so the per-level node index is rebuilt
+    if (sylvan_level_index_enabled) {
+        sylvan_level_index_reset();
+        for (uint32_t i=0; i<nlevels; i++) {
+            for (size_t k=0; k<levels[i].count; k++) {
+                const uint64_t index = levels[i].nodes[k];
+                if (node_refs[index] & REF_NODE) sylvan_level_index_add(i, index);
+            }
+        }
+    }
+
+    for (uint32_t i=0; i<levels_capacity; i++) free(levels[i].nodes);
+    free(levels);
+    levels = NULL;
+    levels_capacity = nlevels = 0;
+
+    munmap(node_refs, node_refs_size * sizeof(uint32_t));
+    node_refs = NULL;
+
+    llmsset_set_online_resize(nodes, online_resize);
+
+    if (reorder_threshold != 0 && reorder_threshold < 2*llmsset_count_marked(nodes)) {
+        reorder_threshold = 2*llmsset_count_marked(nodes);
+    }
+    reorder_requested = 0;
+    reordering = 0;
+
+    sylvan_timer_stop(SYLVAN_REORDER);
+}
+
+/**
+ * Sifting
+ */
+
+static size_t *sift_counts;
+
+static int
+sift_compare(const void *a, const void *b)
+{
+    const size_t ca = sift_counts[*(const uint32_t*)a];
+    const size_t cb = sift_counts[*(const uint32_t*)b];
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+/**
+ * Move the variable at <level> to <target>; returns the level where it ended
+ */
+TASK_2(uint32_t, sift_move, uint32_t, level, uint32_t, target)
+{
+    while (level > target && CALL(reorder_swap, level-1)) level--;
+    while (level < target && CALL(reorder_swap, level)) level++;
+    return level;
+}
+
+/**
+ * Move the variable at <level> towards <end> while the size does not grow too much.
+ * Updates <best_size> and <best_level>; returns the level where it ended.
+ */
+TASK_4(uint32_t, sift_dir, uint32_t, level, uint32_t, end, size_t*, best_size, uint32_t*, best_level)
+{
+    while (level != end) {
+        const uint32_t next = level < end ? level+1 : level-1;
+        if (!CALL(reorder_swap, level < end ? level : level-1)) break;
+        level = next;
+        if (reorder_size < *best_size) {
+            *best_size = reorder_size;
+            *best_level = level;
+        } else if (reorder_size * 100 > *best_size * SYLVAN_REORDER_MAXGROWTH) {
+            break;
+        }
+    }
+    return level;
+}
+
+VOID_TASK_1(sylvan_reorder_sift, int*, online_resize)
+{
+    CALL(reorder_start);
+
+    if (nlevels > 1) {
+        // sift the variables with the most nodes first
+        const uint32_t n = nlevels;
+        uint32_t *vars = (uint32_t*)malloc(sizeof(uint32_t) * n);
+        sift_counts = (size_t*)malloc(sizeof(size_t) * n);
+        if (vars == NULL || sift_counts == NULL) {
+            fprintf(stderr, "sylvan_reorder: Unable to allocate memory!\n");
+            exit(1);
+        }
+        for (uint32_t i=0; i<n; i++) {
+            vars[i] = i;
+            sift_counts[i] = levels[i].count;
+        }
+        qsort(vars, n, sizeof(uint32_t), sift_compare);
+        for (uint32_t i=0; i<n; i++) vars[i] = level_to_var[vars[i]];
+        free(sift_counts);
+
+        for (uint32_t i=0; i<n; i++) {
+            uint32_t level = var_to_level[vars[i]];
+            if (levels[level].count == 0) continue;
+
+            size_t best_size = reorder_size;
+            uint32_t best_level = level;
+
+            // first towards the nearest end
+            if (level < n-1-level) {
+                level = CALL(sift_dir, level, 0, &best_size, &best_level);
+                level = CALL(sift_dir, level, n-1, &best_size, &best_level);
+            } else {
+                level = CALL(sift_dir, level, n-1, &best_size, &best_level);
+                level = CALL(sift_dir, level, 0, &best_size, &best_level);
+            }
+            CALL(sift_move, level, best_level);
+        }
+
+        free(vars);
+    }
+
+    CALL(reorder_finish, *online_resize);
+}
+
+VOID_TASK_3(sylvan_reorder_perm_go, const uint32_t*, vars, size_t, count, int*, online_resize)
+{
+    CALL(reorder_start);
+
+    // the levels of all given variables must be in the level lists
+    uint32_t n = nlevels;
+    for (size_t i=0; i<count; i++) {
+        reorder_extend_map(vars[i] + 1);
+        if (var_to_level[vars[i]] >= n) n = var_to_level[vars[i]] + 1;
+    }
+    if (count > n) n = count;
+    reorder_extend_levels(n);
+
+    for (size_t i=0; i<count; i++) {
+        const uint32_t level = var_to_level[vars[i]];
+        if (level < i) continue; // variable given twice
+        if (CALL(sift_move, level, i) != i) break; // not enough space
+    }
+
+    CALL(reorder_finish, *online_resize);
+}
+
+/**
+ * The online resize of the nodes table is disabled during reordering;
+ * the nodes table is only resized during garbage collection.
+ */
+static int
+reorder_begin(void)
+{
+    const int online_resize = nodes->online_resize;
+    llmsset_set_online_resize(nodes, 0);
+    return online_resize;
+}
+
+VOID_TASK_IMPL_0(sylvan_reorder)
+{
+    if (!sylvan_gc_is_enabled()) return;
+    int online_resize = reorder_begin();
+    NEWFRAME(sylvan_reorder_sift, &online_resize);
+}
+
+VOID_TASK_IMPL_2(sylvan_reorder_perm, const uint32_t*, vars, size_t, count)
+{
+    if (!sylvan_gc_is_enabled()) return;
+    int online_resize = reorder_begin();
+    NEWFRAME(sylvan_reorder_perm_go, vars, count, &online_resize);
+}
+
+/**
+ * Request reordering after garbage collection when too many nodes are in use
+ */
+VOID_TASK_0(reorder_postgc)
+{
+    if (reorder_threshold == 0 || reordering) return;
+    if (llmsset_count_marked(nodes) > reorder_threshold) reorder_requested = 1;
+}
+
+static int reorder_initialized = 0;
+
+static void
+reorder_quit()
+{
+    free(level_to_var);
+    free(var_to_level);
+    level_to_var = var_to_level = NULL;
+    levels_size = 0;
+    reorder_threshold = 0;
+    reorder_requested = 0;
+
+    reorder_initialized = 0;
+}
+
+/**
+ * The variable order of a detached context (see sylvan_context_detach)
+ */
+struct reorder_context
+{
+    int initialized;
+    uint32_t *level_to_var;
+    uint32_t *var_to_level;
+    size_t levels_size;
+    size_t threshold;
+    int requested;
+};
+
+void*
+sylvan_reorder_context_detach()
+{
+    struct reorder_context *c = (struct reorder_context*)malloc(sizeof(struct reorder_context));
+    c->initialized = reorder_initialized;
+    c->level_to_var = level_to_var;
+    c->var_to_level = var_to_level;
+    c->levels_size = levels_size;
+    c->threshold = reorder_threshold;
+    c->requested = reorder_requested;
+    level_to_var = var_to_level = NULL;
+    levels_size = 0;
+    reorder_threshold = 0;
+    reorder_requested = 0;
+    reorder_initialized = 0;
+    return c;
+}
+
+void
+sylvan_reorder_context_attach(void *context)
+{
+    struct reorder_context *c = (struct reorder_context*)context;
+    reorder_initialized = c->initialized;
+    level_to_var = c->level_to_var;
+    var_to_level = c->var_to_level;
+    levels_size = c->levels_size;
+    reorder_threshold = c->threshold;
+    reorder_requested = c->requested;
+    free(c);
+}
+
+void
+sylvan_init_reorder()
+{
+    if (reorder_initialized) return;
+    reorder_initialized = 1;
+
+    sylvan_register_quit(reorder_quit);
+    sylvan_gc_hook_postgc(TASK(reorder_postgc));
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Do not include this file directly. Instead, include sylvan.h */
+
+#ifndef SYLVAN_REORDER_H
+#define SYLVAN_REORDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Dynamic variable reordering for BDDs and MTBDDs.
+ *
+ * The variable of an MTBDD node (mtbdd_getvar) is its level in the variable order.
+ * Reordering swaps adjacent levels in the nodes table: every node keeps its index and its
+ * function, but variables move to other levels. Use sylvan_var_to_level and sylvan_level_to_var
+ * to translate between the variables of the application and levels, for example
+ * mtbdd_ithvar(sylvan_var_to_level(v)). Initially, variable v is at level v.
+ *
+ * Reordering stops the world and performs garbage collection, so all MTBDDs that are used later
+ * must be referenced (mtbdd_protect, mtbdd_ref, ...). Running operations depend on the variable
+ * order, so reordering must not be started during an operation (for example from a gc hook).
+ * If garbage collection is disabled, reordering does nothing.
+ *
+ * Reordering only changes MTBDD nodes. Do not use it when the nodes table also contains LDDs.
+ */
+
+/**
+ * Initialize reordering support (after sylvan_init_mtbdd).
+ */
+void sylvan_init_reorder(void);
+
+/**
+ * Translate between variables and levels.
+ */
+uint32_t sylvan_var_to_level(uint32_t var);
+uint32_t sylvan_level_to_var(uint32_t level);
+
+/**
+ * Reorder the variables with sifting: every variable is moved to every level (by swapping
+ * adjacent levels), and then to the level where the number of nodes was smallest.
+ * A variable stops moving in one direction when the number of nodes grows beyond
+ * SYLVAN_REORDER_MAXGROWTH percent of the smallest number of nodes so far.
+ */
+VOID_TASK_DECL_0(sylvan_reorder);
+#define sylvan_reorder() CALL(sylvan_reorder)
+
+/**
+ * Change the variable order to the given order: variable vars[i] moves to level i.
+ * Variables that are not in <vars> move to the levels after <count>, in their current order.
+ */
+VOID_TASK_DECL_2(sylvan_reorder_perm, const uint32_t*, size_t);
+#define sylvan_reorder_perm(vars, count) CALL(sylvan_reorder_perm, vars, count)
+
+/**
+ * Automatic reordering.
+ * After garbage collection, reordering is requested when more than <threshold> nodes are in use
+ * (0 to disable, default). Since reordering must not happen during operations, call
+ * sylvan_reorder_test() between operations to reorder when it was requested.
+ * After reordering, the threshold is at least twice the number of nodes in use.
+ */
+void sylvan_set_reorder_threshold(size_t threshold);
+int sylvan_reorder_requested(void);
+#define sylvan_reorder_test() { if (sylvan_reorder_requested()) sylvan_reorder(); }
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
@@ -111,6 +111,10 @@ struct
     {1, SYLVAN_GC_COUNT, "GC executions"},
     {3, SYLVAN_GC, "Total time spent"},
 
+    {0, 0, "Variable reordering"},
+    {1, SYLVAN_REORDER_COUNT, "Reorderings"},
+    {3, SYLVAN_REORDER, "Total time spent"},
+
     {-1, -1, NULL},
 };
 
@@ -167,6 +171,39 @@ VOID_TASK_IMPL_0(sylvan_stats_reset)
     TOGETHER(sylvan_stats_reset_perthread);
 }
 
+/**
+ * Exchange the counters of every worker with saved[worker] (contexts)
+ */
+VOID_TASK_1(sylvan_stats_swap_perthread, sylvan_stats_t*, saved)
+{
+#ifdef __ELF__
+    sylvan_stats_t *current = &sylvan_stats;
+#else
+    sylvan_stats_t *current = pthread_getspecific(sylvan_stats_key);
+    if (current == NULL) return;
+#endif
+    sylvan_stats_t tmp = *current;
+    *current = saved[LACE_WORKER_ID];
+    saved[LACE_WORKER_ID] = tmp;
+}
+
+void*
+sylvan_stats_context_detach()
+{
+    sylvan_stats_t *saved = (sylvan_stats_t*)calloc(lace_workers(), sizeof(sylvan_stats_t));
+    LACE_ME;
+    TOGETHER(sylvan_stats_swap_perthread, saved);
+    return saved;
+}
+
+void
+sylvan_stats_context_attach(void *context)
+{
+    LACE_ME;
+    TOGETHER(sylvan_stats_swap_perthread, (sylvan_stats_t*)context);
+    free(context);
+}
+
 VOID_TASK_1(sylvan_stats_sum, sylvan_stats_t*, target)
 {
 #ifdef __ELF__
@@ -272,8 +309,8 @@ sylvan_stats_report(FILE *target)
             to_h(24ULL * llmsset_get_size(nodes), buf);
             to_h(24ULL * llmsset_get_max_size(nodes), buf2);
             fprintf(target, "%-20s %s (max real) of %s (allocated virtual memory).\n", "Memory (nodes)", buf, buf2);
-            to_h(36ULL * cache_getsize(), buf);
-            to_h(36ULL * cache_getmaxsize(), buf2);
+            to_h((36ULL + 64/CACHE_WIDE_RATIO) * cache_getsize(), buf);
+            to_h((36ULL + 64/CACHE_WIDE_RATIO) * cache_getmaxsize(), buf2);
             fprintf(target, "%-20s %s (max real) of %s (allocated virtual memory).\n", "Memory (cache)", buf, buf2);
         }
         i++;
@@ -295,6 +332,18 @@ VOID_TASK_IMPL_1(sylvan_stats_snapshot, sylvan_stats_t*, target)
     memset(target, 0, sizeof(sylvan_stats_t));
 }
 
+void*
+sylvan_stats_context_detach()
+{
+    return NULL;
+}
+
+void
+sylvan_stats_context_attach(void *context)
+{
+    (void)context;
+}
+
 void
 sylvan_stats_report(FILE* target)
 {
@@ -86,6 +86,7 @@ typedef enum {
 
     /* Other counters */
     SYLVAN_GC_COUNT,
+    SYLVAN_REORDER_COUNT,
     LLMSSET_LOOKUP,
 
     SYLVAN_COUNTER_COUNTER
@@ -94,6 +95,7 @@ typedef enum {
 typedef enum
 {
     SYLVAN_GC,
+    SYLVAN_REORDER,
     SYLVAN_TIMER_COUNTER
 } Sylvan_Timers;
 
@@ -129,6 +131,12 @@ VOID_TASK_DECL_1(sylvan_stats_snapshot, sylvan_stats_t*);
  */
 void sylvan_stats_report(FILE* target);
 
+/**
+ * Move the counters of all workers to a snapshot and reset them, or restore a snapshot (contexts)
+ */
+void *sylvan_stats_context_detach(void);
+void sylvan_stats_context_attach(void *context);
+
 #if SYLVAN_STATS
 
 #ifdef __MACH__
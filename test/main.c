@@ -143,6 +143,82 @@ int test_gc(int threads)
     return 0;
 }
 
+int test_gc_mark()
+{
+    // a wide BDD with many roots, so the mark queues of the workers grow beyond MARK_SHARE_SIZE and are shared
+    LACE_ME;
+    const int W = 4096, L = 64, N = 4;
+    BDD *prev = (BDD*)malloc(sizeof(BDD[W])), *next = (BDD*)malloc(sizeof(BDD[W]));
+    char sha[N][65], sha2[N][65];
+    int i, k, n = 2;
+    prev[0] = sylvan_false;
+    prev[1] = sylvan_true;
+    for (k=L-1; k>=0; k--) {
+        for (i=0; i<W; i++) {
+            int lo = rng(0, n), hi = rng(0, n-1);
+            if (hi >= lo) hi++;
+            next[i] = sylvan_ref(sylvan_makenode(k, prev[lo], prev[hi]));
+        }
+        if (k != L-1) for (i=0; i<W; i++) sylvan_deref(prev[i]);
+        BDD *t = prev; prev = next; next = t;
+        n = W;
+    }
+    for (i=0; i<N; i++) sylvan_getsha(prev[i], sha[i]);
+    sylvan_gc();
+    size_t live = llmsset_count_marked(nodes);
+    test_assert(live > (size_t)W*L/2);
+    for (k=0; k<4; k++) {
+        sylvan_gc();
+        test_assert(llmsset_count_marked(nodes) == live);
+        for (i=0; i<N; i++) {
+            sylvan_getsha(prev[i], sha2[i]);
+            test_assert(strcmp(sha[i], sha2[i]) == 0);
+        }
+    }
+    for (i=0; i<W; i++) sylvan_deref(prev[i]);
+    free(prev);
+    free(next);
+    return 0;
+}
+
+int test_overflow_probe()
+{
+    // with overflow probing, the nodes table (2^14 buckets) is filled beyond 95%
+    const uint64_t size = llmsset_get_size(nodes);
+    uint64_t *index = (uint64_t*)malloc(sizeof(uint64_t[size]));
+    uint64_t count = 0;
+    int created;
+    for (;;) {
+        index[count] = llmsset_lookup(nodes, count, 0x0123456789abcdefLL ^ count, &created);
+        if (index[count] == 0) break;
+        test_assert(created);
+        count++;
+    }
+    test_assert(count > size / 100 * 95);
+
+    // every key is found again
+    for (uint64_t i=0; i<count; i++) {
+        test_assert(llmsset_lookup(nodes, i, 0x0123456789abcdefLL ^ i, &created) == index[i]);
+        test_assert(!created);
+    }
+
+    // the same after an online resize, which migrates the overflow cache lines
+    // (the doubled table need not reach the same load, so it gets half as many new keys)
+    sylvan_set_online_resize(1);
+    for (uint64_t i=0; i<count+count/2; i++) {
+        test_assert(llmsset_lookup(nodes, i, 0x0123456789abcdefLL ^ i, &created) != 0);
+        test_assert(created == (i >= count));
+    }
+    for (uint64_t i=0; i<count; i++) {
+        test_assert(llmsset_lookup(nodes, i, 0x0123456789abcdefLL ^ i, &created) == index[i]);
+        test_assert(!created);
+    }
+    sylvan_set_online_resize(0);
+
+    free(index);
+    return 0;
+}
+
 TASK_2(MDD, random_ldd, int, depth, int, count)
 {
     uint32_t n[depth];
@@ -333,6 +409,78 @@ int runtests(int threads)
     sylvan_quit();
     printf(LGREEN "success" NC "!\n");
 
+    printf(NC "Testing garbage collection of a large table... ");
+    fflush(stdout);
+    sylvan_init_package(1LL<<20, 1LL<<20, 1LL<<16, 1LL<<16);
+    sylvan_init_bdd();
+    sylvan_gc_enable();
+    seed = 1; // reset the random generator, so the canaries are not constants
+    if (test_gc_mark()) return 1;
+    sylvan_quit();
+    printf(LGREEN "success" NC "!\n");
+
+    printf(NC "Testing incremental garbage collection... ");
+    fflush(stdout);
+    sylvan_init_package(1LL<<14, 1LL<<14, 1LL<<20, 1LL<<20);
+    sylvan_init_bdd();
+    sylvan_gc_enable();
+    sylvan_gc_set_incremental(1);
+    seed = 1; // reset the random generator, so the canaries are not constants
+    if (test_gc(threads)) return 1;
+    sylvan_gc_set_incremental(0);
+    sylvan_quit();
+    printf(LGREEN "success" NC "!\n");
+
+    printf(NC "Testing garbage collection with preserved cache... ");
+    fflush(stdout);
+    sylvan_init_package(1LL<<14, 1LL<<14, 1LL<<20, 1LL<<20);
+    sylvan_init_bdd();
+    sylvan_gc_enable();
+    sylvan_gc_set_preserve_cache(1);
+    seed = 1; // reset the random generator, so the canaries are not constants
+    if (test_gc(threads)) return 1;
+    sylvan_gc_set_preserve_cache(0);
+    sylvan_quit();
+    printf(LGREEN "success" NC "!\n");
+
+    printf(NC "Testing overflow probing... ");
+    fflush(stdout);
+    sylvan_init_package(1LL<<14, 1LL<<15, 1LL<<20, 1LL<<20);
+    sylvan_set_overflow_probe(1);
+    if (test_overflow_probe()) return 1;
+    sylvan_quit();
+    sylvan_init_package(1LL<<14, 1LL<<14, 1LL<<20, 1LL<<20);
+    sylvan_init_bdd();
+    sylvan_gc_enable();
+    sylvan_set_overflow_probe(1);
+    seed = 1; // reset the random generator, so the canaries are not constants
+    if (test_gc(threads)) return 1;
+    sylvan_quit();
+    printf(LGREEN "success" NC "!\n");
+
+    printf(NC "Testing garbage collection with adaptive resizing... ");
+    fflush(stdout);
+    sylvan_init_package(1LL<<14, 1LL<<18, 1LL<<16, 1LL<<20);
+    sylvan_init_bdd();
+    sylvan_gc_enable();
+    sylvan_gc_hook_main(TASK(sylvan_gc_adaptive_resize));
+    seed = 1; // reset the random generator, so the canaries are not constants
+    // with target 0%, the tables grow until their maximum size
+    sylvan_gc_set_target_overhead(0);
+    if (test_gc(threads)) return 1;
+    test_assert(llmsset_get_size(nodes) == 1LL<<18);
+    test_assert(cache_getsize() == 1LL<<20);
+    // without live nodes or new nodes, the tables shrink to their initial size
+    sylvan_gc_set_target_overhead(SYLVAN_GC_TARGET_OVERHEAD);
+    {
+        LACE_ME;
+        for (int k=0; k<8; k++) sylvan_gc();
+    }
+    test_assert(llmsset_get_size(nodes) == 1LL<<14);
+    test_assert(cache_getsize() == 1LL<<16);
+    sylvan_quit();
+    printf(LGREEN "success" NC "!\n");
+
     lace_exit();
     return 0;
 }
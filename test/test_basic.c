@@ -11,6 +11,7 @@
 
 #include "llmsset.h"
 #include "sylvan.h"
+#include "sylvan_cache.h"
 #include "test_assert.h"
 
 __thread uint64_t seed = 1;
@@ -119,6 +120,17 @@ test_bdd()
     test_assert(sylvan_makenode(sylvan_ithvar(1), sylvan_true, sylvan_false) == sylvan_not(sylvan_makenode(sylvan_ithvar(1), sylvan_false, sylvan_true)));
     test_assert(sylvan_makenode(sylvan_ithvar(1), sylvan_false, sylvan_false) == sylvan_not(sylvan_makenode(sylvan_ithvar(1), sylvan_true, sylvan_true)));
 
+    // variables use 24 bits, also with 48-bit node indices
+    LACE_ME;
+    const uint32_t vars[4] = {0, 0xffff, 0x10000, 0xffffff};
+    for (int i=0; i<4; i++) {
+        BDD v = sylvan_ithvar(vars[i]);
+        test_assert(sylvan_var(v) == vars[i]);
+        test_assert(sylvan_high(v) == sylvan_true && sylvan_low(v) == sylvan_false);
+        test_assert(sylvan_var(sylvan_not(v)) == vars[i]);
+    }
+    test_assert(sylvan_var(sylvan_and(sylvan_ithvar(0x10000), sylvan_ithvar(0xffff))) == 0xffff);
+
     return 0;
 }
 
@@ -453,16 +465,566 @@ test_ldd()
     return 0;
 }
 
+int
+test_online_resize()
+{
+    LACE_ME;
+
+    // the nodes table starts small and must grow while nodes are created (gc is disabled)
+    sylvan_set_online_resize(1);
+
+    size_t filled, total;
+    sylvan_table_usage(&filled, &total);
+    test_assert(total == 4096);
+
+    const int count = 100000;
+    BDD *low = (BDD*)malloc(sizeof(BDD[count]));
+    BDD *node = (BDD*)malloc(sizeof(BDD[count]));
+
+    BDD prev = sylvan_true;
+    for (int i=0; i<count; i++) {
+        low[i] = prev;
+        node[i] = sylvan_makenode(i % 1000, prev, (i & 1) ? sylvan_false : sylvan_true);
+        prev = node[i];
+    }
+
+    sylvan_table_usage(&filled, &total);
+    test_assert(total > 4096);
+
+    // all nodes must still be found after the hash array was migrated
+    for (int i=0; i<count; i++) {
+        test_assert(sylvan_makenode(i % 1000, low[i], (i & 1) ? sylvan_false : sylvan_true) == node[i]);
+    }
+
+    free(low);
+    free(node);
+
+    for (int j=0;j<10;j++) if (test_operators()) return 1;
+
+    return 0;
+}
+
+int
+test_memory_policy()
+{
+    LACE_ME;
+
+    // the tables use huge pages (or fall back to normal pages) and are interleaved over NUMA nodes
+    sylvan_gc_enable();
+    for (int j=0;j<10;j++) {
+        if (test_operators()) return 1;
+        sylvan_gc();
+    }
+
+    BDD x = sylvan_ithvar(1);
+    sylvan_protect(&x);
+    x = sylvan_and(x, sylvan_nithvar(2));
+    sylvan_gc();
+    test_assert(x == sylvan_and(sylvan_ithvar(1), sylvan_nithvar(2)));
+    sylvan_unprotect(&x);
+
+    sylvan_gc_disable();
+    return 0;
+}
+
+int
+test_preserve_cache()
+{
+    LACE_ME;
+
+    sylvan_gc_enable();
+    sylvan_gc_set_preserve_cache(1);
+
+    uint64_t opid = cache_next_opid();
+    uint64_t opid_nolayout = cache_next_opid();
+    cache_set_layout(opid, CACHE_NODE_A | CACHE_NODE_B | CACHE_NODE_RES);
+
+    BDD a = sylvan_makenode(1, sylvan_false, sylvan_true);
+    BDD b = sylvan_makenode(2, sylvan_true, sylvan_false);
+    BDD r = sylvan_not(sylvan_and(a, b));
+    BDD d = sylvan_makenode(100, sylvan_true, sylvan_false); // not protected
+    sylvan_protect(&a);
+    sylvan_protect(&b);
+    sylvan_protect(&r);
+
+    uint64_t res;
+    test_assert(cache_put3(opid, a, b, 0, r));
+    test_assert(cache_put3(opid, d, b, 0, r));
+    test_assert(cache_put3(opid_nolayout, a, b, 0, r));
+    test_assert(cache_get3(opid, a, b, 0, &res) && res == r);
+    test_assert(cache_get3(opid, d, b, 0, &res) && res == r);
+    test_assert(cache_get3(opid_nolayout, a, b, 0, &res) && res == r);
+
+    sylvan_gc();
+
+    // only the entry of which all nodes survived is kept
+    test_assert(cache_get3(opid, a, b, 0, &res) && res == r);
+    test_assert(!cache_get3(opid, d, b, 0, &res));
+    test_assert(!cache_get3(opid_nolayout, a, b, 0, &res));
+
+    sylvan_unprotect(&a);
+    sylvan_unprotect(&b);
+    sylvan_unprotect(&r);
+
+    sylvan_gc_set_preserve_cache(0);
+    sylvan_gc_disable();
+
+    // the operations use the cache entries that survived garbage collection
+    for (int j=0;j<10;j++) if (test_operators()) return 1;
+
+    return 0;
+}
+
+/**
+ * Evaluate <dd> for the assignment to the variables (not levels) in <values>
+ */
+static MTBDD
+eval_vars(MTBDD dd, const uint8_t *values)
+{
+    while (!mtbdd_isleaf(dd)) {
+        uint32_t var = sylvan_level_to_var(mtbdd_getvar(dd));
+        dd = values[var] ? mtbdd_gethigh(dd) : mtbdd_getlow(dd);
+    }
+    return dd;
+}
+
+/**
+ * Build (x_0 and y_0) or ... or (x_n-1 and y_n-1) with variables x_i = i and y_i = n+i
+ */
+static BDD
+make_pairs(int n)
+{
+    LACE_ME;
+
+    BDD res = sylvan_false;
+    sylvan_protect(&res);
+    for (int i=n-1; i>=0; i--) {
+        BDD x = sylvan_ithvar(sylvan_var_to_level(i));
+        BDD y = sylvan_ithvar(sylvan_var_to_level(n+i));
+        res = sylvan_or(res, sylvan_and(x, y));
+    }
+    sylvan_unprotect(&res);
+    return res;
+}
+
+int
+test_compact()
+{
+    LACE_ME;
+
+    sylvan_gc_enable();
+
+    BDD f = make_pairs(6);
+    BDD g = sylvan_ref(sylvan_or(sylvan_ithvar(3), sylvan_nithvar(20)));
+    BDD h = sylvan_and(f, g);
+    sylvan_protect(&f);
+    sylvan_protect(&h);
+    sylvan_protect(&h); // protected twice
+    MDD a = lddmc_cube((uint32_t[]){1,2,3,5,4,3}, 6);
+    a = lddmc_ref(lddmc_union_cube(a, (uint32_t[]){2,2,3,5,4,2}, 6));
+
+    char sha_f[65], sha_g[65], sha_h[65], sha_a[65], sha[65];
+    sylvan_getsha(f, sha_f);
+    sylvan_getsha(g, sha_g);
+    sylvan_getsha(h, sha_h);
+    lddmc_getsha(a, sha_a);
+
+    // garbage, and grow the nodes table
+    size_t filled, total;
+    for (int i=0; i<1000; i++) make_pairs(8);
+    sylvan_gc();
+    sylvan_gc();
+    sylvan_table_usage(&filled, &total);
+    test_assert(total > (1LL<<18));
+
+    sylvan_gc_compact();
+
+    // the table is back to its initial size
+    sylvan_table_usage(&filled, &total);
+    test_assert(total == (1LL<<18));
+
+    // protected variables are updated, nodes referenced by value keep their index
+    sylvan_getsha(f, sha);
+    test_assert(strcmp(sha, sha_f) == 0);
+    sylvan_getsha(g, sha);
+    test_assert(strcmp(sha, sha_g) == 0);
+    sylvan_getsha(h, sha);
+    test_assert(strcmp(sha, sha_h) == 0);
+    lddmc_getsha(a, sha);
+    test_assert(strcmp(sha, sha_a) == 0);
+
+    // the unique table finds the moved nodes
+    test_assert(sylvan_and(f, g) == h);
+    test_assert(lddmc_union_cube(a, (uint32_t[]){2,2,3,5,4,2}, 6) == a);
+    test_assert(lddmc_satcount(a) == 2);
+
+    // again, keeping the order of the nodes instead of depth-first order
+    for (int i=0; i<1000; i++) make_pairs(8);
+    sylvan_gc_set_compact_order(SYLVAN_COMPACT_INDEX);
+    sylvan_gc_compact();
+    sylvan_gc_set_compact_order(SYLVAN_COMPACT_DFS);
+    sylvan_table_usage(&filled, &total);
+    test_assert(total == (1LL<<18));
+
+    sylvan_getsha(f, sha);
+    test_assert(strcmp(sha, sha_f) == 0);
+    sylvan_getsha(h, sha);
+    test_assert(strcmp(sha, sha_h) == 0);
+    test_assert(sylvan_and(f, g) == h);
+    test_assert(lddmc_satcount(a) == 2);
+
+    sylvan_unprotect(&f);
+    sylvan_unprotect(&h);
+    sylvan_unprotect(&h);
+    sylvan_deref(g);
+    lddmc_deref(a);
+
+    sylvan_gc_disable();
+
+    return 0;
+}
+
+int
+test_reorder()
+{
+    LACE_ME;
+
+    sylvan_gc_enable();
+
+    const int n = 7;
+    BDD f = make_pairs(n);
+    sylvan_protect(&f);
+    MTBDD m = mtbdd_ite(sylvan_not(f), mtbdd_double(1.5), mtbdd_double(2.5));
+    mtbdd_protect(&m);
+    MTBDDMAP map = mtbdd_map_add(mtbdd_map_add(mtbdd_map_empty(), 0, f), n, sylvan_not(f));
+    mtbdd_protect(&map);
+
+    const size_t size_before = sylvan_nodecount(f);
+    uint8_t values[2*n];
+    MTBDD results_f[1<<(2*n)], results_m[1<<(2*n)];
+    for (int k=0; k<(1<<(2*n)); k++) {
+        for (int v=0; v<2*n; v++) values[v] = (k>>v)&1;
+        results_f[k] = eval_vars(f, values);
+        results_m[k] = eval_vars(m, values);
+    }
+
+    sylvan_reorder();
+
+    // the interleaved order is much better, and the functions are the same
+    test_assert(sylvan_nodecount(f) < size_before);
+    test_assert(make_pairs(n) == f);
+    for (int k=0; k<(1<<(2*n)); k++) {
+        for (int v=0; v<2*n; v++) values[v] = (k>>v)&1;
+        test_assert(eval_vars(f, values) == results_f[k]);
+        test_assert(eval_vars(m, values) == results_m[k]);
+    }
+
+    // the keys of the map follow the new order
+    test_assert(mtbdd_map_contains(map, sylvan_var_to_level(0)));
+    test_assert(mtbdd_map_contains(map, sylvan_var_to_level(n)));
+    test_assert(mtbdd_getvar(map) < mtbdd_getvar(mtbdd_map_next(map)));
+
+    // restore the original order
+    uint32_t perm[2*n];
+    for (int v=0; v<2*n; v++) perm[v] = v;
+    sylvan_reorder_perm(perm, 2*n);
+    for (int v=0; v<2*n; v++) test_assert(sylvan_var_to_level(v) == (uint32_t)v);
+    test_assert(sylvan_nodecount(f) == size_before);
+    test_assert(make_pairs(n) == f);
+    for (int k=0; k<(1<<(2*n)); k++) {
+        for (int v=0; v<2*n; v++) values[v] = (k>>v)&1;
+        test_assert(eval_vars(m, values) == results_m[k]);
+    }
+
+    sylvan_unprotect(&f);
+    mtbdd_unprotect(&m);
+    mtbdd_unprotect(&map);
+
+    sylvan_gc_disable();
+
+    return 0;
+}
+
+/**
+ * Collect the internal nodes of <dd> in <nodes> (without duplicates)
+ */
+static void
+collect_nodes(MTBDD dd, MTBDD *nodes, size_t *count)
+{
+    if (mtbdd_isleaf(dd)) return;
+    dd = dd & ~mtbdd_complement;
+    for (size_t i=0; i<*count; i++) if (nodes[i] == dd) return;
+    nodes[(*count)++] = dd;
+    collect_nodes(mtbdd_getlow(dd), nodes, count);
+    collect_nodes(mtbdd_gethigh(dd), nodes, count);
+}
+
+/**
+ * Check that the per-level node index contains exactly the nodes of <dd>
+ */
+static int
+check_level_index(MTBDD dd)
+{
+    MTBDD nodes[1024];
+    size_t count = 0;
+    collect_nodes(dd, nodes, &count);
+
+    size_t total = 0;
+    for (uint32_t level=0; level<sylvan_level_count(); level++) {
+        size_t n = 0;
+        for (MTBDD node = sylvan_level_first(level); node != mtbdd_false; node = sylvan_level_next(node)) {
+            test_assert(mtbdd_getvar(node) == level);
+            int found = 0;
+            for (size_t i=0; i<count; i++) if (nodes[i] == node) found = 1;
+            test_assert(found);
+            n++;
+        }
+        test_assert(n == sylvan_level_nodecount(level));
+        total += n;
+    }
+    test_assert(total == count);
+
+    return 0;
+}
+
+int
+test_level_index()
+{
+    LACE_ME;
+
+    sylvan_gc_enable();
+    sylvan_set_level_index(1);
+
+    BDD f = make_pairs(5);
+    sylvan_protect(&f);
+
+    // garbage is in the index until garbage collection
+    make_pairs(4);
+    size_t before = 0;
+    for (uint32_t level=0; level<sylvan_level_count(); level++) before += sylvan_level_nodecount(level);
+    test_assert(before > sylvan_nodecount(f));
+
+    sylvan_gc();
+    if (check_level_index(f)) return 1;
+
+    // the index follows the new levels after reordering
+    sylvan_reorder();
+    if (check_level_index(f)) return 1;
+
+    uint32_t perm[10];
+    for (int v=0; v<10; v++) perm[v] = v;
+    sylvan_reorder_perm(perm, 10);
+    if (check_level_index(f)) return 1;
+
+    // and the new indices after compaction
+    sylvan_gc_compact();
+    if (check_level_index(f)) return 1;
+
+    sylvan_unprotect(&f);
+
+    sylvan_set_level_index(0);
+    sylvan_gc_disable();
+
+    return 0;
+}
+
+int
+test_cache()
+{
+    // with a set-associative cache, a half-full cache keeps (almost) all entries
+    const uint64_t opid = cache_next_opid();
+    const uint64_t count = cache_getsize() / 2;
+    cache_clear();
+    for (uint64_t i=0; i<count; i++) test_assert(cache_put3(opid, i, 3*i, 0, i+1));
+
+    uint64_t hits = 0, res;
+    for (uint64_t i=0; i<count; i++) {
+        if (cache_get3(opid, i, 3*i, 0, &res)) {
+            test_assert(res == i+1);
+            hits++;
+        }
+    }
+    test_assert(CACHE_WAYS == 1 || hits * 100 >= count * 95);
+    test_assert(!cache_get3(opid, count, 3*count, 0, &res));
+
+    // the sampled statistics estimate the number of hits and misses
+    cache_stats_t stats;
+    cache_stats_reset();
+    for (uint64_t i=0; i<count; i++) cache_get3(opid, i, 3*i, 0, &res);
+    for (uint64_t i=0; i<count; i++) cache_get3(opid, count+i, 3*i, 0, &res);
+    cache_stats_snapshot_op(opid, &stats);
+    if (CACHE_STATS_SAMPLE != 0) {
+        test_assert(stats.counters[CACHE_STATS_HIT] > hits - hits/4 && stats.counters[CACHE_STATS_HIT] < hits + hits/4);
+        test_assert(stats.counters[CACHE_STATS_MISS] > count - count/4);
+        test_assert(stats.counters[CACHE_STATS_PUT] == 0);
+    }
+
+    // entries of an operation with a high priority survive a burst of entries with priority 0
+    const uint64_t opid_low = cache_next_opid();
+    uint64_t kept[2];
+    for (int prio=0; prio<2; prio++) {
+        cache_set_priority(opid, prio ? CACHE_PRIORITY_MAX : 0);
+        cache_clear();
+        for (uint64_t i=0; i<count/2; i++) cache_put3(opid, i, 3*i, 0, i+1);
+        for (uint64_t i=0; i<2*count; i++) cache_put3(opid_low, i, 5*i, 0, i+1);
+        kept[prio] = 0;
+        for (uint64_t i=0; i<count/2; i++) kept[prio] += cache_get3(opid, i, 3*i, 0, &res);
+    }
+    test_assert(CACHE_WAYS == 1 || kept[1] > kept[0] + kept[0]/2);
+    cache_set_priority(opid, 0);
+
+    // wide entries use all parameters of the key, also beyond 40 bits
+    cache_clear();
+    const uint64_t big = 0x0000ffffffffffffULL;
+    test_assert(cache_put6(opid, 1, 2, 3, big, 5, 6, 100));
+    test_assert(cache_put4(opid, 1, 2, 3, 4, 200));
+    test_assert(cache_get6(opid, 1, 2, 3, big, 5, 6, &res) && res == 100);
+    test_assert(cache_get4(opid, 1, 2, 3, 4, &res) && res == 200);
+    test_assert(!cache_get6(opid, 1, 2, 3, big, 5, 7, &res));
+    test_assert(!cache_get4(opid, 1, 2, 3, big, &res));
+    test_assert(!cache_get3(opid, 1, 2, 3, &res));
+
+    cache_clear();
+    return 0;
+}
+
+int
+test_hash_many()
+{
+    // every implementation of llmsset_hash_many that this CPU supports gives the same hashes as llmsset_hash,
+    // for any number of keys (also keys with all bits set, for the carries of the 64-bit multiplication)
+    uint64_t a[37], b[37], hashes[37];
+    for (int i=0; i<37; i++) {
+        a[i] = i % 9 ? xorshift_rand() : ~0ULL;
+        b[i] = i % 7 ? xorshift_rand() : ~0ULL;
+    }
+    // (the last is LLMSSET_HASH_AUTO, the implementation that llmsset_create selected)
+    const int impls[] = {LLMSSET_HASH_SCALAR, LLMSSET_HASH_AVX2, LLMSSET_HASH_AVX512, LLMSSET_HASH_AUTO};
+    for (int k=0; k<4; k++) {
+        if (!llmsset_hash_select(impls[k])) {
+            test_assert(impls[k] == LLMSSET_HASH_AVX2 || impls[k] == LLMSSET_HASH_AVX512);
+            continue;
+        }
+        for (size_t count=0; count<=37; count++) {
+            llmsset_hash_many(count, a, b, 14695981039346656037LLU ^ count, hashes);
+            for (size_t i=0; i<count; i++) test_assert(hashes[i] == llmsset_hash(a[i], b[i], 14695981039346656037LLU ^ count));
+        }
+    }
+    return 0;
+}
+
+int
+test_serialize()
+{
+    LACE_ME;
+
+    BDD bdds[16];
+    for (int i=0; i<16; i++) bdds[i] = make_random(0, 16);
+
+    // a batch of nodes gives the same nodes as creating every node separately
+    uint32_t vars[64];
+    BDD lows[64], highs[64], results[64];
+    for (int i=0; i<64; i++) {
+        vars[i] = 100 + i % 3;
+        lows[i] = bdds[rng(0, 16)];
+        highs[i] = rng(0, 4) ? sylvan_not(bdds[rng(0, 16)]) : lows[i];
+    }
+    sylvan_makenode_batch(64, vars, lows, highs, results);
+    for (int i=0; i<64; i++) test_assert(results[i] == sylvan_makenode(vars[i], lows[i], highs[i]));
+
+    // reading a file restores the same BDDs (the nodes are created per height with batches)
+    FILE *f = tmpfile();
+    sylvan_serialize_reset();
+    size_t keys[16];
+    for (int i=0; i<16; i++) keys[i] = sylvan_serialize_add(bdds[i]);
+    sylvan_serialize_tofile(f);
+    sylvan_serialize_reset();
+    rewind(f);
+    sylvan_serialize_fromfile(f);
+    for (int i=0; i<16; i++) test_assert(sylvan_serialize_get_reversed(keys[i]) == bdds[i]);
+    sylvan_serialize_reset();
+    fclose(f);
+
+    f = tmpfile();
+    MTBDD dds[16];
+    mtbdd_writer_tobinary(f, bdds, 16);
+    rewind(f);
+    test_assert(mtbdd_reader_frombinary(f, dds, 16) == 0);
+    for (int i=0; i<16; i++) test_assert(dds[i] == bdds[i]);
+    fclose(f);
+
+    return 0;
+}
+
+int
+test_context()
+{
+    LACE_ME;
+
+    // the current instance becomes context <a>
+    sylvan_gc_enable();
+    BDD x = make_random(0, 12);
+    sylvan_protect(&x);
+    const size_t x_count = sylvan_nodecount(x);
+    size_t a_filled, a_total;
+    sylvan_table_usage(&a_filled, &a_total);
+    cache_stats_t a_stats, stats;
+    cache_stats_snapshot(&a_stats);
+    sylvan_context_t a = sylvan_context_detach();
+
+    // an independent instance <b> with a small table, its own references and garbage collection
+    sylvan_init_package(1LL<<12, 1LL<<20, 1LL<<12, 1LL<<16);
+    sylvan_init_mtbdd();
+    test_assert(mtbdd_count_protected() == 0);
+    cache_stats_snapshot(&stats);
+    for (int i=0; i<CACHE_STATS_COUNTERS; i++) test_assert(stats.counters[i] == 0);
+    sylvan_gc_enable();
+    BDD y = sylvan_false;
+    sylvan_protect(&y);
+    for (int i=0; i<200; i++) y = sylvan_or(y, make_random(0, 16));
+    const size_t y_count = sylvan_nodecount(y);
+    sylvan_gc();
+
+    // garbage collection in <b> did not touch the nodes of <a>, and <b> kept its own cache statistics
+    sylvan_context_t b = sylvan_context_switch(a);
+    cache_stats_snapshot(&stats);
+    test_assert(memcmp(&stats, &a_stats, sizeof(cache_stats_t)) == 0);
+    size_t filled, total;
+    sylvan_table_usage(&filled, &total);
+    test_assert(filled == a_filled && total == a_total);
+    test_assert(mtbdd_count_protected() >= 1);
+    test_assert(sylvan_nodecount(x) == x_count);
+    sylvan_gc();
+    test_assert(sylvan_nodecount(x) == x_count);
+
+    a = sylvan_context_switch(b);
+    test_assert(sylvan_nodecount(y) == y_count);
+    sylvan_gc();
+    test_assert(sylvan_nodecount(y) == y_count);
+    sylvan_unprotect(&y);
+    sylvan_quit();
+
+    sylvan_context_attach(a);
+    test_assert(sylvan_nodecount(x) == x_count);
+    sylvan_unprotect(&x);
+    sylvan_gc_disable();
+
+    return 0;
+}
+
 int runtests()
 {
     // we are not testing garbage collection
     sylvan_gc_disable();
 
+    if (test_cache()) return 1;
+    if (test_hash_many()) return 1;
     if (test_bdd()) return 1;
     for (int j=0;j<10;j++) if (test_cube()) return 1;
     for (int j=0;j<10;j++) if (test_relprod()) return 1;
     for (int j=0;j<10;j++) if (test_compose()) return 1;
     for (int j=0;j<10;j++) if (test_operators()) return 1;
+    if (test_serialize()) return 1;
 
     if (test_ldd()) return 1;
 
@@ -483,6 +1045,44 @@ int main()
 
     int res = runtests();
 
+    if (res == 0) {
+        // restart with a small nodes table to test online resizing
+        sylvan_quit();
+        sylvan_init_package(1LL<<12, 1LL<<20, 1LL<<16, 1LL<<16);
+        sylvan_init_bdd();
+        sylvan_init_mtbdd();
+        sylvan_init_ldd();
+        res = test_online_resize();
+    }
+
+    if (res == 0) {
+        // restart with a different memory policy for the tables
+        sylvan_quit();
+        sylvan_set_memory_policy(SYLVAN_PAGES_HUGETLB, SYLVAN_NUMA_INTERLEAVE);
+        sylvan_init_package(1LL<<18, 1LL<<20, 1LL<<18, 1LL<<18);
+        sylvan_init_bdd();
+        sylvan_init_mtbdd();
+        sylvan_init_ldd();
+        sylvan_set_memory_policy(SYLVAN_PAGES_DEFAULT, SYLVAN_NUMA_DEFAULT);
+        res = test_memory_policy();
+    }
+
+    if (res == 0) res = test_preserve_cache();
+    if (res == 0) res = test_compact();
+
+    if (res == 0) {
+        // restart without LDDs to test variable reordering
+        sylvan_quit();
+        sylvan_init_package(1LL<<16, 1LL<<20, 1LL<<16, 1LL<<16);
+        sylvan_init_bdd();
+        sylvan_init_mtbdd();
+        sylvan_init_reorder();
+        res = test_level_index();
+        if (res == 0) res = test_reorder();
+    }
+
+    if (res == 0) res = test_context();
+
     sylvan_quit();
     lace_exit();
 
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "lace.h"
+#include "test_assert.h"
+
+static int
+fib_serial(int n)
+{
+    return n < 2 ? n : fib_serial(n-1) + fib_serial(n-2);
+}
+
+TASK_1(int, fib, int, n)
+{
+    if (n < 2) return n;
+    SPAWN(fib, n-1);
+    int a = CALL(fib, n-2);
+    return a + SYNC(fib);
+}
+
+/**
+ * Count the solutions of n queens; every free column of the next row is a task.
+ */
+TASK_4(uint64_t, nqueens, int, n, uint32_t, cols, uint32_t, diag1, uint32_t, diag2)
+{
+    const uint32_t all = (1U << n) - 1;
+    if (cols == all) return 1;
+
+    int count = 0;
+    uint32_t free = all & ~(cols | diag1 | diag2);
+    while (free != 0) {
+        uint32_t bit = free & -free;
+        free ^= bit;
+        SPAWN(nqueens, n, cols | bit, ((diag1 | bit) << 1) & all, (diag2 | bit) >> 1);
+        count++;
+    }
+
+    uint64_t result = 0;
+    while (count--) result += SYNC(nqueens);
+    return result;
+}
+
+VOID_TASK_2(count_leaves, int, depth, uint64_t*, counter)
+{
+    if (depth == 0) {
+        __sync_fetch_and_add(counter, 1);
+        return;
+    }
+    SPAWN(count_leaves, depth-1, counter);
+    CALL(count_leaves, depth-1, counter);
+    SYNC(count_leaves);
+}
+
+/**
+ * Spawn 5 tasks, then run a call that is deep enough for SPAWN to execute tasks immediately.
+ * Afterwards, lace_get_head must find the current head (no slots of executed tasks are left above it).
+ */
+TASK_0(int, head_after_cutoff)
+{
+    for (int i=0; i<5; i++) SPAWN(fib, 1);
+    int res = CALL(fib, 20) == fib_serial(20);
+    res = res && lace_get_head(__lace_worker) == __lace_dq_head;
+    for (int i=0; i<5; i++) res = res && SYNC(fib) == 1;
+    return res;
+}
+
+TASK_1(int, nap, int, us)
+{
+    usleep(us);
+    return 1;
+}
+
+/**
+ * Spawn and sync slow tasks until the workers have stolen all tasks of this worker
+ * (wait before SYNC, so the thieves can steal the task).
+ */
+TASK_0(int, drain)
+{
+    for (int i=0; i<10000; i++) {
+        SPAWN(nap, 100);
+        usleep(200);
+        if (SYNC(nap) != 1) return 0;
+        if (__lace_worker->allstolen) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Spawn slow tasks until SPAWN executes the next task immediately, then spawn drain. When drain returns,
+ * all tasks are stolen, so the slot of drain must count as a completed stolen task.
+ * Returns 1 if this happened, 2 if the tasks were stolen differently, 0 if the results were wrong.
+ */
+TASK_0(int, stolen_after_cutoff)
+{
+    WorkerP *w = __lace_worker;
+    int n = 0;
+    while (n < 8*LACE_CUTOFF_DEPTH && (w->allstolen || w->_public->movesplit || __lace_dq_head - w->split < LACE_CUTOFF_DEPTH)) {
+        SPAWN(nap, 1000);
+        n++;
+    }
+    SPAWN(drain);
+    Task *slot = __lace_dq_head - 1;
+    int res = TASK_IS_INLINED(slot) && slot->thief == THIEF_COMPLETED ? 1 : 2;
+    if (SYNC(drain) != 1) res = 0;
+    while (n--) if (SYNC(nap) != 1) res = 0;
+    return res;
+}
+
+TASK_0(int, test_cutoff)
+{
+    // with several workers, tasks spawned by calls that SPAWN executed immediately are stolen
+    for (int k=0; k<20; k++) {
+        test_assert(CALL(fib, 25) == fib_serial(25));
+        test_assert(CALL(nqueens, 8, 0, 0, 0) == 92);
+        uint64_t counter = 0;
+        CALL(count_leaves, 14, &counter);
+        test_assert(counter == 1 << 14);
+    }
+    test_assert(CALL(nqueens, 10, 0, 0, 0) == 724);
+
+    for (int k=0; k<20; k++) test_assert(CALL(head_after_cutoff));
+    test_assert(lace_get_head(__lace_worker) == __lace_dq_head);
+
+    // all tasks are stolen while SPAWN executes a task immediately (until it happens, at most 100 times)
+    int stolen = 0;
+    for (int k=0; k<100 && stolen != 1 && LACE_CUTOFF_DEPTH; k++) {
+        stolen = CALL(stolen_after_cutoff);
+        test_assert(stolen != 0);
+    }
+    test_assert(stolen == 1 || !LACE_CUTOFF_DEPTH);
+    test_assert(lace_get_head(__lace_worker) == __lace_dq_head);
+
+    return 0;
+}
+
+static volatile int victims_failed;
+
+/**
+ * Every worker checks that its victims are all other workers, nearest first.
+ */
+VOID_TASK_0(check_victims)
+{
+    const int n = (int)lace_workers();
+    int seen[n];
+    memset(seen, 0, sizeof(seen));
+    int ok = 0 <= __lace_worker->victims_cluster &&
+             __lace_worker->victims_cluster <= __lace_worker->victims_node &&
+             __lace_worker->victims_node <= n-1;
+    for (int i=0; i<n-1; i++) {
+        int v = __lace_worker->victims[i];
+        if (v < 0 || v >= n || v == __lace_worker->worker || seen[v]++) ok = 0;
+    }
+    if (!ok) __sync_fetch_and_add(&victims_failed, 1);
+}
+
+TASK_0(int, test_victims)
+{
+    victims_failed = 0;
+    TOGETHER(check_victims);
+    test_assert(victims_failed == 0);
+
+    return 0;
+}
+
+/**
+ * Wait (at most 5 seconds) until some idle workers sleep.
+ */
+static int
+wait_sleeping()
+{
+    for (int i=0; i<500 && lace_sleeping == 0; i++) usleep(10000);
+    return lace_sleeping != 0;
+}
+
+TASK_0(int, test_idle)
+{
+    // idle workers back off and sleep quickly, and SPAWN and TOGETHER wake them
+    lace_set_idle_spins(100);
+    for (int k=0; k<5; k++) {
+        test_assert(wait_sleeping());
+        test_assert(CALL(fib, 25) == fib_serial(25));
+        test_assert(wait_sleeping());
+        victims_failed = 0;
+        TOGETHER(check_victims);
+        test_assert(victims_failed == 0);
+    }
+
+    // lace_exit must also wake the sleeping workers
+    test_assert(wait_sleeping());
+    return 0;
+}
+
+/**
+ * A thread that is not a Lace worker: run tasks with RUN, and submit several tasks at once with SUBMIT.
+ */
+static void*
+submit_thread(void *arg)
+{
+    int *failed = (int*)arg;
+    for (int k=0; k<50; k++) {
+        if (RUN(fib, 15 + k % 5) != fib_serial(15 + k % 5)) (*failed)++;
+
+        lace_future_t futures[4];
+        for (int i=0; i<4; i++) SUBMIT(nqueens, &futures[i], 5 + i, 0, 0, 0);
+        for (int i=0; i<4; i++) lace_future_wait(&futures[i]);
+        if (FUTURE_RESULT(nqueens, &futures[0]) != 10) (*failed)++;
+        if (FUTURE_RESULT(nqueens, &futures[1]) != 4) (*failed)++;
+        if (FUTURE_RESULT(nqueens, &futures[2]) != 40) (*failed)++;
+        if (FUTURE_RESULT(nqueens, &futures[3]) != 92) (*failed)++;
+    }
+    return NULL;
+}
+
+int
+test_submit()
+{
+    // several threads submit tasks at the same time, while the workers are running
+    pthread_t threads[4];
+    int failed[4] = {0};
+    for (int i=0; i<4; i++) test_assert(pthread_create(&threads[i], NULL, submit_thread, &failed[i]) == 0);
+    test_assert(RUN(nqueens, 10, 0, 0, 0) == 724);
+    for (int i=0; i<4; i++) {
+        test_assert(pthread_join(threads[i], NULL) == 0);
+        test_assert(failed[i] == 0);
+    }
+
+    return 0;
+}
+
+#if LACE_TRACE
+/**
+ * Read the whole <file> into a string.
+ */
+static char*
+read_file(FILE *file)
+{
+    long size = ftell(file);
+    char *buf = (char*)malloc(size + 1);
+    rewind(file);
+    if (buf == NULL || fread(buf, 1, size, file) != (size_t)size) return NULL;
+    buf[size] = 0;
+    return buf;
+}
+
+static size_t
+count_string(const char *s, const char *pattern)
+{
+    size_t count = 0;
+    while ((s = strstr(s, pattern)) != NULL) {
+        count++;
+        s++;
+    }
+    return count;
+}
+
+int
+test_trace()
+{
+    lace_trace_start();
+    test_assert(RUN(fib, 15) == fib_serial(15));
+    lace_trace_stop();
+
+    // Chrome trace: a JSON object with balanced brackets and a matching end for every begin
+    FILE *file = tmpfile();
+    test_assert(file != NULL);
+    lace_trace_write_chrome(file);
+    char *chrome = read_file(file);
+    fclose(file);
+    test_assert(chrome != NULL);
+    test_assert(strncmp(chrome, "{\"traceEvents\":[", 16) == 0);
+    const char *end = "],\"displayTimeUnit\":\"ns\"}\n";
+    test_assert(strlen(chrome) > strlen(end) && strcmp(chrome + strlen(chrome) - strlen(end), end) == 0);
+    int braces = 0, brackets = 0, in_string = 0;
+    for (const char *c = chrome; *c; c++) {
+        if (*c == '"') in_string = !in_string;
+        else if (in_string) continue;
+        else if (*c == '{') braces++;
+        else if (*c == '}') braces--;
+        else if (*c == '[') brackets++;
+        else if (*c == ']') brackets--;
+        test_assert(braces >= 0 && brackets >= 0);
+    }
+    test_assert(braces == 0 && brackets == 0 && !in_string);
+    test_assert(count_string(chrome, "\"name\":\"fib\",\"ph\":\"B\"") > 0);
+    test_assert(count_string(chrome, "\"ph\":\"B\"") == count_string(chrome, "\"ph\":\"E\""));
+    test_assert(count_string(chrome, "\"name\":\"thread_name\"") == lace_workers());
+    free(chrome);
+
+    // folded stacks: sorted lines "worker N;task;... ns"
+    file = tmpfile();
+    test_assert(file != NULL);
+    lace_trace_write_folded(file);
+    char *folded = read_file(file);
+    fclose(file);
+    test_assert(folded != NULL);
+    int fib_stacks = 0;
+    char *prev = NULL;
+    for (char *line = strtok(folded, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char *space = strrchr(line, ' ');
+        test_assert(strncmp(line, "worker ", 7) == 0 && space != NULL && space[1] != 0);
+        test_assert(strspn(space + 1, "0123456789") == strlen(space + 1));
+        *space = 0;
+        test_assert(strchr(line, ';') != NULL);
+        if (strstr(line, ";fib") != NULL) fib_stacks++;
+        test_assert(prev == NULL || strcmp(prev, line) < 0);
+        prev = line;
+    }
+    test_assert(fib_stacks > 0);
+    free(folded);
+
+    return 0;
+}
+#endif
+
+int
+main()
+{
+    // the workers run in the background; this thread runs the tests with RUN and SUBMIT
+    lace_init(4, 0);
+    lace_startup_background(0);
+
+    int res = RUN(test_cutoff);
+    if (res == 0) res = RUN(test_victims);
+    if (res == 0) res = test_submit();
+#if LACE_TRACE
+    if (res == 0) res = test_trace();
+#endif
+    if (res == 0) res = RUN(test_idle);
+
+    lace_exit();
+
+    return res;
+}